@@ -11,7 +11,9 @@ def _nudl_py_target(
         builtins,
         imports = [],
         visibility = [],
-        py_deps = []):
+        py_deps = [],
+        use_interfaces = False,
+        builtin_snapshot = None):
     native.filegroup(
         name = name + "_ndl_src",
         srcs = srcs,
@@ -30,21 +32,48 @@ def _nudl_py_target(
     nudl_deps = []
     nudl_deps.extend([dep + "_ndl_src" for dep in deps])
     nudl_deps.append(builtins)
+    snapshot_arg = ""
+    if builtin_snapshot:
+        nudl_deps.append(builtin_snapshot)
+        snapshot_arg = " --builtin_snapshot=$(location " + builtin_snapshot + ")"
     if target_type == "binary":
         main = main.removesuffix(".py") + "_main.py"
         outs.append(main)
 
+    convert_cmd = ("$(execpath @nuna_nudl//nudl/conversion:convert) " +
+                   " --builtin_path=$(locations " + builtins + ")" +
+                   snapshot_arg +
+                   " \"--search_paths=.," + ",".join(search_paths) + "\"" +
+                   " \"--input_paths=" + ",".join(input_paths) + "\"" +
+                   " \"--imports=" + ",".join(imports) + "\"" +
+                   " --output_dir=$(RULEDIR) " +
+                   " --direct_output --lang=python --bindings_on_use --write_only_input")
+    genrule_srcs = srcs + nudl_deps
+    genrule_outs = list(outs)
+    if use_interfaces:
+        # The interfaces (.ndli files) of the nudl deps, which need to
+        # use interfaces as well, are merged in a temporary directory,
+        # so the imported modules are analyzed from these. The interfaces
+        # written by the conversion are packed for the dependent targets.
+        # The directory is removed on exit, whether the steps fail or not.
+        interfaces_tar = name + "_ndli.tar"
+        genrule_srcs = genrule_srcs + [dep + "_ndli.tar" for dep in deps]
+        genrule_outs.append(interfaces_tar)
+        convert_cmd = (
+            "IFACE_DIR=$$(mktemp -d) && trap 'rm -rf $$IFACE_DIR' EXIT && " +
+            "".join([
+                "tar -xf $(location " + dep + "_ndli.tar) -C $$IFACE_DIR && "
+                for dep in deps
+            ]) +
+            convert_cmd + " --interface_dir=$$IFACE_DIR" +
+            " && tar -cf $(location " + interfaces_tar + ") -C $$IFACE_DIR ."
+        )
+
     native.genrule(
         name = name + "_py_src",
-        srcs = srcs + nudl_deps,
-        outs = outs,
-        cmd = "$(execpath @nuna_nudl//nudl/conversion:convert) " +
-              " --builtin_path=$(locations " + builtins + ")" +
-              " \"--search_paths=.," + ",".join(search_paths) + "\"" +
-              " \"--input_paths=" + ",".join(input_paths) + "\"" +
-              " \"--imports=" + ",".join(imports) + "\"" +
-              " --output_dir=$(RULEDIR) " +
-              " --direct_output --lang=python --bindings_on_use --write_only_input",
+        srcs = genrule_srcs,
+        outs = genrule_outs,
+        cmd = convert_cmd,
         tools = ["@nuna_nudl//nudl/conversion:convert"],
     )
     full_py_deps = deps + py_deps + [
@@ -95,7 +124,9 @@ def nudl_py_library(
         imports = [],
         visibility = [],
         builtins = "@nuna_nudl//nudl/conversion/pylib:nudl_builtins_ndl",
-        py_deps = []):
+        py_deps = [],
+        use_interfaces = False,
+        builtin_snapshot = "@nuna_nudl//nudl/conversion/pylib:nudl_builtins_snapshot"):
     _nudl_py_target(
         "library",
         name,
@@ -106,6 +137,8 @@ def nudl_py_library(
         imports,
         visibility,
         py_deps,
+        use_interfaces,
+        builtin_snapshot,
     )
 
 def nudl_py_binary(
@@ -116,7 +149,9 @@ def nudl_py_binary(
         imports = [],
         visibility = [],
         builtins = "@nuna_nudl//nudl/conversion/pylib:nudl_builtins_ndl",
-        py_deps = []):
+        py_deps = [],
+        use_interfaces = False,
+        builtin_snapshot = "@nuna_nudl//nudl/conversion/pylib:nudl_builtins_snapshot"):
     _nudl_py_target(
         "binary",
         name,
@@ -127,6 +162,8 @@ def nudl_py_binary(
         imports,
         visibility,
         py_deps,
+        use_interfaces,
+        builtin_snapshot,
     )
 
 def nudl_py_test(
@@ -137,7 +174,9 @@ def nudl_py_test(
         imports = [],
         visibility = [],
         builtins = "@nuna_nudl//nudl/conversion/pylib:nudl_builtins_ndl",
-        py_deps = []):
+        py_deps = [],
+        use_interfaces = False,
+        builtin_snapshot = "@nuna_nudl//nudl/conversion/pylib:nudl_builtins_snapshot"):
     _nudl_py_target(
         "test",
         name,
@@ -148,4 +187,6 @@ def nudl_py_test(
         imports,
         visibility,
         py_deps,
+        use_interfaces,
+        builtin_snapshot,
     )
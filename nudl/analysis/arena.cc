@@ -0,0 +1,202 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "nudl/analysis/arena.h"
+
+#include <new>
+
+#include "absl/base/attributes.h"
+#include "glog/logging.h"
+
+namespace nudl {
+namespace analysis {
+
+namespace {
+constexpr size_t kAlignment = alignof(std::max_align_t);
+// The header keeps the allocating arena, and preserves the alignment.
+constexpr size_t kHeaderSize = kAlignment;
+static_assert(sizeof(AnalysisArena*) <= kHeaderSize);
+
+size_t AlignedSize(size_t size) {
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+ABSL_CONST_INIT thread_local AnalysisArena* current_arena = nullptr;
+
+std::atomic<size_t> global_num_arenas{0};
+std::atomic<size_t> global_num_blocks{0};
+std::atomic<size_t> global_allocated_bytes{0};
+}  // namespace
+
+void AnalysisArena::Releaser::operator()(AnalysisArena* arena) const {
+  arena->Unref();
+}
+
+AnalysisArena::Ptr AnalysisArena::Build(size_t block_size) {
+  return Ptr(new AnalysisArena(block_size));
+}
+
+AnalysisArena::AnalysisArena(size_t block_size)
+    : block_size_(AlignedSize(block_size)) {
+  CHECK_GT(block_size_, 0ul);
+  global_num_arenas.fetch_add(1, std::memory_order_relaxed);
+}
+
+AnalysisArena::~AnalysisArena() {
+  CHECK_NE(current_arena, this) << "Destroying an active analysis arena";
+  Block* block = blocks_.load(std::memory_order_acquire);
+  while (block) {
+    Block* next = block->next;
+    delete block;
+    block = next;
+  }
+  global_num_arenas.fetch_sub(1, std::memory_order_relaxed);
+  global_num_blocks.fetch_sub(num_blocks_.load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+  global_allocated_bytes.fetch_sub(
+      allocated_bytes_.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+}
+
+void AnalysisArena::Ref() { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+void AnalysisArena::Unref() {
+  if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete this;
+  }
+}
+
+AnalysisArena::Block* AnalysisArena::NewBlock(size_t size, size_t used) {
+  auto block = new Block();
+  block->data.reset(new char[size]);
+  block->size = size;
+  block->used.store(used, std::memory_order_relaxed);
+  return block;
+}
+
+void AnalysisArena::LinkBlock(Block* block) {
+  block->next = blocks_.load(std::memory_order_relaxed);
+  while (!blocks_.compare_exchange_weak(block->next, block,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+  }
+  num_blocks_.fetch_add(1, std::memory_order_relaxed);
+  global_num_blocks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* AnalysisArena::Allocate(size_t size) {
+  size = AlignedSize(size);
+  allocated_bytes_.fetch_add(size, std::memory_order_relaxed);
+  global_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (size > block_size_ / 4) {
+    // Large objects get their own block, not to waste the current one.
+    Block* block = NewBlock(size, size);
+    LinkBlock(block);
+    return block->data.get();
+  }
+  Block* block = current_.load(std::memory_order_acquire);
+  while (true) {
+    if (block) {
+      // Overshooting the block end just wastes its tail.
+      const size_t offset =
+          block->used.fetch_add(size, std::memory_order_relaxed);
+      if (offset + size <= block->size) {
+        return block->data.get() + offset;
+      }
+    }
+    // The current block is full: install a fresh one, with our object at
+    // its start, unless another thread did it first.
+    Block* fresh = NewBlock(block_size_, size);
+    if (current_.compare_exchange_strong(block, fresh,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+      LinkBlock(fresh);
+      return fresh->data.get();
+    }
+    // Here block was updated to the one installed by the other thread.
+    delete fresh;
+  }
+}
+
+size_t AnalysisArena::allocated_bytes() const {
+  return allocated_bytes_.load(std::memory_order_relaxed);
+}
+
+size_t AnalysisArena::num_blocks() const {
+  return num_blocks_.load(std::memory_order_relaxed);
+}
+
+ArenaStats AnalysisArena::stats() {
+  ArenaStats stats;
+  stats.num_arenas = global_num_arenas.load(std::memory_order_relaxed);
+  stats.num_blocks = global_num_blocks.load(std::memory_order_relaxed);
+  stats.allocated_bytes =
+      global_allocated_bytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
+AnalysisArena* AnalysisArena::Current() { return current_arena; }
+
+AnalysisArena::Activation::Activation(AnalysisArena* arena)
+    : arena_(arena), previous_(current_arena) {
+  if (arena_) {
+    arena_->Ref();
+  }
+  current_arena = arena_;
+}
+
+AnalysisArena::Activation::~Activation() {
+  current_arena = previous_;
+  if (arena_) {
+    arena_->Unref();
+  }
+}
+
+void* AnalysisArena::New(size_t size) {
+  AnalysisArena* arena = current_arena;
+  char* data;
+  if (arena) {
+    data = static_cast<char*>(arena->Allocate(size + kHeaderSize));
+    arena->Ref();
+  } else {
+    data = static_cast<char*>(::operator new(size + kHeaderSize));
+  }
+  *reinterpret_cast<AnalysisArena**>(data) = arena;
+  return data + kHeaderSize;
+}
+
+void AnalysisArena::Delete(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  char* data = static_cast<char*>(ptr) - kHeaderSize;
+  AnalysisArena* arena = *reinterpret_cast<AnalysisArena**>(data);
+  if (arena) {
+    // The memory is released in bulk with the arena, when this was the
+    // last reference to it.
+    arena->Unref();
+  } else {
+    ::operator delete(data);
+  }
+}
+
+AnalysisArena* AnalysisArena::Of(const void* ptr) {
+  return *reinterpret_cast<AnalysisArena* const*>(
+      static_cast<const char*>(ptr) - kHeaderSize);
+}
+
+}  // namespace analysis
+}  // namespace nudl
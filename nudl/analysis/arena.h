@@ -0,0 +1,134 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef NUDL_ANALYSIS_ARENA_H__
+#define NUDL_ANALYSIS_ARENA_H__
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace nudl {
+namespace analysis {
+
+// Process-wide counters of the analysis arenas.
+struct ArenaStats {
+  // Arenas not yet destroyed.
+  size_t num_arenas = 0;
+  // Memory blocks reserved by these arenas.
+  size_t num_blocks = 0;
+  // Bytes allocated from these arenas.
+  size_t allocated_bytes = 0;
+};
+
+// Bump allocator for the analysis objects of a module (expressions,
+// types, function bindings and variables). Allocation is lock free, so
+// the objects of a module can be built on more than one thread.
+//
+// Arenas are reference counted: by their owner (e.g. a Module), and by
+// each object allocated in them. Deleting an object runs its destructor
+// and drops its reference, without releasing its memory. The memory
+// blocks are freed in bulk when the owner released the arena, and all
+// its objects were destroyed. Objects built while analyzing one module,
+// but owned by another (e.g. bindings of imported functions), keep their
+// arena alive until they are destroyed.
+//
+// Allocation classes pick the arena that is active in the current
+// thread, as set by AnalysisArena::Activation, or the heap if none.
+class AnalysisArena {
+ public:
+  struct Releaser {
+    void operator()(AnalysisArena* arena) const;
+  };
+  using Ptr = std::unique_ptr<AnalysisArena, Releaser>;
+
+  static constexpr size_t kDefaultBlockSize = 1 << 16;
+
+  // Builds an arena, owned by the returned pointer.
+  static Ptr Build(size_t block_size = kDefaultBlockSize);
+
+  // Returns size bytes, aligned for any object.
+  void* Allocate(size_t size);
+
+  // Total number of bytes allocated from this arena.
+  size_t allocated_bytes() const;
+  // Number of memory blocks reserved by this arena.
+  size_t num_blocks() const;
+
+  // Counters summed over all the arenas in the process.
+  static ArenaStats stats();
+
+  // The arena active in the current thread, null if none.
+  static AnalysisArena* Current();
+
+  // Makes an arena active in the current thread, for the lifetime of
+  // this object, and keeps it alive meanwhile. Restores the previously
+  // active arena upon destruction.
+  class Activation {
+   public:
+    explicit Activation(AnalysisArena* arena);
+    ~Activation();
+
+    Activation(const Activation&) = delete;
+    Activation& operator=(const Activation&) = delete;
+
+   private:
+    AnalysisArena* const arena_;
+    AnalysisArena* const previous_;
+  };
+
+  // Allocation and deallocation functions for classes that are allocated
+  // in the current arena. Each allocation is prefixed by a header noting
+  // the arena it came from (or none, for heap allocations).
+  static void* New(size_t size);
+  static void Delete(void* ptr);
+  // The arena in which ptr, returned by New, was allocated. Null for
+  // heap allocations.
+  static AnalysisArena* Of(const void* ptr);
+
+ private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+    std::atomic<size_t> used{0};
+    Block* next = nullptr;
+  };
+
+  explicit AnalysisArena(size_t block_size);
+  ~AnalysisArena();
+
+  void Ref();
+  void Unref();
+  // Creates a block of size bytes, of which the first used are taken.
+  Block* NewBlock(size_t size, size_t used);
+  // Adds a block to the list of blocks freed with the arena.
+  void LinkBlock(Block* block);
+
+  const size_t block_size_;
+  // The owner reference, one for each object allocated with New, and one
+  // for each activation.
+  std::atomic<size_t> refs_{1};
+  // The block in which objects are allocated.
+  std::atomic<Block*> current_{nullptr};
+  // All blocks, linked by their next field.
+  std::atomic<Block*> blocks_{nullptr};
+  std::atomic<size_t> num_blocks_{0};
+  std::atomic<size_t> allocated_bytes_{0};
+};
+
+}  // namespace analysis
+}  // namespace nudl
+
+#endif  // NUDL_ANALYSIS_ARENA_H__
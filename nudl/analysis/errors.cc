@@ -30,6 +30,9 @@ pb::ErrorInfo CodeContext::ToErrorInfo(absl::string_view message) const {
   }
   if (code) {
     info.set_snippet(*code);
+  } else if (interval && !source.empty()) {
+    info.set_snippet(std::string(grammar::TreeUtil::CodeSnippet(
+        source, interval->begin(), interval->end())));
   }
   info.set_error_message(std::string(message));
   return info;
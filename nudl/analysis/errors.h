@@ -29,10 +29,15 @@ namespace analysis {
 struct CodeContext {
   const pb::CodeInterval* interval = nullptr;
   const std::string* code = nullptr;
+  // Source code of the module, from which we extract the code in interval
+  // when needed, if the code was not provided.
+  absl::string_view source;
 
   template <class Proto>
-  static CodeContext FromProto(const Proto& proto) {
+  static CodeContext FromProto(const Proto& proto,
+                               absl::string_view source = {}) {
     CodeContext context;
+    context.source = source;
     if (proto.has_code_interval()) {
       context.interval = &proto.code_interval();
     }
@@ -41,6 +41,10 @@ namespace analysis {
 
 Expression::Expression(Scope* scope) : scope_(CHECK_NOTNULL(scope)) {}
 
+void* Expression::operator new(size_t size) { return AnalysisArena::New(size); }
+
+void Expression::operator delete(void* ptr) { AnalysisArena::Delete(ptr); }
+
 Expression::~Expression() {
   while (!children_.empty()) {
     children_.pop_back();
@@ -67,6 +71,11 @@ absl::StatusOr<const TypeSpec*> Expression::type_spec(
   return CHECK_NOTNULL(type_spec_.value());
 }
 
+void Expression::ResetNegotiatedType() {
+  type_spec_.reset();
+  type_hint_.reset();
+}
+
 const std::vector<std::unique_ptr<Expression>>& Expression::children() const {
   return children_;
 }
@@ -123,6 +132,29 @@ std::unique_ptr<Expression> Expression::CopyTypeInfo(
   return clone;
 }
 
+std::unique_ptr<Expression> Expression::CloneInScope(const Scope* from_scope,
+                                                     Scope* scope) const {
+  class ScopeRebinder : public ExpressionVisitor {
+   public:
+    ScopeRebinder(const Scope* from_scope, Scope* scope)
+        : from_scope_(from_scope), to_scope_(scope) {}
+    bool Visit(Expression* expression) override {
+      if (expression->scope_ == from_scope_) {
+        expression->scope_ = to_scope_;
+      }
+      return true;
+    }
+
+   private:
+    const Scope* const from_scope_;
+    Scope* const to_scope_;
+  };
+  auto clone = Clone(CloneOverride());
+  ScopeRebinder rebinder(from_scope, scope);
+  clone->VisitExpressions(&rebinder);
+  return clone;
+}
+
 std::vector<std::unique_ptr<Expression>> Expression::CloneChildren(
     const CloneOverride& clone_override) const {
   std::vector<std::unique_ptr<Expression>> elements;
@@ -1243,7 +1275,7 @@ DotAccessExpression::DotAccessExpression(
     Scope* scope, std::unique_ptr<Expression> left_expression,
     absl::string_view name, NamedObject* object)
     : Expression(scope),
-      name_(std::string(name), {std::string(name)}, {}),
+      name_({std::string(name)}, {}),
       object_(object) {
   children_.emplace_back(std::move(left_expression));
 }
@@ -1322,9 +1354,11 @@ std::unique_ptr<Expression> FunctionCallExpression::Clone(
   if (left_expression_) {
     left = left_expression_->Clone(clone_override);
   }
-  return CopyTypeInfo(std::make_unique<FunctionCallExpression>(
+  auto clone = std::make_unique<FunctionCallExpression>(
       scope_, std::move(binding_clone), std::move(left),
-      std::move(argument_expressions), is_method_call_));
+      std::move(argument_expressions), is_method_call_);
+  clone->set_dependent_functions(dependent_functions_);
+  return CopyTypeInfo(std::move(clone));
 }
 
 bool FunctionCallExpression::VisitExpressions(ExpressionVisitor* visitor) {
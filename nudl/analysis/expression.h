@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "absl/status/statusor.h"
+#include "nudl/analysis/arena.h"
 #include "nudl/analysis/type_spec.h"
 #include "nudl/analysis/types.h"
 
@@ -44,10 +45,17 @@ class Expression {
   explicit Expression(Scope* scope);
   virtual ~Expression();
 
+  // Expressions are allocated in the active AnalysisArena, if any.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
   absl::optional<const TypeSpec*> stored_type_spec() const;
 
   absl::StatusOr<const TypeSpec*> type_spec(
       absl::optional<const TypeSpec*> type_hint = {});
+  // Drops the negotiated type, so it is negotiated again on the next
+  // type_spec() call - e.g. when a copy is placed in another context.
+  void ResetNegotiatedType();
 
   // The kind of this expression
   virtual pb::ExpressionKind expr_kind() const = 0;
@@ -80,6 +88,10 @@ class Expression {
   // Creates a copy of this expression.
   virtual std::unique_ptr<Expression> Clone(
       const CloneOverride& clone_override) const = 0;
+  // Creates a copy of this expression, in which the copies of the
+  // expressions built in from_scope are placed in scope instead.
+  std::unique_ptr<Expression> CloneInScope(const Scope* from_scope,
+                                           Scope* scope) const;
 
   // Returns a string that describes the expression - for debug purposes.
   virtual std::string DebugString() const = 0;
@@ -100,7 +112,7 @@ class Expression {
   std::vector<std::unique_ptr<Expression>> CloneChildren(
       const CloneOverride& clone_override) const;
 
-  Scope* const scope_;
+  Scope* scope_;
   std::vector<std::unique_ptr<Expression>> children_;
   absl::optional<const TypeSpec*> type_spec_;
   absl::optional<const TypeSpec*> type_hint_;
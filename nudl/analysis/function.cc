@@ -16,6 +16,8 @@
 
 #include "nudl/analysis/function.h"
 
+#include <algorithm>
+#include <atomic>
 #include <utility>
 
 #include "absl/cleanup/cleanup.h"
@@ -24,6 +26,7 @@
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "glog/logging.h"
+#include "nudl/analysis/module.h"
 #include "nudl/analysis/pragma.h"
 #include "nudl/analysis/types.h"
 #include "nudl/grammar/dsl.h"
@@ -33,6 +36,20 @@
 namespace nudl {
 namespace analysis {
 
+namespace {
+struct AtomicSignatureCacheStats {
+  std::atomic<size_t> hits{0};
+  std::atomic<size_t> misses{0};
+  std::atomic<size_t> uncacheable{0};
+  std::atomic<size_t> invalidations{0};
+};
+
+AtomicSignatureCacheStats& GlobalSignatureCacheStats() {
+  static auto* const stats = new AtomicSignatureCacheStats();
+  return *stats;
+}
+}  // namespace
+
 FunctionGroup::FunctionGroup(std::shared_ptr<ScopeName> scope_name,
                              Scope* parent, bool is_method_group)
     : Scope(std::move(scope_name), parent), is_method_group_(is_method_group) {
@@ -110,6 +127,9 @@ absl::Status FunctionGroup::AddFunction(Function* fun) {
     function_types.emplace_back(child_fun->type_spec());
   }
   function_types.emplace_back(fun->type_spec());
+  // The group types are kept with the group, which may outlive the module
+  // of the added function.
+  AnalysisArena::Activation activation(arena());
   std::unique_ptr<TypeSpec> new_group_type;
   if (function_types.size() >= 2) {
     ASSIGN_OR_RETURN(new_group_type,
@@ -123,6 +143,42 @@ absl::Status FunctionGroup::AddFunction(Function* fun) {
   }
   is_main_ = (fun->kind() == pb::ObjectKind::OBJ_MAIN_FUNCTION);
   functions_.emplace_back(fun);
+  signature_filters_.emplace_back();
+  ClearSignatureCache();
+  return absl::OkStatus();
+}
+
+absl::Status FunctionGroup::RemoveFunction(Function* fun) {
+  auto it = std::find(functions_.begin(), functions_.end(), fun);
+  if (it == functions_.end()) {
+    return status::NotFoundErrorBuilder()
+           << "Function: " << fun->full_name()
+           << " is not registered in group: " << full_name();
+  }
+  signature_filters_.erase(signature_filters_.begin() +
+                           (it - functions_.begin()));
+  functions_.erase(it);
+  ClearSignatureCache();
+  is_main_ = false;
+  if (functions_.empty()) {
+    return absl::OkStatus();
+  }
+  // The previous types are kept, as they may still be referred.
+  AnalysisArena::Activation activation(arena());
+  std::unique_ptr<TypeSpec> new_group_type;
+  if (functions_.size() >= 2) {
+    std::vector<TypeBindingArg> function_types;
+    function_types.reserve(functions_.size());
+    for (Function* child_fun : functions_) {
+      function_types.emplace_back(child_fun->type_spec());
+    }
+    ASSIGN_OR_RETURN(new_group_type,
+                     parent_->FindTypeUnion()->Bind(function_types),
+                     _ << "Binding union type to function group" << kBugNotice);
+  } else {
+    new_group_type = functions_.front()->type_spec()->Clone();
+  }
+  types_.emplace_back(std::move(new_group_type));
   return absl::OkStatus();
 }
 
@@ -193,34 +249,382 @@ FunctionGroup::TryBindFunction(
   return {std::move(new_bindings)};
 }
 
+namespace {
+// Basic types that have no parameters, and bind a call argument only
+// if they are ancestors or descendants of the type of that argument.
+bool IsFilterableType(const TypeSpec* type_spec) {
+  static const auto* const kFilterableTypeIds =
+      new absl::flat_hash_set<int>({
+          pb::TypeId::INT_ID,      pb::TypeId::INT8_ID,
+          pb::TypeId::INT16_ID,    pb::TypeId::INT32_ID,
+          pb::TypeId::UINT_ID,     pb::TypeId::UINT8_ID,
+          pb::TypeId::UINT16_ID,   pb::TypeId::UINT32_ID,
+          pb::TypeId::STRING_ID,   pb::TypeId::BYTES_ID,
+          pb::TypeId::BOOL_ID,     pb::TypeId::FLOAT32_ID,
+          pb::TypeId::FLOAT64_ID,  pb::TypeId::DATE_ID,
+          pb::TypeId::DATETIME_ID, pb::TypeId::TIMEINTERVAL_ID,
+          pb::TypeId::TIMESTAMP_ID, pb::TypeId::DECIMAL_ID,
+      });
+  return (type_spec->parameters().empty() && type_spec->local_name().empty() &&
+          kFilterableTypeIds->contains(type_spec->type_id()));
+}
+
+bool HasAncestorTypeId(const TypeSpec* type_spec, int type_id) {
+  for (; type_spec; type_spec = type_spec->ancestor()) {
+    if (type_spec->type_id() == type_id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the type of the first call argument, if it is positional,
+// filterable, and does not depend on the type hint used when binding.
+const TypeSpec* FilterFirstArgType(
+    const std::vector<FunctionCallArgument>& arguments) {
+  if (arguments.empty() || arguments.front().name.has_value()) {
+    return nullptr;
+  }
+  const FunctionCallArgument& arg = arguments.front();
+  if (arg.value.has_value()) {
+    switch (CHECK_NOTNULL(arg.value.value())->expr_kind()) {
+      case pb::ExpressionKind::EXPR_IDENTIFIER:
+      case pb::ExpressionKind::EXPR_DOT_ACCESS:
+      case pb::ExpressionKind::EXPR_FUNCTION_CALL:
+        break;
+      default:
+        return nullptr;
+    }
+  }
+  auto arg_type = arg.ArgType();
+  if (!arg_type.ok() || !IsFilterableType(arg_type.value())) {
+    return nullptr;
+  }
+  return arg_type.value();
+}
+}  // namespace
+
+bool FunctionGroup::MayBind(size_t index,
+                            const std::vector<FunctionCallArgument>& arguments,
+                            const TypeSpec* first_call_type) const {
+  Function* function = BindingFunction(index);
+  SignatureFilter& filter = signature_filters_[index];
+  if (filter.type_spec != function->type_spec()) {
+    filter = SignatureFilter();
+    filter.type_spec = function->type_spec();
+    if (filter.type_spec->type_id() != pb::TypeId::FUNCTION_ID) {
+      return true;
+    }
+    auto fun_type = static_cast<const TypeFunction*>(filter.type_spec);
+    const auto& default_values = function->default_values();
+    for (size_t i = 0; i < fun_type->arguments().size(); ++i) {
+      const bool has_default_value =
+          (fun_type->first_default_value_index().has_value() &&
+           fun_type->first_default_value_index().value() <= i &&
+           i < default_values.size() && default_values[i].has_value());
+      if (!has_default_value) {
+        ++filter.min_args;
+      }
+      filter.arg_names.emplace(fun_type->arguments()[i].name);
+    }
+    filter.max_args = fun_type->arguments().size();
+    if (!fun_type->arguments().empty() &&
+        IsFilterableType(fun_type->arguments().front().type_spec)) {
+      filter.first_arg_type = fun_type->arguments().front().type_spec;
+    }
+  }
+  if (filter.type_spec->type_id() != pb::TypeId::FUNCTION_ID) {
+    return true;
+  }
+  if (arguments.size() < filter.min_args ||
+      arguments.size() > filter.max_args) {
+    return false;
+  }
+  for (const auto& arg : arguments) {
+    if (arg.name.has_value() && !filter.arg_names.contains(arg.name.value())) {
+      return false;
+    }
+  }
+  if (first_call_type && filter.first_arg_type) {
+    return (HasAncestorTypeId(first_call_type,
+                              filter.first_arg_type->type_id()) ||
+            HasAncestorTypeId(filter.first_arg_type,
+                              first_call_type->type_id()));
+  }
+  return true;
+}
+
+Function* FunctionGroup::BindingFunction(size_t index) const {
+  // Bindings are performed on the original function, as in BindArguments.
+  Function* function = functions_[index];
+  while (function->binding_parent().has_value()) {
+    function = function->binding_parent().value();
+  }
+  return function;
+}
+
+namespace {
+// If the type binds based only on its identity. Returns false for types
+// that bind based on more than that (e.g. functions, which bind on the
+// actual function argument).
+bool IsCacheableType(const TypeSpec* type_spec) {
+  switch (type_spec->type_id()) {
+    case pb::TypeId::UNKNOWN_ID:
+    case pb::TypeId::TUPLE_ID:
+    case pb::TypeId::FUNCTION_ID:
+    case pb::TypeId::DATASET_ID:
+    case pb::TypeId::TYPE_ID:
+    case pb::TypeId::MODULE_ID:
+      return false;
+    default:
+      break;
+  }
+  if (type_spec->type_id() >= pb::TypeId::FIRST_CUSTOM_ID) {
+    return false;
+  }
+  for (const TypeSpec* parameter : type_spec->parameters()) {
+    if (!IsCacheableType(CHECK_NOTNULL(parameter))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Adds to module_names the modules that define the type and its
+// parameters.
+void CollectTypeModules(const TypeSpec* type_spec,
+                        absl::flat_hash_set<std::string>* module_names) {
+  if (!type_spec->scope_name().empty()) {
+    module_names->emplace(type_spec->scope_name().module_name());
+  }
+  for (const TypeSpec* parameter : type_spec->parameters()) {
+    CollectTypeModules(CHECK_NOTNULL(parameter), module_names);
+  }
+}
+
+// Returns the error for a call signature bound by more than one function.
+absl::Status AmbiguousSignatureError(
+    const std::vector<std::unique_ptr<FunctionBinding>>& matching_specs) {
+  std::vector<std::string> result_status;
+  result_status.reserve(matching_specs.size());
+  for (const auto& spec : matching_specs) {
+    result_status.emplace_back(spec->full_name());
+  }
+  return absl::InvalidArgumentError(absl::StrCat(
+      "Found too many functions matching the provided call signature: ",
+      absl::StrJoin(result_status, ", ")));
+}
+}  // namespace
+
+// Builds the signature cache key for the call arguments, or returns
+// false if binding them depends on more than their names and types.
+// The types of the arguments are set in key_types.
+bool FunctionGroup::BuildSignatureKey(
+    const std::vector<FunctionCallArgument>& arguments, SignatureKey* key,
+    absl::InlinedVector<const TypeSpec*, 4>* key_types) {
+  key->reserve(arguments.size());
+  key_types->reserve(arguments.size());
+  for (const auto& arg : arguments) {
+    const TypeSpec* type_spec = nullptr;
+    bool is_literal = false;
+    if (arg.value.has_value()) {
+      Expression* value = CHECK_NOTNULL(arg.value.value());
+      switch (value->expr_kind()) {
+        case pb::ExpressionKind::EXPR_IDENTIFIER:
+        case pb::ExpressionKind::EXPR_DOT_ACCESS:
+        case pb::ExpressionKind::EXPR_FUNCTION_CALL: {
+          // The types of these do not depend on the binding type hint.
+          auto arg_type = arg.ArgType();
+          if (!arg_type.ok()) {
+            return false;
+          }
+          type_spec = arg_type.value();
+        } break;
+        case pb::ExpressionKind::EXPR_LITERAL:
+          // Literals negotiate their type only based on the build type.
+          is_literal = true;
+          type_spec = static_cast<Literal*>(value)->build_type_spec();
+          break;
+        default:
+          return false;
+      }
+    } else if (arg.type_spec.has_value()) {
+      type_spec = arg.type_spec.value();
+    } else {
+      return false;
+    }
+    if (!IsCacheableType(CHECK_NOTNULL(type_spec))) {
+      return false;
+    }
+    key->emplace_back(arg.name.has_value() ? arg.name.value() : std::string(),
+                      (type_spec->type_uid() << 1) | (is_literal ? 1 : 0));
+    key_types->emplace_back(type_spec);
+  }
+  return true;
+}
+
+SignatureCacheStats FunctionGroup::signature_cache_stats() {
+  const auto& stats = GlobalSignatureCacheStats();
+  SignatureCacheStats result;
+  result.hits = stats.hits;
+  result.misses = stats.misses;
+  result.uncacheable = stats.uncacheable;
+  result.invalidations = stats.invalidations;
+  return result;
+}
+
+void FunctionGroup::ClearSignatureCache() const {
+  if (signature_cache_.empty()) {
+    return;
+  }
+  signature_cache_.clear();
+  module_signatures_.clear();
+  ++GlobalSignatureCacheStats().invalidations;
+}
+
+void FunctionGroup::CheckSignatureCache() const {
+  if (signature_cache_.empty()) {
+    return;
+  }
+  for (size_t i = 0; i < functions_.size(); ++i) {
+    if (signature_filters_[i].type_spec != BindingFunction(i)->type_spec()) {
+      ClearSignatureCache();
+      return;
+    }
+  }
+}
+
+void FunctionGroup::CacheSignature(
+    SignatureKey key, absl::Span<const TypeSpec* const> key_types,
+    SignatureOutcome outcome) const {
+  absl::flat_hash_set<std::string> module_names;
+  for (const TypeSpec* type_spec : key_types) {
+    CollectTypeModules(type_spec, &module_names);
+  }
+  for (const auto& module_name : module_names) {
+    module_signatures_[module_name].emplace_back(key);
+  }
+  signature_cache_.insert_or_assign(std::move(key), std::move(outcome));
+}
+
+void FunctionGroup::DropModuleSignatures(
+    const absl::flat_hash_set<std::string>& module_names) const {
+  bool dropped = false;
+  for (const auto& module_name : module_names) {
+    auto it = module_signatures_.find(module_name);
+    if (it == module_signatures_.end()) {
+      continue;
+    }
+    // Keys of other modules may have been dropped already, or replaced
+    // upon a cache hit that failed to bind.
+    for (const auto& key : it->second) {
+      dropped |= (signature_cache_.erase(key) > 0);
+    }
+    module_signatures_.erase(it);
+  }
+  if (dropped) {
+    ++GlobalSignatureCacheStats().invalidations;
+  }
+}
+
 absl::StatusOr<std::unique_ptr<FunctionBinding>> FunctionGroup::FindSignature(
     const std::vector<FunctionCallArgument>& arguments) const {
-  std::vector<absl::Status> bind_status;
+  auto& stats = GlobalSignatureCacheStats();
+  SignatureKey key;
+  absl::InlinedVector<const TypeSpec*, 4> key_types;
+  if (!BuildSignatureKey(arguments, &key, &key_types)) {
+    ++stats.uncacheable;
+    ASSIGN_OR_RETURN(auto matching_specs, FindMatchingSignatures(arguments));
+    if (matching_specs.size() > 1) {
+      return AmbiguousSignatureError(matching_specs);
+    }
+    return {std::move(matching_specs.front())};
+  }
+  CheckSignatureCache();
+  auto it = signature_cache_.find(key);
+  if (it != signature_cache_.end()) {
+    if (!it->second.status.ok()) {
+      // The same arguments were found to bind more than one function.
+      ++stats.hits;
+      return it->second.status;
+    }
+    std::vector<std::unique_ptr<FunctionBinding>> bindings;
+    auto bind_result =
+        TryBindFunction(functions_[it->second.index], arguments, &bindings);
+    if (bind_result.ok() && bind_result.value().size() == 1) {
+      ++stats.hits;
+      return {std::move(bind_result.value().front())};
+    }
+    // Should not happen - but we can always fall back to a full search.
+    signature_cache_.erase(it);
+  }
+  ++stats.misses;
+  ASSIGN_OR_RETURN(auto matching_specs, FindMatchingSignatures(arguments));
+  if (matching_specs.size() > 1) {
+    SignatureOutcome outcome;
+    outcome.status = AmbiguousSignatureError(matching_specs);
+    CacheSignature(std::move(key), key_types, outcome);
+    return outcome.status;
+  }
+  std::unique_ptr<FunctionBinding> result = std::move(matching_specs.front());
+  if (result->fun.has_value()) {
+    for (size_t i = 0; i < functions_.size(); ++i) {
+      if (BindingFunction(i) == result->fun.value()) {
+        SignatureOutcome outcome;
+        outcome.index = i;
+        CacheSignature(std::move(key), key_types, std::move(outcome));
+        break;
+      }
+    }
+  }
+  return {std::move(result)};
+}
+
+absl::StatusOr<std::vector<std::unique_ptr<FunctionBinding>>>
+FunctionGroup::FindMatchingSignatures(
+    const std::vector<FunctionCallArgument>& arguments) const {
+  const TypeSpec* first_call_type = FilterFirstArgType(arguments);
+  std::vector<absl::Status> bind_status(functions_.size());
+  std::vector<size_t> filtered_functions;
   std::vector<std::unique_ptr<FunctionBinding>> matching_specs;
-  for (auto function : functions_) {
-    auto bind_result = TryBindFunction(function, arguments, &matching_specs);
+  for (size_t i = 0; i < functions_.size(); ++i) {
+    if (!MayBind(i, arguments, first_call_type)) {
+      filtered_functions.emplace_back(i);
+      continue;
+    }
+    auto bind_result =
+        TryBindFunction(functions_[i], arguments, &matching_specs);
     if (bind_result.ok()) {
       matching_specs = std::move(bind_result).value();
     } else {
-      bind_status.emplace_back(std::move(bind_result).status());
+      bind_status[i] = std::move(bind_result).status();
     }
   }
   if (matching_specs.empty()) {
-    bind_status.emplace_back(absl::NotFoundError(
-        "Cannot find any function signature matching arguments"));
-    return status::JoinStatus(std::move(bind_status));
+    // Bind the functions that were filtered out as well, for reporting
+    // why they do not match.
+    for (size_t i : filtered_functions) {
+      auto bind_result =
+          TryBindFunction(functions_[i], arguments, &matching_specs);
+      if (bind_result.ok()) {
+        matching_specs = std::move(bind_result).value();
+      } else {
+        bind_status[i] = std::move(bind_result).status();
+      }
+    }
   }
-  if (matching_specs.size() > 1) {
-    std::vector<std::string> result_status;
-    result_status.reserve(matching_specs.size());
-    for (const auto& spec : matching_specs) {
-      result_status.emplace_back(spec->full_name());
+  if (matching_specs.empty()) {
+    std::vector<absl::Status> errors;
+    for (auto& crt_status : bind_status) {
+      if (!crt_status.ok()) {
+        errors.emplace_back(std::move(crt_status));
+      }
     }
-    return absl::InvalidArgumentError(absl::StrCat(
-        "Found too many functions matching the provided call signature: ",
-        absl::StrJoin(result_status, ", ")));
+    errors.emplace_back(absl::NotFoundError(
+        "Cannot find any function signature matching arguments"));
+    return status::JoinStatus(std::move(errors));
   }
-  return {std::move(matching_specs.front())};
+  return {std::move(matching_specs)};
 }
 
 namespace {
@@ -304,6 +708,11 @@ FunctionGroup* Function::function_group() const { return function_group_; }
 
 Scope* Function::definition_scope() const { return definition_scope_; }
 
+const std::vector<std::pair<TypeMemberStore*, FunctionGroup*>>&
+Function::member_groups() const {
+  return member_groups_;
+}
+
 const std::vector<std::unique_ptr<Function>>& Function::bindings() const {
   return bindings_;
 }
@@ -358,6 +767,10 @@ bool Function::is_skip_conversion() const {
   return native_impl().contains(kFunctionSkipConversion);
 }
 
+size_t Function::num_shared_expressions() const {
+  return num_shared_expressions_;
+}
+
 const std::vector<Expression*>& Function::call_expressions() const {
   return call_expressions_;
 }
@@ -381,6 +794,41 @@ bool Function::IsBinding(const Function* fun) const {
   return fun == this || bindings_by_function_.contains(fun);
 }
 
+void Function::DropModuleBindings(
+    const absl::flat_hash_set<std::string>& module_names) {
+  std::vector<std::unique_ptr<Function>> kept_bindings;
+  for (auto& binding : bindings_) {
+    if (!TypeUtils::UsesModuleTypes(binding->type_spec(), module_names)) {
+      kept_bindings.emplace_back(std::move(binding));
+      continue;
+    }
+    Function* dropped = binding.get();
+    bindings_by_name_.erase(dropped->type_signature_);
+    for (auto it = bindings_by_fingerprint_.begin();
+         it != bindings_by_fingerprint_.end();) {
+      if (it->second == dropped) {
+        bindings_by_fingerprint_.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+    bindings_by_function_.erase(dropped);
+    parent_->RemoveChildStore(dropped->call_name());
+  }
+  if (kept_bindings.size() == bindings_.size()) {
+    return;
+  }
+  // The shared expressions may point in the dropped bindings.
+  shared_expressions_.clear();
+  bindings_ = std::move(kept_bindings);
+  // Updates the indices of the remaining bindings.
+  for (size_t i = 0; i < bindings_.size(); ++i) {
+    Function* binding = bindings_[i].get();
+    bindings_by_name_[binding->type_signature_].first = i;
+    bindings_by_function_[binding].first = i;
+  }
+}
+
 bool Function::HasUndefinedArgTypes() const {
   for (const auto& arg : arguments_) {
     if (TypeUtils::IsUndefinedArgType(arg->type_spec())) {
@@ -588,7 +1036,17 @@ absl::Status Function::InitializeDefinition(
   RETURN_IF_ERROR(UpdateFunctionType(result_type))
       << context.ToErrorInfo("In function definition");
 
-  if (element.has_expression_block()) {
+  if (element.body_elided()) {
+    if (!has_complete_signature()) {
+      return status::FailedPreconditionErrorBuilder()
+             << "Function: " << function_name()
+             << " from a module interface has no body, but its signature "
+                "is not complete: "
+             << type_spec_->full_name()
+             << context.ToErrorInfo("In function definition");
+    }
+    body_elided_ = true;
+  } else if (element.has_expression_block()) {
     function_body_ =
         std::make_shared<pb::ExpressionBlock>(element.expression_block());
     // TODO(catalin): here is a discussion - it would imply that the function
@@ -596,7 +1054,13 @@ absl::Status Function::InitializeDefinition(
     //   build the body here - to be studied...
     // Things become less clear on lambdas which may habitually be defined
     // without types.
-    if (!HasUndefinedArgTypes()) {
+    // The bodies verified when writing the builtin snapshot are deferred
+    // as well, so loading the snapshot skips their analysis.
+    if (HasDeferrableBody() ||
+        (element.body_verified() && has_complete_signature())) {
+      deferred_body_ = DeferredBody::kPending;
+      static_cast<Module*>(module_scope())->AddDeferredFunction(this);
+    } else if (!HasUndefinedArgTypes()) {
       RETURN_IF_ERROR(BuildFunctionBody())
           << "Building function body"
           << context.ToErrorInfo("In function definition");
@@ -644,6 +1108,7 @@ absl::Status Function::UpdateFunctionType(const TypeSpec* result_type) {
   for (const auto& arg : arguments_) {
     bindings.push_back(CHECK_NOTNULL(arg->type_spec()));
   }
+  const uint64_t type_fingerprint = TypeSpec::TypeBindingFingerprint(bindings);
   if (type_signature_.empty()) {
     type_signature_ = TypeSpec::TypeBindingSignature(bindings);
   }
@@ -675,6 +1140,7 @@ absl::Status Function::UpdateFunctionType(const TypeSpec* result_type) {
   if (!HasUndefinedArgTypes()) {
     bindings_by_name_.emplace(type_signature_,
                               std::make_pair(std::optional<size_t>{}, this));
+    bindings_by_fingerprint_.emplace(type_fingerprint, this);
   }
   created_type_specs_.emplace_back(std::move(function_type_spec));
   return absl::OkStatus();
@@ -709,6 +1175,7 @@ absl::Status Function::AddAsMethod(const TypeSpec* member_type) {
   RETURN_IF_ERROR(function_group->AddFunction(this))
       << "Adding defined function " << function_name()
       << " as a method of type: " << member_type->full_name();
+  member_groups_.emplace_back(type_member_store, function_group);
   return absl::OkStatus();
 }
 
@@ -745,6 +1212,7 @@ absl::Status Function::InitializeAsConstructor(const TypeSpec* result_type) {
   RETURN_IF_ERROR(function_group->AddFunction(this))
       << "Adding defined function " << function_name()
       << " as a constructor of type: " << result_type->full_name();
+  member_groups_.emplace_back(type_member_store, function_group);
   return absl::OkStatus();
 }
 
@@ -1001,6 +1469,12 @@ FunctionBinding::FunctionBinding(const TypeFunction* fun_type,
 
 FunctionBinding::FunctionBinding() {}
 
+void* FunctionBinding::operator new(size_t size) {
+  return AnalysisArena::New(size);
+}
+
+void FunctionBinding::operator delete(void* ptr) { AnalysisArena::Delete(ptr); }
+
 void FunctionBinding::CheckCounts() const {
   const size_t num_args = type_arguments.size();
   CHECK_EQ(num_args, call_expressions.size());
@@ -1448,6 +1922,7 @@ std::unique_ptr<FunctionBinding> FunctionBinding::Clone(
   clone->call_sub_bindings = call_sub_bindings;
   clone->is_default_value = is_default_value;
   clone->names = names;
+  clone->type_spec = type_spec;
   for (const auto& expr : call_expressions) {
     if (expr.has_value()) {
       argument_expressions->emplace_back(expr.value()->Clone(clone_override));
@@ -1488,20 +1963,38 @@ absl::StatusOr<Function*> Function::Bind(FunctionBinding* binding,
   if (is_native()) {
     return this;
   }
-  const std::string type_signature =
-      TypeSpec::TypeBindingSignature(binding->type_arguments);
+  // The bindings are owned by this function, so they are allocated with
+  // the objects of its module, even when bound from another module.
+  AnalysisArena::Activation activation(arena());
+  // Existing bindings are looked up by fingerprint, and a match is
+  // checked against the argument types of the binding. The printable
+  // signature is built only for new bindings, or on fingerprint
+  // collisions, which it resolves.
+  const uint64_t type_fingerprint =
+      TypeSpec::TypeBindingFingerprint(binding->type_arguments);
 
   // TODO(catalin): this method of binding is partly annoying, because
   //   we basically produce a new function that needs to be defined in
   //   the original module for each call on the function, so we cannot
   //   keep a predefined library and redo just the binding.
   Function* bound_function = nullptr;
-  auto it = bindings_by_name_.find(type_signature);
-  if (it != bindings_by_name_.end()) {
-    bound_function = it->second.second;
+  std::string type_signature;
+  auto it = bindings_by_fingerprint_.find(type_fingerprint);
+  if (it != bindings_by_fingerprint_.end() &&
+      it->second->HasBindingTypes(binding->type_arguments)) {
+    bound_function = it->second;
+  } else {
+    type_signature = TypeSpec::TypeBindingSignature(binding->type_arguments);
+    auto it_name = bindings_by_name_.find(type_signature);
+    if (it_name != bindings_by_name_.end()) {
+      bound_function = it_name->second.second;
+    }
+  }
+  if (bound_function) {
     LOG_IF(INFO, pragma_handler()->log_bindings())
-        << "BIND LOG: " << call_name() << " Using Old bind: " << type_signature
-        << " => " << bound_function->full_name();
+        << "BIND LOG: " << call_name() << " Using Old bind: "
+        << bound_function->type_signature_ << " => "
+        << bound_function->full_name();
   } else {
     CHECK_GT(scope_name().size(), 1ul);
     ASSIGN_OR_RETURN(
@@ -1526,6 +2019,7 @@ absl::StatusOr<Function*> Function::Bind(FunctionBinding* binding,
     bound_function = bind_instance.get();
     bindings_by_name_.emplace(type_signature,
                               std::make_pair(bindings_.size(), bound_function));
+    bindings_by_fingerprint_.emplace(type_fingerprint, bound_function);
     bindings_by_function_.emplace(
         bound_function, std::make_pair(bindings_.size(), type_signature));
     std::move(mark_failed).Cancel();
@@ -1564,6 +2058,21 @@ absl::StatusOr<Function*> Function::Bind(FunctionBinding* binding,
   return bound_function;
 }
 
+bool Function::HasBindingTypes(
+    const std::vector<TypeBindingArg>& type_arguments) const {
+  if (type_arguments.size() != arguments_.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < arguments_.size(); ++i) {
+    if (!std::holds_alternative<const TypeSpec*>(type_arguments[i]) ||
+        !arguments_[i]->original_type()->HasSameSignature(
+            *std::get<const TypeSpec*>(type_arguments[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
 absl::Status Function::InitBindInstance(Function* binding_parent,
                                         absl::string_view type_signature,
                                         FunctionBinding* binding) {
@@ -1590,23 +2099,185 @@ absl::Status Function::InitBindInstance(Function* binding_parent,
   // For now just bind the source function return type:
   RETURN_IF_ERROR(UpdateFunctionType(binding->type_spec->ResultType()));
   function_body_ = binding_parent->function_body();
+  // The instances of a function imported from a module interface are
+  // used through its signature as well.
+  body_elided_ = binding_parent->body_elided();
 
   return absl::OkStatus();
 }
 
+bool Function::has_complete_signature() const {
+  if (kind_ != pb::ObjectKind::OBJ_FUNCTION &&
+      kind_ != pb::ObjectKind::OBJ_METHOD) {
+    return false;
+  }
+  return !HasUndefinedArgTypes() && type_spec_->ResultType() &&
+         type_spec_->ResultType()->IsBound();
+}
+
+bool Function::body_elided() const { return body_elided_; }
+
+bool Function::HasDeferrableBody() const {
+  auto module = module_scope();
+  if (!module || module->kind() != pb::ObjectKind::OBJ_MODULE ||
+      !static_cast<Module*>(module)->lazy_function_bodies()) {
+    return false;
+  }
+  // The signature needs to be complete without the body, so we can
+  // bind calls before building it.
+  return has_complete_signature();
+}
+
+bool Function::has_deferred_body() const {
+  return deferred_body_ == DeferredBody::kPending;
+}
+
+absl::Status Function::BuildDeferredBody() {
+  if (deferred_body_ == DeferredBody::kFailed) {
+    return deferred_body_status_;
+  }
+  if (deferred_body_ != DeferredBody::kPending) {
+    return absl::OkStatus();
+  }
+  return BuildFunctionBody();
+}
+
 absl::Status Function::BuildFunctionBody() {
-  if (!expressions_.empty()) {
-    return absl::OkStatus();  // already built
+  if (deferred_body_ == DeferredBody::kFailed) {
+    // E.g. failed on a call for which another overload was selected.
+    return deferred_body_status_;
+  }
+  if (!expressions_.empty() || body_elided_) {
+    return absl::OkStatus();  // already built, or not available
+  }
+  if (deferred_body_ == DeferredBody::kBuilding) {
+    // A recursive call, which can use the complete signature.
+    return absl::OkStatus();
   }
   RET_CHECK(function_body_ != nullptr) << kBugNotice;
+  AnalysisArena::Activation activation(arena());
+  if (deferred_body_ != DeferredBody::kPending) {
+    return BuildBodyExpressions();
+  }
+  deferred_body_ = DeferredBody::kBuilding;
+  absl::Status status = BuildBodyExpressions();
+  if (status.ok()) {
+    deferred_body_ = DeferredBody::kNone;
+  } else {
+    // The error is returned on the next requests for the body, which
+    // may be partially built, so the function is not used without it.
+    deferred_body_ = DeferredBody::kFailed;
+    deferred_body_status_ = status;
+  }
+  return status;
+}
+
+absl::Status Function::BuildBodyExpressions() {
+  built_expressions_.clear();
   ASSIGN_OR_RETURN(
       auto expression, BuildExpressionBlock(*function_body_, true),
       _ << "In function definition of: `" << function_name() << "`");
   expressions_.emplace_back(std::move(expression));
   RETURN_IF_ERROR(UpdateFunctionTypeOnResults());
+  ShareInvariantExpressions();
   return absl::OkStatus();
 }
 
+std::unique_ptr<Expression> Function::FindSharedExpression(
+    const pb::Expression& expression) {
+  if (!binding_parent_.has_value()) {
+    return nullptr;
+  }
+  const auto& shared = binding_parent_.value()->shared_expressions_;
+  auto it = shared.find(&expression);
+  if (it == shared.end()) {
+    return nullptr;
+  }
+  // The copy belongs to this bind instance, which may outlive the one
+  // that built the original.
+  auto result = it->second->CloneInScope(it->second->scope(), this);
+  // The context of the copy may provide a different type hint:
+  result->ResetNegotiatedType();
+  ++num_shared_expressions_;
+  return result;
+}
+
+void Function::RecordBuiltExpression(const pb::Expression& expression,
+                                     Expression* built_expression) {
+  if (binding_parent_.has_value()) {
+    built_expressions_.insert_or_assign(&expression, built_expression);
+  }
+}
+
+void Function::ShareInvariantExpressions() {
+  if (!binding_parent_.has_value()) {
+    return;
+  }
+  // Only expressions reachable from the body are considered, as some
+  // of the recorded ones may have been dropped during the build.
+  absl::flat_hash_map<const Expression*, bool> invariant;
+  for (const auto& expression : expressions_) {
+    IsBindingInvariant(expression.get(), &invariant);
+  }
+  auto& shared = binding_parent_.value()->shared_expressions_;
+  for (const auto& it : built_expressions_) {
+    auto invariant_it = invariant.find(it.second);
+    if (invariant_it != invariant.end() && invariant_it->second) {
+      shared.try_emplace(it.first, it.second);
+    }
+  }
+  built_expressions_.clear();
+}
+
+bool Function::IsBindingInvariant(
+    const Expression* expression,
+    absl::flat_hash_map<const Expression*, bool>* invariant) const {
+  bool is_invariant = true;
+  for (const auto& child : expression->children()) {
+    if (!IsBindingInvariant(child.get(), invariant)) {
+      is_invariant = false;
+    }
+  }
+  switch (expression->expr_kind()) {
+    case pb::ExpressionKind::EXPR_EMPTY_STRUCT:
+    case pb::ExpressionKind::EXPR_LITERAL:
+    case pb::ExpressionKind::EXPR_IDENTIFIER:
+    case pb::ExpressionKind::EXPR_ARRAY_DEF:
+    case pb::ExpressionKind::EXPR_MAP_DEF:
+    case pb::ExpressionKind::EXPR_TUPLE_DEF:
+    case pb::ExpressionKind::EXPR_INDEX:
+    case pb::ExpressionKind::EXPR_TUPLE_INDEX:
+    case pb::ExpressionKind::EXPR_DOT_ACCESS:
+      break;
+    case pb::ExpressionKind::EXPR_FUNCTION_CALL: {
+      // Method calls are built from their left expression, which is not
+      // a child, so we do not share them.
+      auto call = static_cast<const FunctionCallExpression*>(expression);
+      const FunctionBinding* binding = call->function_binding();
+      if (call->left_expression().has_value() || !binding->fun.has_value() ||
+          IsAncestorOf(binding->fun.value())) {
+        is_invariant = false;
+      }
+    } break;
+    default:
+      // Assignments, results, lambdas and control flow are tied to
+      // this bind instance.
+      is_invariant = false;
+  }
+  if (is_invariant) {
+    auto type_spec = expression->stored_type_spec();
+    auto object = expression->named_object();
+    if (!type_spec.has_value() || !type_spec.value()->IsBound() ||
+        (object.has_value() &&
+         (object.value()->kind() == pb::ObjectKind::OBJ_TYPE ||
+          IsAncestorOf(object.value())))) {
+      is_invariant = false;
+    }
+  }
+  invariant->insert_or_assign(expression, is_invariant);
+  return is_invariant;
+}
+
 namespace {
 std::string Reindent(std::string s) {
   std::vector<std::string> elements;
@@ -16,6 +16,7 @@
 #ifndef NUDL_ANALYSIS_FUNCTION_H__
 #define NUDL_ANALYSIS_FUNCTION_H__
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
@@ -24,8 +25,10 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/container/inlined_vector.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "nudl/analysis/errors.h"
 #include "nudl/analysis/expression.h"
 #include "nudl/analysis/scope.h"
@@ -70,6 +73,10 @@ struct FunctionBinding {
   // fill that that way.. to see.
   void CheckCounts() const;
 
+  // Bindings are allocated in the active AnalysisArena, if any.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
   // Tries to bind a vector of arguments to a function object.
   // TODO(catalin): Can probably change arguments to absl::Span<const...>
   static absl::StatusOr<std::unique_ptr<FunctionBinding>> Bind(
@@ -125,6 +132,18 @@ struct FunctionBinding {
   size_t arg_index = 0;
 };
 
+// Process-wide counters for the call signature caches of function groups.
+struct SignatureCacheStats {
+  // Calls resolved from the cache / that needed a full signature search.
+  size_t hits = 0;
+  size_t misses = 0;
+  // Calls with arguments that cannot be used as a cache key.
+  size_t uncacheable = 0;
+  // Number of times a group cache was cleared, upon new functions,
+  // or function type changes.
+  size_t invalidations = 0;
+};
+
 class FunctionGroup : public Scope {
  public:
   // This groups together functions defined with the same name,
@@ -142,6 +161,9 @@ class FunctionGroup : public Scope {
   ScopedName qualified_call_name() const;
 
   absl::Status AddFunction(Function* fun);
+  // Removes a function added to this group, e.g. when the module
+  // defining it is released.
+  absl::Status RemoveFunction(Function* fun);
   absl::StatusOr<ScopeName> GetNextFunctionName();
 
   absl::StatusOr<std::unique_ptr<FunctionBinding>> FindSignature(
@@ -151,6 +173,11 @@ class FunctionGroup : public Scope {
   // Function object.
   absl::optional<Function*> FindBinding(const Function* fun) const;
 
+  // Drops the cached signatures that involve types defined in the
+  // provided modules, as these are invalidated.
+  void DropModuleSignatures(
+      const absl::flat_hash_set<std::string>& module_names) const;
+
   std::string DebugString() const override;
 
   // If this corresponds to the 'main' function in a binary.
@@ -158,13 +185,78 @@ class FunctionGroup : public Scope {
 
   static bool IsFunctionGroup(const NamedObject& object);
 
+  // Returns the totals of the signature caches of all groups.
+  static SignatureCacheStats signature_cache_stats();
+
  private:
   absl::StatusOr<std::vector<std::unique_ptr<FunctionBinding>>> TryBindFunction(
       Function* function, const std::vector<FunctionCallArgument>& arguments,
       std::vector<std::unique_ptr<FunctionBinding>>* existing) const;
 
+  // A summary of a function signature, used to rule out functions
+  // that cannot bind the call arguments, before trying the full bind.
+  struct SignatureFilter {
+    // The function type from which this filter was built.
+    const TypeSpec* type_spec = nullptr;
+    // Number of arguments without a default value.
+    size_t min_args = 0;
+    // Total number of arguments.
+    size_t max_args = 0;
+    // Names of all arguments.
+    absl::flat_hash_set<std::string> arg_names;
+    // The type of first argument, if a basic type that binds only
+    // to its ancestors or descendants.
+    const TypeSpec* first_arg_type = nullptr;
+  };
+  // If the function at index may bind the provided arguments.
+  // The first_call_type is the type of the first argument, if it was
+  // determined for filtering purposes.
+  bool MayBind(size_t index, const std::vector<FunctionCallArgument>& arguments,
+               const TypeSpec* first_call_type) const;
+  // The function on which the binding of functions_[index] is performed.
+  Function* BindingFunction(size_t index) const;
+  // Full search of the functions that bind the arguments. Returns
+  // an error if none does.
+  absl::StatusOr<std::vector<std::unique_ptr<FunctionBinding>>>
+  FindMatchingSignatures(
+      const std::vector<FunctionCallArgument>& arguments) const;
+  // Drops the cached signatures if function types changed since they
+  // were cached.
+  void CheckSignatureCache() const;
+  void ClearSignatureCache() const;
+
+  // Key of the signature cache: for each call argument, its name (empty
+  // if not named), and the type_uid of its type, shifted left by one,
+  // with the low bit set for literals.
+  using SignatureKey =
+      absl::InlinedVector<std::pair<std::string, uint64_t>, 4>;
+  // The cached outcome of the signature search for a key: the index
+  // in functions_ of the function that binds the arguments, or the error
+  // if more than one function binds them.
+  struct SignatureOutcome {
+    size_t index = 0;
+    absl::Status status;
+  };
+  static bool BuildSignatureKey(
+      const std::vector<FunctionCallArgument>& arguments, SignatureKey* key,
+      absl::InlinedVector<const TypeSpec*, 4>* key_types);
+  void CacheSignature(SignatureKey key,
+                      absl::Span<const TypeSpec* const> key_types,
+                      SignatureOutcome outcome) const;
+
   const bool is_method_group_;
   std::vector<Function*> functions_;
+  // Filters for functions_ - same size, rebuilt when the function types
+  // change.
+  mutable std::vector<SignatureFilter> signature_filters_;
+  // Maps a key of the call argument names and types, to the outcome
+  // of binding them.
+  mutable absl::flat_hash_map<SignatureKey, SignatureOutcome>
+      signature_cache_;
+  // The keys in signature_cache_ that involve types defined in each
+  // module, for dropping them when the module is invalidated.
+  mutable absl::flat_hash_map<std::string, std::vector<SignatureKey>>
+      module_signatures_;
   std::vector<std::unique_ptr<TypeSpec>> types_;
   bool is_main_ = false;
 };
@@ -203,6 +295,10 @@ class Function : public Scope {
   FunctionGroup* function_group() const;
   // The scope in which the function was defined.
   Scope* definition_scope() const;
+  // The groups in type member stores in which this function was added,
+  // as a method or a constructor.
+  const std::vector<std::pair<TypeMemberStore*, FunctionGroup*>>&
+  member_groups() const;
   // All specific type bindings:
   const std::vector<std::unique_ptr<Function>>& bindings() const;
   // A set with all bindings:
@@ -214,6 +310,10 @@ class Function : public Scope {
   bindings_by_name() const;
   // Returns true if fun is a binding of this function (or itself):
   bool IsBinding(const Function* fun) const;
+  // Destroys the bindings of this function that involve types defined
+  // in the provided modules, as these are invalidated and released.
+  void DropModuleBindings(
+      const absl::flat_hash_set<std::string>& module_names);
 
   // Argument definitions of this function.
   const std::vector<std::unique_ptr<VarBase>>& arguments() const;
@@ -246,6 +346,11 @@ class Function : public Scope {
   // The possibly abstract parent that bound this function with types.
   absl::optional<Function*> binding_parent() const;
 
+  // The number of expressions in the body of this bind instance that
+  // were copied from another bind instance of the same function, instead
+  // of being analyzed again.
+  size_t num_shared_expressions() const;
+
   // Expressions that call this function.
   const std::vector<Expression*>& call_expressions() const;
   // Records a call expression for this function.
@@ -260,6 +365,21 @@ class Function : public Scope {
   // If contains undefined typed argument.
   bool HasUndefinedArgTypes() const;
 
+  // With lazy function bodies, the body of a fully typed function is built
+  // on its first call, or through BuildDeferredBody. Returns true if the
+  // body was deferred and not built yet.
+  bool has_deferred_body() const;
+  // Builds the body of this function, if it was deferred. Returns the
+  // error of a previous failed build, if any.
+  absl::Status BuildDeferredBody();
+
+  // If this is a function or method with all argument types and the
+  // result type bound, so it can be called without analyzing its body.
+  bool has_complete_signature() const;
+  // If the function was imported from a module interface, without its
+  // body, which is never built.
+  bool body_elided() const;
+
   // Creates a new function in which arguments and types are bound
   // to bound types. Possibly updates the binding->function to
   // a newly created instance
@@ -316,10 +436,35 @@ class Function : public Scope {
   absl::Status InitBindInstance(Function* binding_parent,
                                 absl::string_view type_signature,
                                 FunctionBinding* binding);
+  // If the arguments of this function have the same signatures as the
+  // type_arguments of a binding.
+  bool HasBindingTypes(const std::vector<TypeBindingArg>& type_arguments) const;
 
   // Builds the expression from function_body, and binds the computed
   // result type.
   absl::Status BuildFunctionBody();
+  // Does the actual work of BuildFunctionBody.
+  absl::Status BuildBodyExpressions();
+  // If the body of this function can be built on demand, i.e. lazy
+  // function bodies are enabled and the signature is fully typed.
+  bool HasDeferrableBody() const;
+
+  // Bind instances of a function build their body from the same proto.
+  // Expressions that do not depend on the argument types of the instance
+  // are analyzed once, and copied in the other bind instances.
+  std::unique_ptr<Expression> FindSharedExpression(
+      const pb::Expression& expression) override;
+  void RecordBuiltExpression(const pb::Expression& expression,
+                             Expression* built_expression) override;
+  // After the body of a bind instance is built, makes its binding invariant
+  // expressions available to the other instances, through binding_parent_.
+  void ShareInvariantExpressions();
+  // Returns if expression does not depend on the types of the arguments
+  // of this bind instance, storing the result for it and its children
+  // in invariant.
+  bool IsBindingInvariant(
+      const Expression* expression,
+      absl::flat_hash_map<const Expression*, bool>* invariant) const;
 
   // Used to check the result kind of a new return expression
   absl::StatusOr<pb::FunctionResultKind> RegisterResultKind(
@@ -340,6 +485,8 @@ class Function : public Scope {
   FunctionGroup* const function_group_;
   // The scope where the function was defined - may not be the parent_.
   Scope* const definition_scope_;
+  // The method / constructor groups this function was added to.
+  std::vector<std::pair<TypeMemberStore*, FunctionGroup*>> member_groups_;
   // The kind of the function:
   const pb::ObjectKind kind_;
   // Arguments of the function, in order:
@@ -380,6 +527,12 @@ class Function : public Scope {
   pb::FunctionResultKind result_kind_ = pb::FunctionResultKind::RESULT_NONE;
   // If the return type of this function was negotiated:
   bool result_type_negotiated_ = false;
+  // The state of the function body, when built on demand:
+  enum class DeferredBody { kNone, kPending, kBuilding, kFailed };
+  DeferredBody deferred_body_ = DeferredBody::kNone;
+  // The error of the failed build of a deferred body.
+  absl::Status deferred_body_status_;
+  bool body_elided_ = false;
   // Expressions that call this function.
   std::vector<Expression*> call_expressions_;
 
@@ -394,8 +547,21 @@ class Function : public Scope {
   // Map from binding type signature to bound function and index in parent.
   absl::flat_hash_map<std::string, std::pair<std::optional<size_t>, Function*>>
       bindings_by_name_;
+  // Map from binding type fingerprint to bound function, for fast lookup
+  // of existing bindings. Holds one function per fingerprint, so matches
+  // are checked with HasBindingTypes, and bindings_by_name_ decides.
+  absl::flat_hash_map<uint64_t, Function*> bindings_by_fingerprint_;
   // Binds that failed at some point, keep them around for unified destruction.
   std::vector<std::unique_ptr<Function>> failed_instances_;
+  // Expressions built in the body of this bind instance, by source proto.
+  absl::flat_hash_map<const pb::Expression*, Expression*> built_expressions_;
+  // Binding invariant expressions, built in one of the bind instances
+  // of this function, by source proto.
+  absl::flat_hash_map<const pb::Expression*, const Expression*>
+      shared_expressions_;
+  // Number of expressions copied from shared_expressions_ of the
+  // binding parent.
+  size_t num_shared_expressions_ = 0;
 };
 
 // Annotations for semi-native structure implementations, which
@@ -16,10 +16,15 @@
 
 #include "nudl/analysis/module.h"
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <functional>
+#include <thread>  // NOLINT
 #include <utility>
 
 #include "absl/cleanup/cleanup.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/functional/bind_front.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
@@ -157,6 +162,8 @@ ModuleStore::ModuleStore(std::unique_ptr<ModuleFileReader> reader,
                          Scope* built_in_scope)
     : reader_(std::move(CHECK_NOTNULL(reader))),
       built_in_scope_(built_in_scope),
+      builtin_content_hash_(ModuleContentHash(
+          built_in_scope ? built_in_scope->source_code() : "")),
       top_module_(Module::BuildTopModule(this)) {}
 
 const absl::flat_hash_map<std::string, Module*>& ModuleStore::modules() const {
@@ -178,26 +185,61 @@ absl::optional<Module*> ModuleStore::GetModule(
 
 void ModuleStore::set_module_code(absl::string_view module_name,
                                   absl::string_view module_code) {
-  module_code_.emplace(module_name, module_code);
+  module_code_.insert_or_assign(module_name, module_code);
 }
 
 absl::StatusOr<Module*> ModuleStore::ImportFromString(
     absl::string_view module_name, absl::string_view code) {
+  if (HasModule(module_name)) {
+    return status::AlreadyExistsErrorBuilder()
+           << "Module: " << module_name << " is already imported";
+  }
   std::vector<std::string> local_chain;
   ModuleFileReader::ModuleReadResult module_info{
     std::string(module_name), {}, {}, false, std::string(code)};
   auto module_result =
       Module::ParseAndImport(std::move(module_info), this, &local_chain);
   if (!module_result.ok()) {
+    ReleaseFailedModule(module_name);
     return module_result.status();
   }
   auto module = std::move(module_result).value();
   modules_.emplace(std::string(module_name), module);
+  string_module_code_.insert_or_assign(module_name, code);
+  RecordModule(module, code, true);
   return module;
 }
 
+void ModuleStore::set_use_arena(bool use_arena) { use_arena_ = use_arena; }
+
+bool ModuleStore::use_arena() const { return use_arena_; }
+
+absl::StatusOr<ModuleFileReader::ModuleReadResult> ModuleStore::ReadModule(
+    absl::string_view module_name) const {
+  auto it_code = module_code_.find(module_name);
+  if (it_code != module_code_.end()) {
+    return ModuleFileReader::ModuleReadResult{
+        std::string(module_name), std_filesystem::path("preset"),
+        std_filesystem::path(module_name), false, std::string(it_code->second)};
+  }
+  return reader_->ReadModule(module_name);
+}
+
 absl::StatusOr<Module*> ModuleStore::ImportModule(
     absl::string_view module_name, std::vector<std::string>* import_chain) {
+  // The modules imported directly need their function bodies.
+  const bool allow_interface = import_chain && !import_chain->empty();
+  return ImportModuleInternal(module_name, import_chain, allow_interface);
+}
+
+absl::StatusOr<Module*> ModuleStore::ImportModuleInterface(
+    absl::string_view module_name) {
+  return ImportModuleInternal(module_name, nullptr, true);
+}
+
+absl::StatusOr<Module*> ModuleStore::ImportModuleInternal(
+    absl::string_view module_name, std::vector<std::string>* import_chain,
+    bool allow_interface) {
   std::vector<std::string> local_chain;
   if (!import_chain) {
     import_chain = &local_chain;
@@ -215,21 +257,35 @@ absl::StatusOr<Module*> ModuleStore::ImportModule(
     return existing_module.value();
   }
   ModuleFileReader::ModuleReadResult read_result;
-  auto it_code = module_code_.find(module_name);
-  if (it_code != module_code_.end()) {
-    read_result = ModuleFileReader::ModuleReadResult{
-        std::string(module_name), std_filesystem::path("preset"),
-        std_filesystem::path(module_name), false, std::string(it_code->second)};
+  std::unique_ptr<PreparsedModule> preparsed;
+  auto it_preparsed = preparsed_modules_.find(module_name);
+  if (it_preparsed != preparsed_modules_.end()) {
+    preparsed = std::move(it_preparsed->second);
+    preparsed_modules_.erase(it_preparsed);
+    read_result = std::move(preparsed->read_result);
   } else {
-    ASSIGN_OR_RETURN(read_result, reader_->ReadModule(module_name));
+    ASSIGN_OR_RETURN(read_result, ReadModule(module_name));
   }
   const std::string filename = read_result.file_name.native();
   const std::string code = read_result.content;
+  absl::optional<Module*> interface_module;
+  if (allow_interface) {
+    interface_module = ImportFromInterface(read_result, import_chain);
+  }
+  if (interface_module.has_value()) {
+    modules_.emplace(std::string(module_name), interface_module.value());
+    RecordModule(interface_module.value(), code, false);
+    return interface_module.value();
+  }
   import_chain->emplace_back(std::string(module_name));
   auto module_result =
-      Module::ParseAndImport(std::move(read_result), this, import_chain);
+      preparsed ? Module::ImportParsed(read_result, *preparsed->module_pb,
+                                       preparsed->parse_duration, this,
+                                       import_chain)
+                : Module::ParseAndImport(read_result, this, import_chain);
   import_chain->pop_back();
   if (!module_result.ok()) {
+    ReleaseFailedModule(module_name);
     return status::StatusWriter(module_result.status())
            << "Importing module: " << module_name << ParseFileInfo{filename}
            << ParseFileContent{code};
@@ -237,25 +293,380 @@ absl::StatusOr<Module*> ModuleStore::ImportModule(
   auto module = std::move(module_result).value();
 
   modules_.emplace(std::string(module_name), module);
+  RecordModule(module, code, false);
+  auto interface = module->ReleaseInterface();
+  if (interface) {
+    // The signatures in the interface depend on the builtin module too.
+    auto builtin_dependency = interface->add_dependency();
+    builtin_dependency->set_module_name(std::string(kBuildtinModuleName));
+    builtin_dependency->set_content_hash(builtin_content_hash_);
+    for (const auto& imported_name : TransitiveImports(module_name)) {
+      auto content_hash = ModuleHash(imported_name);
+      if (content_hash.has_value()) {
+        auto dependency = interface->add_dependency();
+        dependency->set_module_name(imported_name);
+        dependency->set_content_hash(content_hash.value());
+      }
+    }
+    auto write_status =
+        WriteParseSnapshot(InterfacePath(module_name), code, *interface);
+    LOG_IF(WARNING, !write_status.ok())
+        << "Writing the interface of module: " << module_name << ": "
+        << write_status;
+  }
   return module;
 }
 
-ModuleFileReader* ModuleStore::reader() const { return reader_.get(); }
+std_filesystem::path ModuleStore::InterfacePath(
+    absl::string_view module_name) const {
+  return std_filesystem::path(interface_dir_) /
+         absl::StrCat(module_name, kInterfaceFileExtension);
+}
 
-Scope* ModuleStore::built_in_scope() const { return built_in_scope_; }
+absl::optional<Module*> ModuleStore::ImportFromInterface(
+    const ModuleFileReader::ModuleReadResult& read_result,
+    std::vector<std::string>* import_chain) {
+  if (interface_dir_.empty() ||
+      source_modules_.contains(read_result.module_name)) {
+    return {};
+  }
+  const absl::Time start_time = absl::Now();
+  auto interface_result = ReadParseSnapshot(
+      InterfacePath(read_result.module_name), read_result.content);
+  if (!interface_result.ok()) {
+    return {};
+  }
+  if (!HasCurrentDependencies(*interface_result.value())) {
+    LOG(INFO) << "Importing module: " << read_result.module_name
+              << " from source, as the modules it imports, or the builtin "
+                 "module, changed since its interface was written";
+    return {};
+  }
+  import_chain->emplace_back(read_result.module_name);
+  auto module_result =
+      Module::ImportParsed(read_result, *interface_result.value(),
+                           absl::Now() - start_time, this, import_chain);
+  import_chain->pop_back();
+  if (!module_result.ok()) {
+    // E.g. the signatures depend on imported modules that changed since.
+    LOG(WARNING) << "Importing module: " << read_result.module_name
+                 << " from source, as its interface cannot be used: "
+                 << module_result.status();
+    ReleaseFailedModule(read_result.module_name);
+    return {};
+  }
+  Module* module = module_result.value();
+  module->is_interface_ = true;
+  module->ReleaseInterface();
+  return module;
+}
 
-Module* ModuleStore::top_module() const { return top_module_.get(); }
+bool ModuleStore::HasCurrentDependencies(
+    const pb::Module& interface) const {
+  bool has_builtin_dependency = false;
+  for (const auto& dependency : interface.dependency()) {
+    if (dependency.module_name() == kBuildtinModuleName) {
+      if (dependency.content_hash() != builtin_content_hash_) {
+        return false;
+      }
+      has_builtin_dependency = true;
+      continue;
+    }
+    // The imported modules already analyzed are used as they are,
+    // the others are analyzed from their current source.
+    absl::optional<uint64_t> content_hash =
+        ModuleHash(dependency.module_name());
+    if (!content_hash.has_value()) {
+      auto read_result = ReadModule(dependency.module_name());
+      if (!read_result.ok()) {
+        return false;
+      }
+      content_hash = ModuleContentHash(read_result.value().content);
+    }
+    if (content_hash.value() != dependency.content_hash()) {
+      return false;
+    }
+  }
+  // Interfaces written without the builtin module hash are not trusted.
+  return has_builtin_dependency;
+}
 
-absl::Duration Module::parse_duration() const { return parse_duration_; }
+void ModuleStore::RecordModule(Module* module, absl::string_view code,
+                               bool is_from_string) {
+  std::vector<std::string> imports;
+  for (const auto& expression : module->expressions()) {
+    if (expression->expr_kind() !=
+        pb::ExpressionKind::EXPR_IMPORT_STATEMENT) {
+      continue;
+    }
+    const std::string& imported_name =
+        static_cast<const ImportStatementExpression*>(expression.get())
+            ->module()
+            ->module_name();
+    if (std::find(imports.begin(), imports.end(), imported_name) ==
+        imports.end()) {
+      imports.emplace_back(imported_name);
+    }
+  }
+  for (const auto& imported_name : imports) {
+    module_nodes_[imported_name].importers.emplace(module->module_name());
+  }
+  ModuleNode& node = module_nodes_[module->module_name()];
+  node.content_hash = ModuleContentHash(code);
+  node.is_from_string = is_from_string;
+  node.imports = std::move(imports);
+  import_order_.emplace_back(module->module_name());
+}
 
-absl::Duration Module::analysis_duration() const { return analysis_duration_; }
+void ModuleStore::DetachModule(absl::string_view module_name) {
+  top_module_->RemoveChildStore(module_name);
+  top_module_->type_store()->RemoveModuleScopes(module_name);
+}
+
+void ModuleStore::ReleaseFailedModule(absl::string_view module_name) {
+  // The module is registered under its name before its analysis starts.
+  Module* module = nullptr;
+  if (!modules_.contains(module_name)) {
+    auto object = top_module_->GetName(module_name, true);
+    if (object.ok() &&
+        object.value()->kind() == pb::ObjectKind::OBJ_MODULE &&
+        static_cast<Module*>(object.value())->module_name() == module_name) {
+      module = static_cast<Module*>(object.value());
+    }
+  }
+  DetachModule(module_name);
+  if (module) {
+    ReleaseModules({module});
+  }
+}
+
+std::vector<std::string> ModuleStore::ModuleImports(
+    absl::string_view module_name) const {
+  auto it = module_nodes_.find(module_name);
+  if (it == module_nodes_.end()) {
+    return {};
+  }
+  return it->second.imports;
+}
+
+std::vector<std::string> ModuleStore::TransitiveImporters(
+    absl::string_view module_name) const {
+  std::vector<std::string> result;
+  absl::flat_hash_set<std::string> seen;
+  std::vector<std::string> to_visit{std::string(module_name)};
+  while (!to_visit.empty()) {
+    const std::string crt_name(std::move(to_visit.back()));
+    to_visit.pop_back();
+    auto it = module_nodes_.find(crt_name);
+    if (it == module_nodes_.end()) {
+      continue;
+    }
+    for (const auto& importer : it->second.importers) {
+      if (seen.emplace(importer).second) {
+        result.emplace_back(importer);
+        to_visit.emplace_back(importer);
+      }
+    }
+  }
+  return result;
+}
+
+std::vector<std::string> ModuleStore::TransitiveImports(
+    absl::string_view module_name) const {
+  std::vector<std::string> result;
+  absl::flat_hash_set<std::string> seen;
+  std::vector<std::string> to_visit{std::string(module_name)};
+  while (!to_visit.empty()) {
+    const std::string crt_name(std::move(to_visit.back()));
+    to_visit.pop_back();
+    auto it = module_nodes_.find(crt_name);
+    if (it == module_nodes_.end()) {
+      continue;
+    }
+    for (const auto& imported_name : it->second.imports) {
+      if (seen.emplace(imported_name).second) {
+        result.emplace_back(imported_name);
+        to_visit.emplace_back(imported_name);
+      }
+    }
+  }
+  return result;
+}
+
+absl::optional<uint64_t> ModuleStore::ModuleHash(
+    absl::string_view module_name) const {
+  auto it = module_nodes_.find(module_name);
+  if (it == module_nodes_.end() || !modules_.contains(module_name)) {
+    return {};
+  }
+  return it->second.content_hash;
+}
+
+std::vector<std::string> ModuleStore::InvalidateModule(
+    absl::string_view module_name) {
+  if (!modules_.contains(module_name)) {
+    return {};
+  }
+  std::vector<std::string> dropped(TransitiveImporters(module_name));
+  dropped.insert(dropped.begin(), std::string(module_name));
+  const absl::flat_hash_set<std::string> dropped_set(dropped.begin(),
+                                                     dropped.end());
+  for (const auto& name : dropped) {
+    auto it = module_nodes_.find(name);
+    if (it != module_nodes_.end()) {
+      for (const auto& imported_name : it->second.imports) {
+        auto it_imported = module_nodes_.find(imported_name);
+        if (it_imported != module_nodes_.end()) {
+          it_imported->second.importers.erase(name);
+        }
+      }
+    }
+  }
+  std::vector<Module*> released;
+  for (const auto& name : import_order_) {
+    auto it = modules_.find(name);
+    if (dropped_set.contains(name) && it != modules_.end()) {
+      released.emplace_back(it->second);
+    }
+  }
+  for (const auto& name : dropped) {
+    module_nodes_.erase(name);
+    modules_.erase(name);
+    preparsed_modules_.erase(name);
+    string_module_code_.erase(name);
+    DetachModule(name);
+  }
+  import_order_.erase(
+      std::remove_if(import_order_.begin(), import_order_.end(),
+                     [&dropped_set](const std::string& name) {
+                       return dropped_set.contains(name);
+                     }),
+      import_order_.end());
+  ReleaseModules(released);
+  return dropped;
+}
+
+void ModuleStore::ReleaseModules(const std::vector<Module*>& modules) {
+  absl::flat_hash_set<std::string> module_names;
+  absl::flat_hash_set<const AnalysisArena*> arenas;
+  for (const Module* module : modules) {
+    module_names.emplace(module->module_name());
+    if (module->arena()) {
+      arenas.emplace(module->arena());
+    }
+  }
+  // The kept functions may have been bound on types of the released
+  // modules, which are analyzed again as different types.
+  if (built_in_scope_->kind() == pb::ObjectKind::OBJ_MODULE) {
+    static_cast<Module*>(built_in_scope_)
+        ->DropModuleBindings(module_names, arenas);
+  }
+  for (const auto& it : modules_) {
+    it.second->DropModuleBindings(module_names, arenas);
+  }
+  // Removes the methods and constructors of the released modules from
+  // the member stores of their types, which may be kept.
+  absl::flat_hash_map<FunctionGroup*, TypeMemberStore*> member_groups;
+  for (Module* module : modules) {
+    for (Function* fun : module->DefinedFunctions()) {
+      for (const auto& it : fun->member_groups()) {
+        auto status = it.second->RemoveFunction(fun);
+        LOG_IF(WARNING, !status.ok())
+            << "Removing released function: " << fun->full_name() << ": "
+            << status;
+        member_groups.emplace(it.second, it.first);
+      }
+    }
+  }
+  // A group created by a released module, which still has functions
+  // of kept modules, refers its module, which is then kept alive.
+  absl::flat_hash_set<const Scope*> pinned;
+  for (const auto& it : member_groups) {
+    if (!it.first->functions().empty()) {
+      pinned.emplace(it.first->module_scope());
+    } else {
+      it.second->ReleaseChildStore(it.first->call_name());
+    }
+  }
+  for (const Module* module : modules) {
+    if (pinned.contains(module)) {
+      module_names.erase(module->module_name());
+    }
+  }
+  top_module_->type_store()->ReleaseModuleTypes(module_names);
+  for (auto it = modules.rbegin(); it != modules.rend(); ++it) {
+    if (!pinned.contains(*it)) {
+      top_module_->ReleaseSubScope(*it);
+    }
+  }
+}
+
+absl::StatusOr<std::vector<std::string>>
+ModuleStore::ReimportChangedModules() {
+  const std::vector<std::string> previous_order(import_order_);
+  // Dropped with the invalidated modules, but needed for their re-import.
+  const absl::flat_hash_map<std::string, std::string> string_module_code(
+      string_module_code_);
+  std::vector<std::string> changed;
+  for (const auto& name : previous_order) {
+    const ModuleNode& node = module_nodes_.at(name);
+    if (node.is_from_string) {
+      continue;
+    }
+    auto read_result = ReadModule(name);
+    if (!read_result.ok() ||
+        ModuleContentHash(read_result.value().content) != node.content_hash) {
+      changed.emplace_back(name);
+    }
+  }
+  absl::flat_hash_set<std::string> dropped;
+  for (const auto& name : changed) {
+    for (auto& dropped_name : InvalidateModule(name)) {
+      dropped.emplace(std::move(dropped_name));
+    }
+  }
+  // The previous order ensures that the imports of a module are
+  // analyzed before it.
+  absl::Status status;
+  std::vector<std::string> reimported;
+  for (const auto& name : previous_order) {
+    if (!dropped.contains(name)) {
+      continue;
+    }
+    absl::StatusOr<Module*> result;
+    auto it_code = string_module_code.find(name);
+    if (it_code != string_module_code.end()) {
+      result = ImportFromString(name, it_code->second);
+    } else {
+      result = ImportModule(name);
+    }
+    if (result.ok()) {
+      reimported.emplace_back(name);
+    } else {
+      MergeErrorStatus(result.status(), status);
+    }
+  }
+  RETURN_IF_ERROR(status);
+  return reimported;
+}
 
 namespace {
 // TODO(catalin): hava an error reporter object here, that we use.
 absl::StatusOr<std::unique_ptr<pb::Module>> ParseToProto(
-    const ModuleFileReader::ModuleReadResult& read_result) {
+    const ModuleFileReader::ModuleReadResult& read_result,
+    ParseCache* parse_cache) {
+  if (parse_cache) {
+    auto cached_module = parse_cache->Find(read_result.content);
+    if (cached_module.has_value()) {
+      return std::move(cached_module).value();
+    }
+  }
   std::vector<grammar::ErrorInfo> errors;
-  auto parse_result = grammar::ParseModule(read_result.content, {}, &errors);
+  // The module keeps the source, so we don't need code in each element.
+  grammar::ParseOptions options;
+  options.no_code_snippets = true;
+  auto parse_result =
+      grammar::ParseModule(read_result.content, options, &errors);
   if (!parse_result.ok()) {
     auto parse_status = parse_result.status();
     status::StatusWriter writer(parse_result.status());
@@ -266,38 +677,273 @@ absl::StatusOr<std::unique_ptr<pb::Module>> ParseToProto(
            << ParseFileContent{read_result.content};
     return writer;
   }
+  if (parse_cache) {
+    auto cache_status =
+        parse_cache->Store(read_result.content, *parse_result.value());
+    if (!cache_status.ok()) {
+      LOG(WARNING) << "Caching parsed module: "
+                   << read_result.file_name.native() << ": " << cache_status;
+    }
+  }
   return parse_result;
 }
+
 }  // namespace
 
+void ParallelFor(size_t size, size_t num_threads,
+                 const std::function<void(size_t)>& process) {
+  std::atomic<size_t> next_index(0);
+  auto worker = [&next_index, size, &process]() {
+    for (size_t i = next_index++; i < size; i = next_index++) {
+      process(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < std::min(num_threads, size); ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void ModuleStore::PreparseModules(const std::vector<std::string>& module_names,
+                                  size_t num_threads) {
+  absl::flat_hash_set<std::string> seen;
+  std::vector<std::string> to_parse;
+  auto add_module = [this, &seen, &to_parse](absl::string_view module_name) {
+    if (!HasModule(module_name) && !preparsed_modules_.contains(module_name) &&
+        seen.emplace(std::string(module_name)).second) {
+      to_parse.emplace_back(std::string(module_name));
+    }
+  };
+  for (const auto& module_name : module_names) {
+    add_module(module_name);
+  }
+  while (!to_parse.empty()) {
+    const std::vector<std::string> crt_level(std::move(to_parse));
+    to_parse.clear();
+    std::vector<std::unique_ptr<PreparsedModule>> parsed(crt_level.size());
+    ParallelFor(crt_level.size(), num_threads,
+                [this, &crt_level, &parsed](size_t index) {
+                  auto read_result = ReadModule(crt_level[index]);
+                  if (!read_result.ok()) {
+                    return;
+                  }
+                  const absl::Time start_time = absl::Now();
+                  auto parse_result =
+                      ParseToProto(read_result.value(), parse_cache_.get());
+                  if (!parse_result.ok()) {
+                    return;
+                  }
+                  parsed[index] = absl::WrapUnique(new PreparsedModule{
+                      std::move(read_result).value(),
+                      std::move(parse_result).value(),
+                      absl::Now() - start_time});
+                });
+    for (size_t i = 0; i < crt_level.size(); ++i) {
+      if (!parsed[i]) {
+        continue;
+      }
+      for (const auto& element : parsed[i]->module_pb->element()) {
+        if (!element.has_import_stmt()) {
+          continue;
+        }
+        for (const auto& spec : element.import_stmt().spec()) {
+          auto module_name = NameUtil::GetFullModuleName(spec.module());
+          if (module_name.ok()) {
+            parsed[i]->imports.emplace_back(module_name.value());
+            add_module(module_name.value());
+          }
+        }
+      }
+      preparsed_modules_.emplace(crt_level[i], std::move(parsed[i]));
+    }
+  }
+}
+
+absl::StatusOr<std::vector<std::vector<std::string>>>
+ModuleStore::PreparsedImportLevels(
+    const std::vector<std::string>& module_names) const {
+  // Depth of each module in the import graph, computed depth first.
+  // Modules on the current import path are marked with nullopt.
+  absl::flat_hash_map<std::string, absl::optional<size_t>> depths;
+  std::vector<std::string> import_chain;
+  std::function<absl::StatusOr<size_t>(const std::string&)> find_depth =
+      [this, &depths, &import_chain,
+       &find_depth](const std::string& module_name) -> absl::StatusOr<size_t> {
+    auto it = depths.find(module_name);
+    if (it != depths.end()) {
+      if (!it->second.has_value()) {
+        return status::FailedPreconditionErrorBuilder()
+               << "Chain detected in import order, while importing module: "
+               << module_name
+               << ". Import stack: " << absl::StrJoin(import_chain, " => ");
+      }
+      return it->second.value();
+    }
+    depths.emplace(module_name, absl::nullopt);
+    size_t depth = 0;
+    auto it_preparsed = preparsed_modules_.find(module_name);
+    if (it_preparsed != preparsed_modules_.end()) {
+      import_chain.emplace_back(module_name);
+      for (const auto& imported_name : it_preparsed->second->imports) {
+        ASSIGN_OR_RETURN(size_t imported_depth, find_depth(imported_name));
+        depth = std::max(depth, imported_depth + 1);
+      }
+      import_chain.pop_back();
+    }
+    depths[module_name] = depth;
+    return depth;
+  };
+  std::vector<std::vector<std::string>> levels;
+  for (const auto& module_name : module_names) {
+    RETURN_IF_ERROR(find_depth(module_name).status());
+  }
+  for (const auto& it : depths) {
+    const size_t depth = it.second.value();
+    if (levels.size() <= depth) {
+      levels.resize(depth + 1);
+    }
+    levels[depth].emplace_back(it.first);
+  }
+  for (auto& level : levels) {
+    std::sort(level.begin(), level.end());
+  }
+  return levels;
+}
+
+std::unique_ptr<ModuleStore::PreparsedModule>
+ModuleStore::ReleasePreparsedModule(absl::string_view module_name) {
+  auto it = preparsed_modules_.find(module_name);
+  if (it == preparsed_modules_.end()) {
+    return nullptr;
+  }
+  auto preparsed = std::move(it->second);
+  preparsed_modules_.erase(it);
+  return preparsed;
+}
+
+void ModuleStore::AddPreparsedModule(
+    absl::string_view module_name, std::unique_ptr<PreparsedModule> preparsed) {
+  preparsed_modules_.insert_or_assign(std::string(module_name),
+                                      std::move(preparsed));
+}
+
+ModuleFileReader* ModuleStore::reader() const { return reader_.get(); }
+
+Scope* ModuleStore::built_in_scope() const { return built_in_scope_; }
+
+Module* ModuleStore::top_module() const { return top_module_.get(); }
+
+void ModuleStore::set_parse_cache(std::unique_ptr<ParseCache> parse_cache) {
+  parse_cache_ = std::move(parse_cache);
+}
+
+ParseCache* ModuleStore::parse_cache() const { return parse_cache_.get(); }
+
+void ModuleStore::set_lazy_function_bodies(bool lazy_function_bodies) {
+  lazy_function_bodies_ = lazy_function_bodies;
+}
+
+bool ModuleStore::lazy_function_bodies() const {
+  return lazy_function_bodies_;
+}
+
+absl::Status ModuleStore::SetInterfaceDir(absl::string_view interface_dir) {
+  if (!interface_dir.empty()) {
+    std::error_code error;
+    std_filesystem::create_directories(std::string(interface_dir), error);
+    if (error) {
+      return status::InternalErrorBuilder()
+             << "Cannot create module interface directory: " << interface_dir
+             << ": " << error.message();
+    }
+  }
+  interface_dir_ = std::string(interface_dir);
+  return absl::OkStatus();
+}
+
+const std::string& ModuleStore::interface_dir() const {
+  return interface_dir_;
+}
+
+void ModuleStore::AddSourceModule(absl::string_view module_name) {
+  source_modules_.emplace(module_name);
+}
+
+absl::Duration Module::parse_duration() const { return parse_duration_; }
+
+absl::Duration Module::analysis_duration() const { return analysis_duration_; }
+
 absl::StatusOr<Module*> Module::ParseAndImport(
     const ModuleFileReader::ModuleReadResult& read_result, ModuleStore* store,
     std::vector<std::string>* import_chain) {
   absl::Time start_time = absl::Now();
-  ASSIGN_OR_RETURN(auto parse_pb, ParseToProto(read_result));
+  ASSIGN_OR_RETURN(auto parse_pb,
+                   ParseToProto(read_result, store->parse_cache()));
+  return ImportParsed(read_result, *parse_pb, absl::Now() - start_time, store,
+                      import_chain);
+}
+
+absl::StatusOr<Module*> Module::ImportParsed(
+    const ModuleFileReader::ModuleReadResult& read_result,
+    const pb::Module& module_pb, absl::Duration parse_duration,
+    ModuleStore* store, std::vector<std::string>* import_chain) {
   absl::Time parse_time = absl::Now();
   ASSIGN_OR_RETURN(auto scope_name, ScopeName::Parse(read_result.module_name));
   auto pscope = std::make_shared<ScopeName>(std::move(scope_name));
+  AnalysisArena::Ptr arena;
+  if (store->use_arena()) {
+    arena = AnalysisArena::Build();
+  }
+  AnalysisArena::Activation activation(arena.get());
   auto module = absl::WrapUnique(new Module(pscope, read_result.module_name,
                                             read_result.file_name, store));
   auto pmodule = module.get();
+  pmodule->arena_ = std::move(arena);
   pmodule->is_init_module_ = read_result.is_init_module;
+  pmodule->source_code_ = read_result.content;
   RETURN_IF_ERROR(store->top_module()->AddSubScope(std::move(module)))
       << "Registering module: " << read_result.module_name;
-  RETURN_IF_ERROR(pmodule->Import(*parse_pb, import_chain));
+  RETURN_IF_ERROR(pmodule->Import(module_pb, import_chain));
   absl::Time analysis_time = absl::Now();
-  pmodule->parse_duration_ = parse_time - start_time;
+  pmodule->parse_duration_ = parse_duration;
   pmodule->analysis_duration_ = analysis_time - parse_time;
   return pmodule;
 }
 
 absl::StatusOr<std::unique_ptr<Module>> Module::ParseBuiltin(
-    std_filesystem::path file_path, const pb::Module& pb_module) {
+    std_filesystem::path file_path, const pb::Module& pb_module,
+    absl::string_view source_code, bool lazy_function_bodies,
+    bool use_arena) {
+  AnalysisArena::Ptr arena;
+  if (use_arena) {
+    arena = AnalysisArena::Build();
+  }
+  AnalysisArena::Activation activation(arena.get());
   auto module = absl::WrapUnique(new Module(file_path));
+  module->arena_ = std::move(arena);
+  module->source_code_ = std::string(source_code);
+  module->lazy_function_bodies_ = lazy_function_bodies;
   RETURN_IF_ERROR(module->Import(pb_module, nullptr));
   return {std::move(module)};
 }
 
+absl::StatusOr<std::unique_ptr<pb::Module>> Module::VerifyBuiltin(
+    std_filesystem::path file_path, const pb::Module& pb_module,
+    absl::string_view source_code) {
+  auto module = absl::WrapUnique(new Module(file_path));
+  module->source_code_ = std::string(source_code);
+  auto snapshot = std::make_unique<pb::Module>();
+  module->builtin_snapshot_ = snapshot.get();
+  RETURN_IF_ERROR(module->Import(pb_module, nullptr))
+      << "Analyzing builtin module for its snapshot";
+  module->builtin_snapshot_ = nullptr;
+  return {std::move(snapshot)};
+}
+
 std::unique_ptr<Module> Module::BuildTopModule(ModuleStore* module_store) {
   return absl::WrapUnique(new Module(module_store));
 }
@@ -331,6 +977,7 @@ Module::Module(std::shared_ptr<ScopeName> scope_name, absl::string_view name,
       module_name_(name),
       module_store_(module_store),
       module_type_(std::make_unique<TypeModule>(type_store_, name, this)),
+      lazy_function_bodies_(module_store->lazy_function_bodies()),
       pragma_handler_(this) {
   module_type_->set_definition_scope(this);
   type_store_->AddRegistrationCallback(
@@ -365,8 +1012,19 @@ absl::Status Module::Import(const pb::Module& module,
       TypeDataset::PopRegistrationStore();
     }
   };
+  // The interface of the module is built along, for writing it out.
+  std::unique_ptr<pb::Module> interface;
+  if (module_store_ && !module_store_->interface_dir().empty()) {
+    interface = std::make_unique<pb::Module>();
+  }
   for (const auto& element : module.element()) {
-    CodeContext context = CodeContext::FromProto(element);
+    CodeContext context = CodeContext::FromProto(element, source_code_);
+    if (interface) {
+      *interface->add_element() = element;
+    }
+    if (builtin_snapshot_) {
+      *builtin_snapshot_->add_element() = element;
+    }
     if (element.has_import_stmt()) {
       if (!import_chain) {
         return absl::InvalidArgumentError(
@@ -377,8 +1035,27 @@ absl::Status Module::Import(const pb::Module& module,
     } else if (element.has_schema()) {
       MergeErrorStatus(ProcessSchema(element.schema(), context), status);
     } else if (element.has_function_def()) {
-      MergeErrorStatus(ProcessFunctionDef(element.function_def(), context),
-                       status);
+      auto function_result =
+          ProcessFunctionDef(element.function_def(), context);
+      if (function_result.ok() && interface &&
+          element.function_def().has_expression_block() &&
+          function_result.value()->has_complete_signature()) {
+        // The importers need just the signature of this function.
+        auto interface_def =
+            interface->mutable_element(interface->element_size() - 1)
+                ->mutable_function_def();
+        interface_def->clear_expression_block();
+        interface_def->set_body_elided(true);
+      }
+      if (function_result.ok() && builtin_snapshot_ &&
+          function_result.value()->has_complete_signature() &&
+          !function_result.value()->expressions().empty()) {
+        builtin_snapshot_
+            ->mutable_element(builtin_snapshot_->element_size() - 1)
+            ->mutable_function_def()
+            ->set_body_verified(true);
+      }
+      MergeErrorStatus(function_result.status(), status);
     } else if (element.has_assignment()) {
       MergeErrorStatus(ProcessAssignment(element.assignment(), context),
                        status);
@@ -388,6 +1065,9 @@ absl::Status Module::Import(const pb::Module& module,
       MergeErrorStatus(ProcessTypeDef(element.type_def(), context), status);
     }
   }
+  if (interface && status.ok()) {
+    interface_ = std::move(interface);
+  }
   return status;
 }
 
@@ -465,7 +1145,7 @@ absl::Status Module::RegisterStructureConstructors(TypeStruct* type_spec,
   auto snippet = object_constructor.add_snippet();
   snippet->set_name(std::string(kStructObjectConstructor));
   snippet->set_body(name);
-  RETURN_IF_ERROR(ProcessFunctionDef(object_constructor, context))
+  RETURN_IF_ERROR(ProcessFunctionDef(object_constructor, context).status())
       << "Registering structure type default object constructor";
 
   pb::FunctionDefinition copy_constructor;
@@ -478,7 +1158,7 @@ absl::Status Module::RegisterStructureConstructors(TypeStruct* type_spec,
   snippet = copy_constructor.add_snippet();
   snippet->set_name(std::string(kStructCopyConstructor));
   snippet->set_body(name);
-  RETURN_IF_ERROR(ProcessFunctionDef(copy_constructor, context))
+  RETURN_IF_ERROR(ProcessFunctionDef(copy_constructor, context).status())
       << "Registering structure type copy object constructor";
   return absl::OkStatus();
 }
@@ -518,8 +1198,8 @@ absl::Status Module::ProcessSchema(const pb::SchemaDefinition& element,
   return absl::OkStatus();
 }
 
-absl::Status Module::ProcessFunctionDef(const pb::FunctionDefinition& element,
-                                        const CodeContext& context) {
+absl::StatusOr<Function*> Module::ProcessFunctionDef(
+    const pb::FunctionDefinition& element, const CodeContext& context) {
   ASSIGN_OR_RETURN(auto def_function,
                    Function::BuildInScope(this, element, "", context));
   expressions_.emplace_back(
@@ -534,7 +1214,7 @@ absl::Status Module::ProcessFunctionDef(const pb::FunctionDefinition& element,
     }
     main_function_ = def_function;
   }
-  return absl::OkStatus();
+  return def_function;
 }
 
 absl::Status Module::ProcessAssignment(const pb::Assignment& element,
@@ -601,6 +1281,68 @@ void Module::set_module_store(ModuleStore* module_store) {
 
 bool Module::is_init_module() const { return is_init_module_; }
 
+bool Module::lazy_function_bodies() const { return lazy_function_bodies_; }
+
+void Module::AddDeferredFunction(Function* fun) {
+  deferred_functions_.emplace_back(CHECK_NOTNULL(fun));
+}
+
+absl::Status Module::BuildDeferredBodies() {
+  absl::Status status;
+  // The bodies already built on calls are skipped by BuildDeferredBody.
+  // The failed ones are kept, so their errors are reported on each call.
+  std::vector<Function*> failed_functions;
+  for (Function* fun : deferred_functions_) {
+    auto fun_status = fun->BuildDeferredBody();
+    if (!fun_status.ok()) {
+      failed_functions.emplace_back(fun);
+      MergeErrorStatus(fun_status, status);
+    }
+  }
+  deferred_functions_ = std::move(failed_functions);
+  return status;
+}
+
+std::vector<Function*> Module::DefinedFunctions() const {
+  std::vector<Function*> result;
+  for (const auto& expression : expressions_) {
+    if (expression->expr_kind() == pb::ExpressionKind::EXPR_FUNCTION_DEF) {
+      result.emplace_back(
+          static_cast<const FunctionDefinitionExpression*>(expression.get())
+              ->def_function());
+    }
+  }
+  return result;
+}
+
+void Module::DropModuleBindings(
+    const absl::flat_hash_set<std::string>& module_names,
+    const absl::flat_hash_set<const AnalysisArena*>& arenas) {
+  DropFailedBindings(arenas);
+  for (Function* fun : DefinedFunctions()) {
+    fun->DropModuleBindings(module_names);
+    // Failed calls from the released modules would keep their arenas.
+    fun->DropFailedBindings(arenas);
+    for (const auto& binding : fun->bindings()) {
+      binding->DropFailedBindings(arenas);
+    }
+    fun->function_group()->DropModuleSignatures(module_names);
+    for (const auto& it : fun->member_groups()) {
+      it.second->DropModuleSignatures(module_names);
+    }
+  }
+}
+
+bool Module::is_interface() const { return is_interface_; }
+
+std::unique_ptr<pb::Module> Module::ReleaseInterface() {
+  return std::move(interface_);
+}
+
+absl::string_view Module::source_code() const { return source_code_; }
+
+AnalysisArena* Module::arena() const { return arena_.get(); }
+
 std::string Module::DebugString() const {
   std::vector<std::string> body;
   body.reserve(expressions_.size());
@@ -620,30 +1362,74 @@ pb::ModuleSpec Module::ToProto() const {
   return proto;
 }
 
+namespace {
+absl::StatusOr<ModuleFileReader::ModuleReadResult> ReadBuiltinFile(
+    const PathBasedFileReader& reader, const std_filesystem::path& file_path) {
+  return reader.ReadFile(file_path, ModuleFileReader::ModuleReadResult{
+                                        "", file_path, file_path, false, ""});
+}
+}  // namespace
+
 absl::StatusOr<std::unique_ptr<Environment>> Environment::Build(
-    absl::string_view main_builtin_path,
-    std::vector<std::string> search_paths) {
+    absl::string_view main_builtin_path, std::vector<std::string> search_paths,
+    const EnvironmentOptions& options) {
   ASSIGN_OR_RETURN(auto file_path, PathFromString(main_builtin_path));
+  std::unique_ptr<ParseCache> parse_cache;
+  if (!options.parse_cache_dir.empty()) {
+    ASSIGN_OR_RETURN(parse_cache, ParseCache::Build(options.parse_cache_dir));
+  }
   ASSIGN_OR_RETURN(auto reader,
                    PathBasedFileReader::Build(std::move(search_paths)));
-  ASSIGN_OR_RETURN(
-      auto read_result,
-      reader.ReadFile(file_path, ModuleFileReader::ModuleReadResult{
-                                     "", file_path, file_path, false, ""}));
+  ASSIGN_OR_RETURN(auto read_result, ReadBuiltinFile(reader, file_path));
   absl::Time start_time = absl::Now();
-  ASSIGN_OR_RETURN(auto module_pb, ParseToProto(read_result));
+  std::unique_ptr<pb::Module> module_pb;
+  if (!options.builtin_snapshot_path.empty()) {
+    auto snapshot_result = ReadParseSnapshot(
+        std_filesystem::path(options.builtin_snapshot_path),
+        read_result.content);
+    if (snapshot_result.ok()) {
+      module_pb = std::move(snapshot_result).value();
+    } else {
+      LOG(WARNING) << "Analyzing the builtin module from source, as its "
+                   << "snapshot cannot be used: " << snapshot_result.status();
+    }
+  }
+  if (!module_pb) {
+    ASSIGN_OR_RETURN(module_pb, ParseToProto(read_result, parse_cache.get()));
+  }
   absl::Time parse_time = absl::Now();
   ASSIGN_OR_RETURN(auto builtin_module,
-                   Module::ParseBuiltin(file_path, *module_pb));
+                   Module::ParseBuiltin(file_path, *module_pb,
+                                        read_result.content,
+                                        options.lazy_function_bodies,
+                                        options.use_arena));
   builtin_module->analysis_duration_ = absl::Now() - parse_time;
   builtin_module->parse_duration_ = parse_time - start_time;
   auto module_store = std::make_unique<ModuleStore>(
       std::make_unique<PathBasedFileReader>(reader), builtin_module.get());
+  module_store->set_parse_cache(std::move(parse_cache));
+  module_store->set_use_arena(options.use_arena);
+  module_store->set_lazy_function_bodies(options.lazy_function_bodies);
+  RETURN_IF_ERROR(module_store->SetInterfaceDir(options.interface_dir));
   builtin_module->set_module_store(module_store.get());
   return std::make_unique<Environment>(std::move(builtin_module),
                                        std::move(module_store));
 }
 
+absl::Status Environment::WriteBuiltinSnapshot(
+    absl::string_view main_builtin_path, absl::string_view snapshot_path) {
+  ASSIGN_OR_RETURN(auto file_path, PathFromString(main_builtin_path));
+  ASSIGN_OR_RETURN(auto output_path, PathFromString(snapshot_path));
+  ASSIGN_OR_RETURN(auto reader,
+                   PathBasedFileReader::Build(std::vector<std::string>()));
+  ASSIGN_OR_RETURN(auto read_result, ReadBuiltinFile(reader, file_path));
+  ASSIGN_OR_RETURN(auto module_pb, ParseToProto(read_result, nullptr));
+  ASSIGN_OR_RETURN(
+      auto snapshot_pb,
+      Module::VerifyBuiltin(file_path, *module_pb, read_result.content));
+  return WriteParseSnapshot(output_path, read_result.content, *snapshot_pb);
+}
+
 Environment::Environment(std::unique_ptr<Module> builtin_module,
                          std::unique_ptr<ModuleStore> module_store)
     : builtin_module_(std::move(builtin_module)),
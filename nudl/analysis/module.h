@@ -24,16 +24,21 @@ namespace std_filesystem = std::filesystem;
 namespace std_filesystem = std::experimental::filesystem;
 #endif
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "nudl/analysis/arena.h"
 #include "nudl/analysis/errors.h"
+#include "nudl/analysis/parse_cache.h"
 #include "nudl/analysis/pragma.h"
 #include "nudl/analysis/scope.h"
 #include "nudl/proto/analysis.pb.h"
@@ -69,9 +74,15 @@ class ModuleFileReader {
 };
 
 inline constexpr absl::string_view kDefaultFileExtension = ".ndl";
+inline constexpr absl::string_view kInterfaceFileExtension = ".ndli";
 inline constexpr absl::string_view kDefaultModuleFile = "__init__.ndl";
 inline constexpr absl::string_view kBuildtinModuleName = "__builtin__";
 
+// Runs process(i) for all i in [0, size), on up to num_threads threads,
+// the calling thread included.
+void ParallelFor(size_t size, size_t num_threads,
+                 const std::function<void(size_t)>& process);
+
 // Reads modules from disk, by searching their corresponding
 // paths in the provided search path order.
 class PathBasedFileReader : public ModuleFileReader {
@@ -118,11 +129,56 @@ class ModuleStore {
   absl::StatusOr<Module*> ImportModule(
       absl::string_view module_name,
       std::vector<std::string>* import_chain = nullptr);
-
-  // Imports a `module` from the code string.
+  // Imports the provided module as ImportModule, but from its interface,
+  // if one is current, as done for the modules imported by other modules.
+  // Otherwise the module is analyzed from source, writing its interface.
+  absl::StatusOr<Module*> ImportModuleInterface(absl::string_view module_name);
+
+  // Reads and parses the provided modules, and all the modules they
+  // import, directly or indirectly, using up to num_threads threads.
+  // The import graph is discovered level by level, from the import
+  // statements of the parsed modules. Subsequent ImportModule calls
+  // use the parsed modules, and still analyze them in import order.
+  // Modules that cannot be read or parsed here are skipped, and the
+  // errors are reported by the corresponding ImportModule.
+  void PreparseModules(const std::vector<std::string>& module_names,
+                       size_t num_threads);
+
+  // A module read and parsed by PreparseModules, ahead of its import.
+  struct PreparsedModule {
+    ModuleFileReader::ModuleReadResult read_result;
+    std::unique_ptr<pb::Module> module_pb;
+    absl::Duration parse_duration;
+    // Modules imported by this one, from its import statements.
+    std::vector<std::string> imports;
+  };
+  // Groups the provided modules, and the modules they import directly
+  // or indirectly, by their depth in the import graph found by
+  // PreparseModules. The modules in a level import only modules from
+  // the previous levels, so they can be analyzed independently of each
+  // other. Each level is sorted by module name. Modules that were not
+  // preparsed are placed in the first level, and report their errors on
+  // import. Returns an error on circular imports.
+  absl::StatusOr<std::vector<std::vector<std::string>>> PreparsedImportLevels(
+      const std::vector<std::string>& module_names) const;
+  // Takes out a module parsed by PreparseModules, e.g. to add it to
+  // another store. Returns null if the module was not preparsed.
+  std::unique_ptr<PreparsedModule> ReleasePreparsedModule(
+      absl::string_view module_name);
+  // Adds a module parsed in another store, to be used on its import.
+  void AddPreparsedModule(absl::string_view module_name,
+                          std::unique_ptr<PreparsedModule> preparsed);
+
+  // Imports a `module` from the code string. The module name should not
+  // be already imported (e.g. invalidate it first).
   absl::StatusOr<Module*> ImportFromString(
       absl::string_view module_name, absl::string_view code);
 
+  // If the objects of each imported module are allocated in an arena
+  // owned by the module.
+  void set_use_arena(bool use_arena);
+  bool use_arena() const;
+
   // Accessors:
   ModuleFileReader* reader() const;
   Scope* built_in_scope() const;
@@ -130,17 +186,129 @@ class ModuleStore {
 
   const absl::flat_hash_map<std::string, Module*>& modules() const;
 
-  // This can be used to set some default code for specific modules.
-  // Generally for testing.
+  // Names of the modules imported directly by the provided module.
+  std::vector<std::string> ModuleImports(absl::string_view module_name) const;
+  // Names of the modules that import the provided module, directly
+  // or indirectly.
+  std::vector<std::string> TransitiveImporters(
+      absl::string_view module_name) const;
+  // Names of the modules imported by the provided module, directly
+  // or indirectly.
+  std::vector<std::string> TransitiveImports(
+      absl::string_view module_name) const;
+  // The ModuleContentHash of the source from which a module was imported.
+  absl::optional<uint64_t> ModuleHash(absl::string_view module_name) const;
+
+  // Drops the provided module, and all the modules that import it,
+  // directly or indirectly, so they are analyzed again from source
+  // on their next import. The modules they import are kept. The dropped
+  // modules are destroyed, together with the bindings of the kept
+  // functions on their types, so pointers to their objects should not
+  // be kept past this call.
+  // Returns the names of the dropped modules.
+  std::vector<std::string> InvalidateModule(absl::string_view module_name);
+
+  // Reads the sources of the imported modules again, invalidates the
+  // ones that changed, with their importers, and imports all these again.
+  // Returns the names of the re-imported modules, in import order.
+  absl::StatusOr<std::vector<std::string>> ReimportChangedModules();
+
+  // If set, the bodies of fully typed functions in the modules imported
+  // after this call are analyzed only when called, or when requested
+  // through Function::BuildDeferredBody. Errors in these bodies are
+  // reported at that point.
+  void set_lazy_function_bodies(bool lazy_function_bodies);
+  bool lazy_function_bodies() const;
+
+  // Sets the directory for module interface files, creating it as
+  // needed. The interface of each module analyzed from source is written
+  // there, as <module name>.ndli. A module imported by other modules is
+  // then imported from its interface, when this was written for the
+  // current module source, so the bodies of its functions with complete
+  // signatures are not analyzed again. Empty for no interfaces.
+  absl::Status SetInterfaceDir(absl::string_view interface_dir);
+  const std::string& interface_dir() const;
+  // Marks a module to be always analyzed from source, e.g. as it
+  // needs to be converted.
+  void AddSourceModule(absl::string_view module_name);
+
+  // Sets a cache for the parsed modules, which are then looked up
+  // before parsing each imported module. Can be null.
+  void set_parse_cache(std::unique_ptr<ParseCache> parse_cache);
+  ParseCache* parse_cache() const;
+
+  // This can be used to set some default code for specific modules,
+  // replacing any code previously set. Generally for testing.
   void set_module_code(absl::string_view module_name,
                        absl::string_view module_code);
 
  private:
+  // Reads the content of a module, from preset code or with the reader.
+  absl::StatusOr<ModuleFileReader::ModuleReadResult> ReadModule(
+      absl::string_view module_name) const;
+  // Records the import edges and content hash of an imported module.
+  void RecordModule(Module* module, absl::string_view code,
+                    bool is_from_string);
+  // Unregisters the names of a module that is dropped.
+  void DetachModule(absl::string_view module_name);
+  // Detaches a module which failed to import, and releases it as in
+  // ReleaseModules, with its bindings, methods and types.
+  void ReleaseFailedModule(absl::string_view module_name);
+  // Destroys the provided modules, already detached, with the bindings,
+  // methods and types that refer them in the kept modules. A module that
+  // created a method group on a kept type, which still has methods of
+  // kept modules, is kept alive, as the group refers it.
+  void ReleaseModules(const std::vector<Module*>& modules);
+
+  // Path of the interface file of a module.
+  std_filesystem::path InterfacePath(absl::string_view module_name) const;
+  // Imports a module from source, or from its interface if allowed.
+  absl::StatusOr<Module*> ImportModuleInternal(
+      absl::string_view module_name, std::vector<std::string>* import_chain,
+      bool allow_interface);
+  // Imports a module from its interface, if one is available for the
+  // module source and for the current sources of the modules it imports,
+  // and the module does not need to be analyzed from source.
+  absl::optional<Module*> ImportFromInterface(
+      const ModuleFileReader::ModuleReadResult& read_result,
+      std::vector<std::string>* import_chain);
+  // If the modules imported by an interface, and the builtin module,
+  // have the same sources as when the interface was written.
+  bool HasCurrentDependencies(const pb::Module& interface) const;
+
+  // The import graph node of an imported module.
+  struct ModuleNode {
+    // ModuleContentHash of the module source.
+    uint64_t content_hash = 0;
+    // If imported with ImportFromString, so cannot be read again.
+    bool is_from_string = false;
+    // Modules imported directly by this one.
+    std::vector<std::string> imports;
+    // Modules importing this one directly.
+    absl::flat_hash_set<std::string> importers;
+  };
+
   std::unique_ptr<ModuleFileReader> reader_;
   Scope* const built_in_scope_;
+  // ModuleContentHash of the builtin module source, recorded in the
+  // module interfaces.
+  const uint64_t builtin_content_hash_;
   std::unique_ptr<Module> top_module_;
   absl::flat_hash_map<std::string, Module*> modules_;
+  absl::flat_hash_map<std::string, ModuleNode> module_nodes_;
+  // Order in which the modules finished their import.
+  std::vector<std::string> import_order_;
+  // The code of the modules imported with ImportFromString, until they
+  // are invalidated.
+  absl::flat_hash_map<std::string, std::string> string_module_code_;
   absl::flat_hash_map<std::string, std::string> module_code_;
+  std::unique_ptr<ParseCache> parse_cache_;
+  absl::flat_hash_map<std::string, std::unique_ptr<PreparsedModule>>
+      preparsed_modules_;
+  bool use_arena_ = false;
+  bool lazy_function_bodies_ = false;
+  std::string interface_dir_;
+  absl::flat_hash_set<std::string> source_modules_;
 };
 
 class TypeStruct;
@@ -150,9 +318,24 @@ class Module : public Scope {
   static absl::StatusOr<Module*> ParseAndImport(
       const ModuleFileReader::ModuleReadResult& read_result,
       ModuleStore* module_store, std::vector<std::string>* import_chain);
+  // Same as ParseAndImport, for a module that was already parsed
+  // to module_pb, in parse_duration.
+  static absl::StatusOr<Module*> ImportParsed(
+      const ModuleFileReader::ModuleReadResult& read_result,
+      const pb::Module& module_pb, absl::Duration parse_duration,
+      ModuleStore* module_store, std::vector<std::string>* import_chain);
 
   static absl::StatusOr<std::unique_ptr<Module>> ParseBuiltin(
-      std_filesystem::path file_path, const pb::Module& module);
+      std_filesystem::path file_path, const pb::Module& module,
+      absl::string_view source_code = "", bool lazy_function_bodies = false,
+      bool use_arena = false);
+  // Analyzes the builtin module, as ParseBuiltin, building all function
+  // bodies, and returns the snapshot of module for Environment. In it,
+  // the functions with a complete signature, whose bodies were built
+  // without errors, are marked as body_verified.
+  static absl::StatusOr<std::unique_ptr<pb::Module>> VerifyBuiltin(
+      std_filesystem::path file_path, const pb::Module& module,
+      absl::string_view source_code);
 
   static std::unique_ptr<Module> BuildTopModule(ModuleStore* module_store);
 
@@ -178,6 +361,35 @@ class Module : public Scope {
   // This designates if the module is a directory/__init__.ndl module.
   bool is_init_module() const;
 
+  // If the bodies of fully typed functions are built on demand.
+  bool lazy_function_bodies() const;
+  // Registers a function with a body deferred by lazy_function_bodies,
+  // or verified in the builtin snapshot.
+  void AddDeferredFunction(Function* fun);
+  // Builds the deferred bodies not already built on calls, as needed
+  // before converting the module. Returns the errors of all the deferred
+  // bodies that failed to build, including on calls.
+  absl::Status BuildDeferredBodies();
+  // The functions defined at the top level of this module.
+  std::vector<Function*> DefinedFunctions() const;
+  // Drops the bindings and cached signatures of the functions defined
+  // in this module, that involve types of the provided modules, and
+  // their failed bindings allocated in the arenas of these modules.
+  void DropModuleBindings(
+      const absl::flat_hash_set<std::string>& module_names,
+      const absl::flat_hash_set<const AnalysisArena*>& arenas);
+
+  // If the module was imported from its interface, so the bodies of its
+  // functions with complete signatures are not available.
+  bool is_interface() const;
+  // Returns the interface built while importing the module, when the
+  // module store has an interface directory. The interface contains
+  // all the module elements, except for the bodies of the functions
+  // with complete signatures.
+  std::unique_ptr<pb::Module> ReleaseInterface();
+
+  absl::string_view source_code() const override;
+  AnalysisArena* arena() const override;
   std::string DebugString() const override;
   pb::ModuleSpec ToProto() const;
 
@@ -197,8 +409,8 @@ class Module : public Scope {
                              std::vector<std::string>* import_chain);
   absl::Status ProcessSchema(const pb::SchemaDefinition& element,
                              const CodeContext& context);
-  absl::Status ProcessFunctionDef(const pb::FunctionDefinition& element,
-                                  const CodeContext& context);
+  absl::StatusOr<Function*> ProcessFunctionDef(
+      const pb::FunctionDefinition& element, const CodeContext& context);
   absl::Status ProcessAssignment(const pb::Assignment& element,
                                  const CodeContext& context);
   absl::Status ProcessPragma(const pb::PragmaExpression& element,
@@ -216,18 +428,60 @@ class Module : public Scope {
   std::unique_ptr<TypeSpec> module_type_;
   absl::optional<Function*> main_function_;
   bool is_init_module_ = false;
+  bool lazy_function_bodies_ = false;
+  // Functions registered with AddDeferredFunction.
+  std::vector<Function*> deferred_functions_;
+  bool is_interface_ = false;
+  std::unique_ptr<pb::Module> interface_;
+  // The builtin snapshot built along the analysis, in VerifyBuiltin.
+  pb::Module* builtin_snapshot_ = nullptr;
+  // The module source, for extracting the code of the parsed elements,
+  // which is not kept in the parsed protos.
+  std::string source_code_;
+  // Holds the objects analyzed in this module (see ModuleStore::use_arena).
+  // Its memory is released in bulk, once the module and the objects
+  // allocated in it from other modules are destroyed.
+  AnalysisArena::Ptr arena_;
   PragmaHandler pragma_handler_;
   absl::flat_hash_set<const TypeSpec*> registered_struct_types_;
   absl::Duration parse_duration_;
   absl::Duration analysis_duration_;
   friend class Environment;
+  friend class ModuleStore;
+};
+
+struct EnvironmentOptions {
+  // If not empty, the parsed modules are cached in this directory,
+  // and reused between runs. This includes the builtin module.
+  std::string parse_cache_dir;
+  // If true, the bodies of fully typed functions are analyzed only when
+  // called, or when requested by the converter.
+  bool lazy_function_bodies = false;
+  // If not empty, module interfaces are written to, and imported from
+  // this directory. See ModuleStore::SetInterfaceDir.
+  std::string interface_dir;
+  // If true, the analysis objects of each module (expressions, types,
+  // bindings and variables) are allocated in an arena owned by the
+  // module, and released in bulk with it.
+  bool use_arena = true;
+  // If not empty, a snapshot of the builtin module, as written by
+  // Environment::WriteBuiltinSnapshot. If created from the same builtin
+  // source, it replaces parsing the builtin module, and the function
+  // bodies verified in it are built only on first use.
+  std::string builtin_snapshot_path;
 };
 
 class Environment {
  public:
   static absl::StatusOr<std::unique_ptr<Environment>> Build(
       absl::string_view main_builtin_path,
-      std::vector<std::string> search_paths);
+      std::vector<std::string> search_paths,
+      const EnvironmentOptions& options = {});
+
+  // Analyzes the builtin module, and writes its snapshot to snapshot_path.
+  // Fails if the builtin module has errors.
+  static absl::Status WriteBuiltinSnapshot(absl::string_view main_builtin_path,
+                                           absl::string_view snapshot_path);
 
   Environment(std::unique_ptr<Module> builtin_module,
               std::unique_ptr<ModuleStore> module_store);
@@ -130,6 +130,15 @@ absl::StatusOr<NamedObject*> BaseNameStore::FindName(
   return store->GetName(scoped_name.name(), false);
 }
 
+NamedObject* BaseNameStore::LookupName(const ScopeName& lookup_scope,
+                                       const ScopedName& scoped_name) {
+  NameStore* store = LookupChildStore(scoped_name.scope_name());
+  if (!store || !store->HasName(scoped_name.name(), false)) {
+    return nullptr;
+  }
+  return store->GetName(scoped_name.name(), false).value_or(nullptr);
+}
+
 absl::Status BaseNameStore::AddName(absl::string_view local_name,
                                     NamedObject* object) {
   CHECK_NOTNULL(object);
@@ -223,21 +232,64 @@ absl::Status BaseNameStore::AddOwnedChildStore(
   return absl::OkStatus();
 }
 
-absl::StatusOr<NameStore*> BaseNameStore::FindChildStore(
-    const ScopeName& lookup_scope) {
+void BaseNameStore::RemoveChildStore(absl::string_view local_name) {
+  const absl::string_view name = NormalizeLocalName(local_name);
+  auto it = child_name_stores_.find(name);
+  if (it == child_name_stores_.end()) {
+    return;
+  }
+  auto it_object = named_objects_.find(name);
+  if (it_object != named_objects_.end() && it_object->second == it->second) {
+    named_objects_.erase(it_object);
+  }
+  child_name_stores_.erase(it);
+}
+
+std::unique_ptr<NameStore> BaseNameStore::ReleaseChildStore(
+    absl::string_view local_name) {
+  auto it = child_name_stores_.find(NormalizeLocalName(local_name));
+  if (it == child_name_stores_.end()) {
+    return nullptr;
+  }
+  const NameStore* store = it->second;
+  RemoveChildStore(local_name);
+  auto it_owned = std::find_if(
+      owned_stores_.begin(), owned_stores_.end(),
+      [store](const std::unique_ptr<NameStore>& owned) {
+        return owned.get() == store;
+      });
+  if (it_owned == owned_stores_.end()) {
+    return nullptr;
+  }
+  std::unique_ptr<NameStore> result(std::move(*it_owned));
+  owned_stores_.erase(it_owned);
+  return result;
+}
+
+NameStore* BaseNameStore::LookupChildStore(const ScopeName& lookup_scope) {
   if (lookup_scope.empty()) {
     return this;
   }
   for (size_t i = 1; i <= lookup_scope.size(); ++i) {
-    const std::string prefix(NormalizeLocalName(lookup_scope.PrefixName(i)));
-    auto it = child_name_stores_.find(prefix);
+    // Prefix scope names are interned, so this does not allocate.
+    auto it = child_name_stores_.find(
+        NormalizeLocalName(lookup_scope.PrefixScopeName(i).name()));
     if (it != child_name_stores_.end()) {
-      auto result = it->second->FindChildStore(lookup_scope.SuffixScopeName(i));
-      if (result.ok()) {
+      NameStore* result =
+          it->second->LookupChildStore(lookup_scope.SuffixScopeName(i));
+      if (result) {
         return result;
       }
     }
   }
+  return nullptr;
+}
+
+absl::StatusOr<NameStore*> BaseNameStore::FindChildStore(
+    const ScopeName& lookup_scope) {
+  if (NameStore* store = LookupChildStore(lookup_scope)) {
+    return store;
+  }
   return status::NotFoundErrorBuilder()
          << "Cannot find `" << lookup_scope.name()
          << "` "
@@ -280,6 +332,11 @@ absl::StatusOr<NamedObject*> WrappedNameStore::FindName(
   return object;
 }
 
+NamedObject* WrappedNameStore::LookupName(const ScopeName& lookup_scope,
+                                          const ScopedName& scoped_name) {
+  return wrapped_store_->LookupName(lookup_scope, scoped_name);
+}
+
 absl::Status WrappedNameStore::AddName(absl::string_view local_name,
                                        NamedObject* object) {
   RETURN_IF_ERROR(wrapped_store_->AddName(local_name, object))
@@ -325,5 +382,13 @@ absl::StatusOr<NameStore*> WrappedNameStore::FindChildStore(
   return store;
 }
 
+NameStore* WrappedNameStore::LookupChildStore(const ScopeName& lookup_scope) {
+  NameStore* store = wrapped_store_->LookupChildStore(lookup_scope);
+  if (store == wrapped_store_) {
+    return this;
+  }
+  return store;
+}
+
 }  // namespace analysis
 }  // namespace nudl
@@ -92,6 +92,13 @@ class NameStore : public NamedObject {
   virtual absl::StatusOr<NamedObject*> FindName(
       const ScopeName& lookup_scope, const ScopedName& scoped_name) = 0;
 
+  // Same lookup as FindName, but returns null when the name is not
+  // found, without building any error message. Use this when probing
+  // stores that are expected to miss, and call FindName only to obtain
+  // the error to report.
+  virtual NamedObject* LookupName(const ScopeName& lookup_scope,
+                                  const ScopedName& scoped_name) = 0;
+
   // Adds a name to the store, not owned byt this store.
   virtual absl::Status AddName(absl::string_view local_name,
                                NamedObject* object) = 0;
@@ -114,6 +121,8 @@ class NameStore : public NamedObject {
   // Finds a underlying store in this one.
   virtual absl::StatusOr<NameStore*> FindChildStore(
       const ScopeName& lookup_scope) = 0;
+  // Same as FindChildStore, but returns null when not found.
+  virtual NameStore* LookupChildStore(const ScopeName& lookup_scope) = 0;
 
   // Returns the available names in the store, mostly for error printing:
   virtual std::vector<std::string> DefinedNames() const = 0;
@@ -133,6 +142,8 @@ class BaseNameStore : public NameStore {
 
   absl::StatusOr<NamedObject*> FindName(const ScopeName& lookup_scope,
                                         const ScopedName& scoped_name) override;
+  NamedObject* LookupName(const ScopeName& lookup_scope,
+                          const ScopedName& scoped_name) override;
   absl::Status AddName(absl::string_view local_name,
                        NamedObject* object) override;
   bool HasName(absl::string_view local_name, bool in_self_only) const override;
@@ -144,6 +155,14 @@ class BaseNameStore : public NameStore {
                                   std::unique_ptr<NameStore> store) override;
   absl::StatusOr<NameStore*> FindChildStore(
       const ScopeName& lookup_scope) override;
+  NameStore* LookupChildStore(const ScopeName& lookup_scope) override;
+  // Unregisters the child store under local_name, which is no longer
+  // found by name. If owned, the store is kept alive, as other objects
+  // may still refer it.
+  void RemoveChildStore(absl::string_view local_name);
+  // Same as RemoveChildStore, but also releases the ownership of the
+  // child store, if owned. Returns null otherwise.
+  std::unique_ptr<NameStore> ReleaseChildStore(absl::string_view local_name);
 
   std::vector<std::string> DefinedNames() const override;
   std::string DebugString() const override;
@@ -166,6 +185,8 @@ class WrappedNameStore : public NameStore {
   const TypeSpec* type_spec() const override;
   absl::StatusOr<NamedObject*> FindName(const ScopeName& lookup_scope,
                                         const ScopedName& scoped_name) override;
+  NamedObject* LookupName(const ScopeName& lookup_scope,
+                          const ScopedName& scoped_name) override;
   absl::Status AddName(absl::string_view local_name,
                        NamedObject* object) override;
   bool HasName(absl::string_view local_name, bool in_self_only) const override;
@@ -177,6 +198,7 @@ class WrappedNameStore : public NameStore {
                                   std::unique_ptr<NameStore> store) override;
   absl::StatusOr<NameStore*> FindChildStore(
       const ScopeName& lookup_scope) override;
+  NameStore* LookupChildStore(const ScopeName& lookup_scope) override;
 
   std::vector<std::string> DefinedNames() const override;
   std::string DebugString() const override;
@@ -17,12 +17,15 @@
 #include "nudl/analysis/names.h"
 
 #include <algorithm>
+#include <atomic>
 #include <utility>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/flags/declare.h"
 #include "absl/flags/flag.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
+#include "absl/synchronization/mutex.h"
 #include "nudl/status/status.h"
 #include "re2/re2.h"
 
@@ -31,95 +34,358 @@ ABSL_DECLARE_FLAG(bool, nudl_short_analysis_proto);
 namespace nudl {
 namespace analysis {
 
-ScopeName::ScopeName() : hash_(std::hash<std::string>()(std::string())) {}
+// An entry in the interned scope name table. Each entry holds only its
+// full name and its last component, and refers its parent for the
+// others. All the fields, except the reference count, the release list
+// link and the subscope maps, are immutable.
+struct ScopeName::Node {
+  std::string name;
+  // The last component of the name, pointing into name. Empty for
+  // the base scope.
+  absl::string_view component;
+  // If the last component is a function name, or a module name.
+  bool is_function = false;
+  size_t num_module_names = 0;
+  size_t num_function_names = 0;
+  std::size_t hash = 0;
+  size_t id = 0;
+  // The scope name without its last component - null for the base scope.
+  // A node holds a reference to its parent.
+  const Node* parent = nullptr;
+  // Number of ScopeName handles and child nodes referring this entry,
+  // plus one while the entry is in the pending releases of the Interner.
+  mutable std::atomic<size_t> num_refs{0};
+  // Next entry in the pending releases of the Interner.
+  mutable const Node* next_release = nullptr;
+  // Scope names that append a module, respectively a function name
+  // to this one, keyed by their component. Guarded by the mutex of
+  // the Interner.
+  mutable absl::flat_hash_map<absl::string_view, const Node*> submodules;
+  mutable absl::flat_hash_map<absl::string_view, const Node*> subfunctions;
+
+  size_t size() const { return num_module_names + num_function_names; }
+};
+
+// The process-wide table of scope names. Scope names are built by
+// appending components to already interned names, starting from the
+// base scope, so each full name has exactly one entry. Entries are
+// released when the last ScopeName referring them (directly or through
+// a subscope name) goes away, so the table is bounded by the names in
+// use, and does not grow with modules that are dropped and imported
+// again by long running processes.
+//
+// The last reference to an entry is not dropped right away: it is
+// handed to a lock free list of pending releases, which are processed
+// in batches under the exclusive table lock. Lookups may take new
+// references to entries in the list, which are then kept.
+//
+// All the functions returning entries add a reference to them, which
+// is then owned by the returned ScopeName.
+class ScopeName::Interner {
+ public:
+  static Interner& Get() {
+    static Interner* const interner = new Interner();
+    return *interner;
+  }
+
+  static const Node* Ref(const Node* node) {
+    node->num_refs.fetch_add(1, std::memory_order_relaxed);
+    return node;
+  }
+
+  void Unref(const Node* node) {
+    size_t num_refs = node->num_refs.load(std::memory_order_relaxed);
+    while (num_refs > 1) {
+      if (node->num_refs.compare_exchange_weak(num_refs, num_refs - 1,
+                                               std::memory_order_acq_rel)) {
+        return;
+      }
+    }
+    // This is the last reference, which is passed to the pending releases.
+    // An entry is in the list at most once, as it holds the reference.
+    const Node* head = pending_releases_.load(std::memory_order_relaxed);
+    do {
+      node->next_release = head;
+    } while (!pending_releases_.compare_exchange_weak(
+        head, node, std::memory_order_release, std::memory_order_relaxed));
+    if (num_pending_releases_.fetch_add(1, std::memory_order_relaxed) + 1 >=
+        kReleaseBatchSize) {
+      ReleasePending();
+    }
+  }
 
-ScopeName::ScopeName(std::string name, std::vector<std::string> module_names,
-                     std::vector<std::string> function_names)
-    : name_(std::move(name)),
-      module_names_(std::move(module_names)),
-      function_names_(std::move(function_names)),
-      hash_(std::hash<std::string>()(name_)) {}
+  void ReleasePending() {
+    absl::MutexLock lock(&mutex_);
+    ReleasePendingLocked();
+  }
+
+  const Node* root() const { return Ref(root_); }
+
+  // Returns the entry for a full scope name, or null if not interned yet.
+  const Node* Find(absl::string_view name) const {
+    absl::ReaderMutexLock lock(&mutex_);
+    auto it = by_name_.find(name);
+    return it == by_name_.end() ? nullptr : Ref(it->second.get());
+  }
 
-const std::vector<std::string>& ScopeName::module_names() const {
-  return module_names_;
+  // Returns the entry that appends the (valid) name to the parent scope
+  // name, as a function or as a module name.
+  const Node* Child(const Node* parent, absl::string_view name,
+                    bool is_function) {
+    {
+      absl::ReaderMutexLock lock(&mutex_);
+      if (auto child = FindChild(parent, name, is_function)) {
+        return Ref(child);
+      }
+    }
+    absl::MutexLock lock(&mutex_);
+    if (auto child = FindChild(parent, name, is_function)) {
+      return Ref(child);
+    }
+    // Adding entries is a good point to drop the unused ones.
+    ReleasePendingLocked();
+    auto node = std::make_unique<Node>();
+    node->is_function = is_function;
+    node->num_module_names = parent->num_module_names;
+    node->num_function_names = parent->num_function_names;
+    if (is_function) {
+      ++node->num_function_names;
+      node->name = absl::StrCat(parent->name, "::", name);
+    } else {
+      CHECK_EQ(parent->num_function_names, 0)
+          << "Cannot append module: " << name
+          << " to function scope: " << parent->name;
+      ++node->num_module_names;
+      node->name = parent->name.empty()
+                       ? std::string(name)
+                       : absl::StrCat(parent->name, ".", name);
+    }
+    node->component =
+        absl::string_view(node->name).substr(node->name.size() - name.size());
+    return AddNode(parent, std::move(node));
+  }
+
+  // Same as Child, but releases the reference to the parent.
+  const Node* Append(const Node* parent, absl::string_view name,
+                     bool is_function) {
+    const Node* child = Child(parent, name, is_function);
+    // The child holds a reference to the parent, so this is not the last.
+    Unref(parent);
+    return child;
+  }
+
+  // Returns the entry for the provided (valid) name components.
+  const Node* Build(absl::Span<const std::string> module_names,
+                    absl::Span<const std::string> function_names) {
+    const Node* node = root();
+    for (const auto& name : module_names) {
+      node = Append(node, name, false);
+    }
+    for (const auto& name : function_names) {
+      node = Append(node, name, true);
+    }
+    return node;
+  }
+
+ private:
+  // Number of pending releases that triggers their processing.
+  static constexpr size_t kReleaseBatchSize = 256;
+
+  Interner() {
+    auto root = std::make_unique<Node>();
+    absl::MutexLock lock(&mutex_);
+    // The reference returned here is never released.
+    root_ = AddNode(nullptr, std::move(root));
+  }
+
+  const Node* FindChild(const Node* parent, absl::string_view name,
+                        bool is_function) const
+      ABSL_SHARED_LOCKS_REQUIRED(mutex_) {
+    const auto& children =
+        is_function ? parent->subfunctions : parent->submodules;
+    auto it = children.find(name);
+    return it == children.end() ? nullptr : it->second;
+  }
+
+  const Node* AddNode(const Node* parent, std::unique_ptr<Node> node)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    node->hash = std::hash<std::string>()(node->name);
+    // Ids are not reused, as they may still be part of cache keys.
+    node->id = next_id_++;
+    node->num_refs.store(1, std::memory_order_relaxed);
+    if (parent) {
+      node->parent = Ref(parent);
+      (node->is_function ? parent->subfunctions : parent->submodules)
+          .emplace(node->component, node.get());
+    }
+    const Node* result = node.get();
+    by_name_.emplace(result->name, std::move(node));
+    return result;
+  }
+
+  // Drops the references held by the pending releases. As lookups are
+  // excluded, entries left with no references cannot be revived, and
+  // are removed, together with their parents left unreferenced.
+  void ReleasePendingLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    num_pending_releases_.store(0, std::memory_order_relaxed);
+    const Node* node =
+        pending_releases_.exchange(nullptr, std::memory_order_acquire);
+    while (node) {
+      const Node* next = node->next_release;
+      const Node* crt_node = node;
+      while (crt_node &&
+             crt_node->num_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        crt_node = Erase(crt_node);
+      }
+      node = next;
+    }
+  }
+
+  // Removes the entry with no references from the table, and returns
+  // its parent, which needs to be released.
+  const Node* Erase(const Node* node) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    const Node* parent = node->parent;
+    if (parent) {
+      (node->is_function ? parent->subfunctions : parent->submodules)
+          .erase(node->component);
+    }
+    // This destroys the node, including the name referred by the keys.
+    by_name_.erase(by_name_.find(node->name));
+    return parent;
+  }
+
+  mutable absl::Mutex mutex_;
+  const Node* root_ = nullptr;
+  size_t next_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Owns the entries. Keys point to the names in the entries.
+  absl::flat_hash_map<absl::string_view, std::unique_ptr<Node>> by_name_
+      ABSL_GUARDED_BY(mutex_);
+  // Entries whose last reference was dropped, linked by next_release.
+  std::atomic<const Node*> pending_releases_{nullptr};
+  std::atomic<size_t> num_pending_releases_{0};
+};
+
+ScopeName::ScopeName() : node_(Interner::Get().root()) {}
+
+ScopeName::ScopeName(const Node* node) : node_(CHECK_NOTNULL(node)) {}
+
+ScopeName::ScopeName(absl::Span<const std::string> module_names,
+                     absl::Span<const std::string> function_names)
+    : node_(Interner::Get().Build(module_names, function_names)) {}
+
+ScopeName::ScopeName(const ScopeName& other)
+    : node_(Interner::Ref(other.node_)) {}
+
+ScopeName& ScopeName::operator=(const ScopeName& other) {
+  if (node_ != other.node_) {
+    Interner::Get().Unref(std::exchange(node_, Interner::Ref(other.node_)));
+  }
+  return *this;
 }
-const std::vector<std::string>& ScopeName::function_names() const {
-  return function_names_;
+
+ScopeName::~ScopeName() { Interner::Get().Unref(node_); }
+
+void ScopeName::ReleaseUnusedNames() { Interner::Get().ReleasePending(); }
+
+std::vector<std::string> ScopeName::module_names() const {
+  std::vector<std::string> names(node_->num_module_names);
+  for (const Node* node = node_; node->parent; node = node->parent) {
+    if (!node->is_function) {
+      names[node->num_module_names - 1] = std::string(node->component);
+    }
+  }
+  return names;
 }
-const std::string& ScopeName::name() const { return name_; }
 
-std::string ScopeName::module_name() const {
-  return absl::StrJoin(module_names_, ".");
+std::vector<std::string> ScopeName::function_names() const {
+  std::vector<std::string> names(node_->num_function_names);
+  for (const Node* node = node_; node->is_function; node = node->parent) {
+    names[node->num_function_names - 1] = std::string(node->component);
+  }
+  return names;
 }
 
-std::string ScopeName::function_name() const {
-  return absl::StrJoin(function_names_, "::");
+size_t ScopeName::num_module_names() const { return node_->num_module_names; }
+
+size_t ScopeName::num_function_names() const {
+  return node_->num_function_names;
 }
 
-bool ScopeName::empty() const {
-  return module_names_.empty() && function_names_.empty();
+const std::string& ScopeName::name() const { return node_->name; }
+
+std::string ScopeName::module_name() const {
+  if (!node_->num_function_names) {
+    return node_->name;
+  }
+  return node_->name.substr(0, node_->name.find("::"));
 }
 
-size_t ScopeName::size() const {
-  return module_names_.size() + function_names_.size();
+std::string ScopeName::function_name() const {
+  if (!node_->num_function_names) {
+    return std::string();
+  }
+  return node_->name.substr(node_->name.find("::") + 2);
 }
 
-std::size_t ScopeName::hash() const { return hash_; }
+bool ScopeName::empty() const { return node_->parent == nullptr; }
+
+size_t ScopeName::size() const { return node_->size(); }
+
+std::size_t ScopeName::hash() const { return node_->hash; }
+
+size_t ScopeName::id() const { return node_->id; }
 
 absl::StatusOr<ScopeName> ScopeName::Parse(absl::string_view name) {
+  Interner& interner = Interner::Get();
   if (name.empty()) {
     return ScopeName();
   }
-  std::vector<std::string> pieces =
+  if (auto node = interner.Find(name)) {
+    return ScopeName(node);
+  }
+  std::vector<absl::string_view> pieces =
       absl::StrSplit(name, absl::MaxSplits("::", 1));
   RET_CHECK(!pieces.empty());
-  std::vector<std::string> module_names, function_names;
+  ScopeName scope_name;
   if (!pieces[0].empty()) {
     for (absl::string_view crt_name : absl::StrSplit(pieces[0], '.')) {
-      ASSIGN_OR_RETURN(std::string module_name,
-                       NameUtil::ValidatedName(std::string(crt_name)),
-                       _ << "Invalid module name: `" << crt_name
-                         << "`, "
-                            "in scope name: `"
-                         << name << "`");
-      module_names.emplace_back(std::move(module_name));
+      if (!NameUtil::IsValidName(crt_name)) {
+        return status::InvalidArgumentErrorBuilder()
+               << "Invalid module name: `" << crt_name
+               << "`, in scope name: `" << name << "`";
+      }
+      scope_name =
+          ScopeName(interner.Child(scope_name.node_, crt_name, false));
     }
   }
   if (pieces.size() > 1) {
     for (absl::string_view crt_name : absl::StrSplit(pieces[1], "::")) {
-      ASSIGN_OR_RETURN(std::string function_name,
-                       NameUtil::ValidatedName(std::string(crt_name)),
-                       _ << "Invalid function name: `" << crt_name
-                         << "`, "
-                            "in scope name: `"
-                         << name << "`");
-      function_names.emplace_back(std::move(function_name));
+      if (!NameUtil::IsValidName(crt_name)) {
+        return status::InvalidArgumentErrorBuilder()
+               << "Invalid function name: `" << crt_name
+               << "`, in scope name: `" << name << "`";
+      }
+      scope_name =
+          ScopeName(interner.Child(scope_name.node_, crt_name, true));
     }
   }
-  return ScopeName(std::string(name), std::move(module_names),
-                   std::move(function_names));
+  return scope_name;
 }
 
 absl::StatusOr<ScopeName> ScopeName::FromProto(const pb::ScopeName& proto) {
-  std::vector<std::string> module_names, function_names;
-  module_names.reserve(proto.module_name().size());
+  Interner& interner = Interner::Get();
+  ScopeName scope_name;
   for (const auto& name : proto.module_name()) {
-    ASSIGN_OR_RETURN(std::string mname, NameUtil::ValidatedName(name),
-                     _ << "For module name in ScopeName proto");
-    module_names.emplace_back(std::move(mname));
+    RETURN_IF_ERROR(NameUtil::ValidatedName(name).status())
+        << "For module name in ScopeName proto";
+    scope_name = ScopeName(interner.Child(scope_name.node_, name, false));
   }
-  function_names.reserve(proto.function_name().size());
   for (const auto& name : proto.function_name()) {
-    ASSIGN_OR_RETURN(std::string fname, NameUtil::ValidatedName(name),
-                     _ << "For function name in ScopeName proto");
-    function_names.emplace_back(std::move(fname));
-  }
-  std::string full_name(absl::StrJoin(module_names, "."));
-  if (!function_names.empty()) {
-    absl::StrAppend(&full_name, "::", absl::StrJoin(function_names, "::"));
+    RETURN_IF_ERROR(NameUtil::ValidatedName(name).status())
+        << "For function name in ScopeName proto";
+    scope_name = ScopeName(interner.Child(scope_name.node_, name, true));
   }
-  return ScopeName(std::move(full_name), std::move(module_names),
-                   std::move(function_names));
+  return scope_name;
 }
 
 pb::ScopeName ScopeName::ToProto() const {
@@ -128,10 +394,10 @@ pb::ScopeName ScopeName::ToProto() const {
     proto.set_name(name());
     return proto;
   }
-  for (const auto& name : module_names_) {
+  for (const auto& name : module_names()) {
     proto.add_module_name(name);
   }
-  for (const auto& name : function_names_) {
+  for (const auto& name : function_names()) {
     proto.add_function_name(name);
   }
   return proto;
@@ -140,10 +406,10 @@ pb::ScopeName ScopeName::ToProto() const {
 pb::Identifier ScopeName::ToIdentifier() const {
   pb::Identifier identifier;
   identifier.mutable_name()->Reserve(size() + 1);
-  for (const auto& name : module_names_) {
+  for (const auto& name : module_names()) {
     identifier.add_name(name);
   }
-  for (const auto& name : function_names_) {
+  for (const auto& name : function_names()) {
     identifier.add_name(name);
   }
   return identifier;
@@ -153,15 +419,14 @@ absl::StatusOr<ScopeName> ScopeName::Submodule(absl::string_view name) const {
   if (!NameUtil::IsValidName(name)) {
     return status::InvalidArgumentErrorBuilder()
            << "Invalid submodule name: `" << name << "` to append to: `"
-           << name_ << "`";
+           << this->name() << "`";
+  }
+  if (num_function_names() == 0) {
+    return ScopeName(Interner::Get().Child(node_, name, false));
   }
-  std::vector<std::string> module_names(module_names_);
+  std::vector<std::string> module_names(this->module_names());
   module_names.emplace_back(std::string(name));
-  // Order or evaluation in parameters is compiler dependent.
-  // Compute this here first, not as a function parameter.
-  std::string full_name(Recompose(module_names, function_names_));
-  return ScopeName(std::move(full_name), std::move(module_names),
-                   function_names_);
+  return ScopeName(module_names, function_names());
 }
 
 absl::StatusOr<ScopeName> ScopeName::Subfunction(absl::string_view name) const {
@@ -169,32 +434,19 @@ absl::StatusOr<ScopeName> ScopeName::Subfunction(absl::string_view name) const {
   if (!NameUtil::IsValidName(name)) {
     return status::InvalidArgumentErrorBuilder()
            << "Invalid subfunction name: `" << name << "` to append to: `"
-           << name_ << "`";
+           << this->name() << "`";
   }
-  std::vector<std::string> function_names(function_names_);
-  function_names.emplace_back(std::string(name));
-  std::string full_name(Recompose(module_names_, function_names));
-  return ScopeName(std::move(full_name), module_names_,
-                   std::move(function_names));
+  return ScopeName(Interner::Get().Child(node_, name, true));
 }
 
 absl::StatusOr<ScopeName> ScopeName::Subname(absl::string_view name) const {
   if (!NameUtil::IsValidName(name)) {
     return status::InvalidArgumentErrorBuilder()
-           << "Invalid name: `" << name << "` to append to: `" << name_ << "`";
-  }
-  if (function_names_.empty()) {
-    std::vector<std::string> module_names(module_names_);
-    module_names.emplace_back(std::string(name));
-    std::string full_name(Recompose(module_names, {}));
-    return ScopeName(std::move(full_name), std::move(module_names), {});
-  } else {
-    std::vector<std::string> function_names(function_names_);
-    function_names.emplace_back(std::string(name));
-    std::string full_name(Recompose(module_names_, function_names));
-    return ScopeName(std::move(full_name), module_names_,
-                     std::move(function_names));
+           << "Invalid name: `" << name << "` to append to: `" << this->name()
+           << "`";
   }
+  return ScopeName(
+      Interner::Get().Child(node_, name, num_function_names() > 0));
 }
 
 std::string ScopeName::Recompose(
@@ -208,96 +460,75 @@ std::string ScopeName::Recompose(
 }
 
 std::string ScopeName::PrefixName(size_t position) const {
-  if (position >= size()) {
-    return name_;
-  }
-  if (position <= module_names_.size()) {
-    return Recompose(absl::Span(module_names_.data(), position), {});
-  }
-  position -= module_names_.size();
-  CHECK_LT(position, function_names_.size());
-  return Recompose(module_names_, absl::Span(function_names_.data(), position));
+  return PrefixScopeName(position).name();
 }
 
 ScopeName ScopeName::PrefixScopeName(size_t position) const {
-  if (position >= size()) {
-    return *this;
+  const Node* node = node_;
+  while (node->size() > position) {
+    node = node->parent;
   }
-  std::string name(PrefixName(position));
-  if (position <= module_names_.size()) {
-    return ScopeName(std::move(name),
-                     {module_names_.begin(), module_names_.begin() + position},
-                     {});
-  }
-  position -= module_names_.size();
-  CHECK_LT(position, function_names_.size());
-  return ScopeName(
-      std::move(name), module_names_,
-      {function_names_.begin(), function_names_.begin() + position});
+  return ScopeName(Interner::Ref(node));
 }
 
 std::string ScopeName::SuffixName(size_t position) const {
   if (position >= size()) {
     return std::string();
   }
-  if (position < module_names_.size()) {
-    return Recompose(absl::Span(module_names_.data() + position,
-                                module_names_.size() - position),
-                     function_names_);
+  const auto& module_names = this->module_names();
+  const auto& function_names = this->function_names();
+  if (position < module_names.size()) {
+    return Recompose(absl::Span(module_names.data() + position,
+                                module_names.size() - position),
+                     function_names);
   }
-  position -= module_names_.size();
-  CHECK_LT(position, function_names_.size());
-  return Recompose({}, absl::Span(function_names_.data() + position,
-                                  function_names_.size() - position));
+  position -= module_names.size();
+  CHECK_LT(position, function_names.size());
+  return Recompose({}, absl::Span(function_names.data() + position,
+                                  function_names.size() - position));
 }
 
 ScopeName ScopeName::SuffixScopeName(size_t position) const {
   if (position >= size()) {
     return ScopeName();
   }
-  std::string name(SuffixName(position));
-  if (position < module_names_.size()) {
-    return ScopeName(std::move(name),
-                     {module_names_.begin() + position, module_names_.end()},
-                     function_names_);
+  const auto& module_names = this->module_names();
+  const auto& function_names = this->function_names();
+  if (position < module_names.size()) {
+    return ScopeName(absl::Span(module_names.data() + position,
+                                module_names.size() - position),
+                     function_names);
   }
-  position -= module_names_.size();
-  CHECK_LT(position, function_names_.size());
-  return ScopeName(std::move(name), {},
-                   {function_names_.begin() + position, function_names_.end()});
+  position -= module_names.size();
+  CHECK_LT(position, function_names.size());
+  return ScopeName({}, absl::Span(function_names.data() + position,
+                                  function_names.size() - position));
 }
 
 ScopeName ScopeName::Subscope(const ScopeName& scope_name) const {
   if (scope_name.empty()) {
     return *this;
   }
-  if (!function_names_.empty() && (!scope_name.module_names().empty() ||
-                                   scope_name.function_names().empty())) {
+  if (num_function_names() > 0 && (scope_name.num_module_names() > 0 ||
+                                    scope_name.num_function_names() == 0)) {
     return *this;
   }
-  std::vector<std::string> module_names(module_names_);
-  std::copy(scope_name.module_names().begin(), scope_name.module_names().end(),
-            std::back_inserter(module_names));
-  std::vector<std::string> function_names(function_names_);
-  std::copy(scope_name.function_names().begin(),
-            scope_name.function_names().end(),
-            std::back_inserter(function_names));
-  std::string subname(Recompose(module_names, function_names));
-  return ScopeName(std::move(subname), std::move(module_names),
-                   std::move(function_names));
+  Interner& interner = Interner::Get();
+  const Node* node = Interner::Ref(node_);
+  for (const auto& name : scope_name.module_names()) {
+    node = interner.Append(node, name, false);
+  }
+  for (const auto& name : scope_name.function_names()) {
+    node = interner.Append(node, name, true);
+  }
+  return ScopeName(node);
 }
 
 bool ScopeName::IsPrefixScope(const ScopeName& scope_name) const {
-  if (name().empty()) {
-    return true;
-  }
-  if (!absl::StartsWith(scope_name.name(), name())) {
+  if (scope_name.size() < size()) {
     return false;
   }
-  const absl::string_view suffix(
-      absl::string_view(scope_name.name()).substr(name().size()));
-  return (suffix.empty() || absl::StartsWith(suffix, ".") ||
-          absl::StartsWith(suffix, "::"));
+  return scope_name.PrefixScopeName(size()) == *this;
 }
 
 ScopedName::ScopedName(std::shared_ptr<ScopeName> scope_name,
@@ -37,6 +37,14 @@ namespace analysis {
 // <function_name> = [ '::' <name> ] +
 // We reserve empty scope name for built-in scope, in which
 // we place all built-in types and functions.
+//
+// Scope names are interned in a process-wide table: a ScopeName is a
+// reference counted handle to an immutable table entry, so copies,
+// equality and hashing are O(1), and prefix / subscope operations do
+// not allocate once the resulting names were seen before. An entry
+// stores its full name and last component, and refers the entry of its
+// prefix for the rest. Entries no longer referred are released in
+// batches.
 class ScopeName {
  public:
   // Builder function - use this to construct a ScopeName.
@@ -45,13 +53,20 @@ class ScopeName {
   //  - reading it from a proto representation.
   static absl::StatusOr<ScopeName> FromProto(const pb::ScopeName& proto);
 
-  // Prefer using the Parse.
+  // Prefer using the Parse. The names are expected to be valid.
   ScopeName();
-  ScopeName(std::string name, std::vector<std::string> module_names,
-            std::vector<std::string> function_names);
-
-  const std::vector<std::string>& module_names() const;
-  const std::vector<std::string>& function_names() const;
+  ScopeName(absl::Span<const std::string> module_names,
+            absl::Span<const std::string> function_names);
+  ScopeName(const ScopeName& other);
+  ScopeName& operator=(const ScopeName& other);
+  ~ScopeName();
+
+  // The components of the name, rebuilt on each call.
+  std::vector<std::string> module_names() const;
+  std::vector<std::string> function_names() const;
+  // Number of module / function name components.
+  size_t num_module_names() const;
+  size_t num_function_names() const;
 
   // Full name of a scope.
   const std::string& name() const;
@@ -69,6 +84,14 @@ class ScopeName {
   // Hasing value for this object.
   std::size_t hash() const;
 
+  // Unique identifier of this scope name in the process-wide table.
+  // Equal scope names have equal ids. Ids are not reused after the
+  // entry of a scope name is released.
+  size_t id() const;
+
+  bool operator==(const ScopeName& other) const { return node_ == other.node_; }
+  bool operator!=(const ScopeName& other) const { return node_ != other.node_; }
+
   // Recomposes a partial prefix name up to the provided positon.
   // Starts with module names, then advance to function names.
   std::string PrefixName(size_t position) const;
@@ -103,16 +126,22 @@ class ScopeName {
   // Converts this to an Identifier proto.
   pb::Identifier ToIdentifier() const;
 
+  // Releases the table entries of the scope names no longer in use,
+  // without waiting for a full batch of them. Generally for testing.
+  static void ReleaseUnusedNames();
+
   // Recomposes a name from components:
   static std::string Recompose(
       const absl::Span<const std::string>& module_names,
       const absl::Span<const std::string>& function_names);
 
  private:
-  std::string name_;
-  std::vector<std::string> module_names_;
-  std::vector<std::string> function_names_;
-  std::size_t hash_ = 0;
+  struct Node;
+  class Interner;
+  // Takes ownership of a reference to node.
+  explicit ScopeName(const Node* node);
+
+  const Node* node_;
 };
 
 // A name inside a scope.
@@ -173,7 +202,7 @@ namespace std {
 // Hashing for ScopeNames
 template <>
 struct hash<nudl::analysis::ScopeName> {
-  std::size_t operator()(const nudl::analysis::ScopeName& name) {
+  std::size_t operator()(const nudl::analysis::ScopeName& name) const {
     return name.hash();
   }
 };
@@ -0,0 +1,162 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "nudl/analysis/parse_cache.h"
+
+#include <fstream>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "nudl/grammar/dsl.h"
+#include "nudl/status/status.h"
+
+namespace nudl {
+namespace analysis {
+
+namespace {
+// FNV-1a hash, which, unlike absl::Hash, is stable between processes.
+uint64_t StableHash(absl::string_view data, uint64_t hash) {
+  static constexpr uint64_t kFnvPrime = 0x100000001b3ull;
+  for (const char c : data) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+static constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ull;
+}  // namespace
+
+uint64_t ModuleContentHash(absl::string_view code) {
+  return StableHash(code, kFnvOffsetBasis ^ code.size());
+}
+
+absl::StatusOr<std::unique_ptr<ParseCache>> ParseCache::Build(
+    absl::string_view cache_dir) {
+  std_filesystem::path path;
+  try {
+    path = std_filesystem::path(cache_dir);
+    std_filesystem::create_directories(path);
+  } catch (const std_filesystem::filesystem_error& ex) {
+    return status::InvalidArgumentErrorBuilder()
+           << "Cannot create parse cache directory: `" << cache_dir
+           << "`: " << ex.what();
+  }
+  return std::make_unique<ParseCache>(std::move(path));
+}
+
+ParseCache::ParseCache(std_filesystem::path cache_dir)
+    : cache_dir_(std::move(cache_dir)) {}
+
+const std_filesystem::path& ParseCache::cache_dir() const {
+  return cache_dir_;
+}
+
+size_t ParseCache::hits() const { return hits_; }
+
+size_t ParseCache::misses() const { return misses_; }
+
+std_filesystem::path ParseCache::CachePath(absl::string_view code) const {
+  const uint64_t hash = StableHash(
+      code, StableHash(grammar::kGrammarVersion, kFnvOffsetBasis) ^
+                code.size());
+  return cache_dir_ /
+         absl::StrCat(absl::Hex(hash, absl::kZeroPad16), ".module.pb");
+}
+
+absl::optional<std::unique_ptr<pb::Module>> ParseCache::Find(
+    absl::string_view code) {
+  auto result = ReadParseSnapshot(CachePath(code), code);
+  if (!result.ok()) {
+    ++misses_;
+    return {};
+  }
+  ++hits_;
+  return {std::move(result).value()};
+}
+
+absl::Status ParseCache::Store(absl::string_view code,
+                               const pb::Module& module) const {
+  return WriteParseSnapshot(CachePath(code), code, module);
+}
+
+absl::StatusOr<std::unique_ptr<pb::Module>> ReadParseSnapshot(
+    const std_filesystem::path& path, absl::string_view code) {
+  std::ifstream infile(path, std::ios::in | std::ios::binary);
+  if (!infile.is_open()) {
+    return status::NotFoundErrorBuilder()
+           << "Cannot open parse snapshot: " << path.native();
+  }
+  pb::ParseCacheEntry entry;
+  if (!entry.ParseFromIstream(&infile)) {
+    return status::DataLossErrorBuilder()
+           << "Invalid parse snapshot: " << path.native();
+  }
+  if (entry.grammar_version() != grammar::kGrammarVersion) {
+    return status::FailedPreconditionErrorBuilder()
+           << "Parse snapshot: " << path.native()
+           << " was created with grammar version: "
+           << entry.grammar_version()
+           << ", current version: " << grammar::kGrammarVersion;
+  }
+  if (entry.content() != code) {
+    return status::FailedPreconditionErrorBuilder()
+           << "Parse snapshot: " << path.native()
+           << " was created from a different source";
+  }
+  auto module = std::make_unique<pb::Module>();
+  module->Swap(entry.mutable_module());
+  return {std::move(module)};
+}
+
+absl::Status WriteParseSnapshot(const std_filesystem::path& path,
+                                absl::string_view code,
+                                const pb::Module& module) {
+  pb::ParseCacheEntry entry;
+  entry.set_grammar_version(std::string(grammar::kGrammarVersion));
+  entry.set_content(std::string(code));
+  *entry.mutable_module() = module;
+  // Write to a temporary file first, then rename, so concurrent
+  // processes never read partially written snapshots.
+  const std_filesystem::path tmp_path(
+      absl::StrCat(path.native(), ".", absl::ToUnixNanos(absl::Now()), ".",
+                   reinterpret_cast<uintptr_t>(&entry), ".tmp"));
+  std::ofstream ofile(tmp_path,
+                      std::ios::out | std::ios::trunc | std::ios::binary);
+  if (!ofile.is_open()) {
+    return status::InternalErrorBuilder()
+           << "Cannot open parse snapshot file: " << tmp_path.native();
+  }
+  const bool written = entry.SerializeToOstream(&ofile);
+  ofile.close();
+  std::error_code error;
+  if (!written || ofile.fail()) {
+    std_filesystem::remove(tmp_path, error);
+    return status::InternalErrorBuilder()
+           << "Error writing parse snapshot file: " << tmp_path.native();
+  }
+  std_filesystem::rename(tmp_path, path, error);
+  if (error) {
+    std_filesystem::remove(tmp_path, error);
+    return status::InternalErrorBuilder()
+           << "Error renaming parse snapshot file to: " << path.native();
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace analysis
+}  // namespace nudl
@@ -0,0 +1,93 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef NUDL_ANALYSIS_PARSE_CACHE_H__
+#define NUDL_ANALYSIS_PARSE_CACHE_H__
+
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 8)
+#include <filesystem>
+namespace std_filesystem = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace std_filesystem = std::experimental::filesystem;
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "nudl/proto/dsl.pb.h"
+
+namespace nudl {
+namespace analysis {
+
+// Hash of the source code of a module, stable between processes.
+uint64_t ModuleContentHash(absl::string_view code);
+
+// Reads a parsed module snapshot, as written by WriteParseSnapshot.
+// Returns an error if the file cannot be read, or if the snapshot was
+// not produced from code, using the current grammar version.
+absl::StatusOr<std::unique_ptr<pb::Module>> ReadParseSnapshot(
+    const std_filesystem::path& path, absl::string_view code);
+
+// Writes a snapshot of the module parsed from code to path. The file is
+// replaced atomically, so concurrent readers never see partial content.
+absl::Status WriteParseSnapshot(const std_filesystem::path& path,
+                                absl::string_view code,
+                                const pb::Module& module);
+
+// Stores parsed modules on disk, under a cache directory, keyed by
+// the hash of the module code and the grammar version. This allows
+// us to skip the parsing of module files that did not change
+// between runs. Can be used from multiple threads.
+class ParseCache {
+ public:
+  // Builds a cache under cache_dir, creating the directory as needed.
+  static absl::StatusOr<std::unique_ptr<ParseCache>> Build(
+      absl::string_view cache_dir);
+
+  explicit ParseCache(std_filesystem::path cache_dir);
+
+  // Returns the cached parsed module for the provided code, if any.
+  // Unreadable or stale cache entries are treated as missing.
+  absl::optional<std::unique_ptr<pb::Module>> Find(absl::string_view code);
+
+  // Stores the parsed module for the provided code in the cache.
+  absl::Status Store(absl::string_view code, const pb::Module& module) const;
+
+  // The file under cache_dir that stores the parsed version of code.
+  std_filesystem::path CachePath(absl::string_view code) const;
+
+  const std_filesystem::path& cache_dir() const;
+  // Number of modules found / not found in the cache.
+  size_t hits() const;
+  size_t misses() const;
+
+ private:
+  const std_filesystem::path cache_dir_;
+  // Counters are atomic as the cache may be used from parsing threads.
+  std::atomic<size_t> hits_ = 0;
+  std::atomic<size_t> misses_ = 0;
+};
+
+}  // namespace analysis
+}  // namespace nudl
+
+#endif  // NUDL_ANALYSIS_PARSE_CACHE_H__
@@ -25,6 +25,7 @@
 #include "nudl/analysis/expression.h"
 #include "nudl/analysis/module.h"
 #include "nudl/analysis/scope.h"
+#include "nudl/grammar/tree_util.h"
 #include "nudl/status/status.h"
 
 ABSL_FLAG(bool, analyze_log_bindings, false,
@@ -33,6 +34,20 @@ ABSL_FLAG(bool, analyze_log_bindings, false,
 namespace nudl {
 namespace analysis {
 
+namespace {
+// The code of the expression, as kept in the proto, or extracted from
+// the source of the scope module.
+absl::string_view ExpressionCode(const pb::Expression& expression,
+                                 const Scope* scope) {
+  if (expression.has_code() || !expression.has_code_interval()) {
+    return expression.code();
+  }
+  return grammar::TreeUtil::CodeSnippet(scope->source_code(),
+                                        expression.code_interval().begin(),
+                                        expression.code_interval().end());
+}
+}  // namespace
+
 PragmaHandler::PragmaHandler(Module* module) : module_(module) {}
 
 Module* PragmaHandler::module() const { return module_; }
@@ -82,15 +97,16 @@ absl::StatusOr<std::unique_ptr<Expression>> PragmaHandler::HandlePragma(
     LOG(INFO) << "Names for module: " << scope->full_name() << "\n"
               << scope->ToProtoObject().DebugString();
   } else if (expression.name() == kPragmaLogExpression) {
-    LOG(INFO) << "Pragma expression for: `" << expression.value().code()
-              << "`:\n"
+    LOG(INFO) << "Pragma expression for: `"
+              << ExpressionCode(expression.value(), scope) << "`:\n"
               << child.value()->DebugString();
   } else if (expression.name() == kPragmaLogProto) {
-    LOG(INFO) << "Pragma expression proto for: `" << expression.value().code()
-              << "`:\n"
+    LOG(INFO) << "Pragma expression proto for: `"
+              << ExpressionCode(expression.value(), scope) << "`:\n"
               << child.value()->ToProto().DebugString();
   } else if (expression.name() == kPragmaLogType) {
-    LOG(INFO) << "Pragma type for: `" << expression.value().code() << "`:\n"
+    LOG(INFO) << "Pragma type for: `"
+              << ExpressionCode(expression.value(), scope) << "`:\n"
               << type_spec->full_name();
   } else {
     return status::InvalidArgumentErrorBuilder()
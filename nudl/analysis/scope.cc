@@ -16,6 +16,7 @@
 
 #include "nudl/analysis/scope.h"
 
+#include <algorithm>
 #include <typeindex>
 #include <utility>
 
@@ -104,6 +105,20 @@ Scope* Scope::module_scope() const { return module_scope_; }
 
 bool Scope::is_module() const { return module_scope_ == this; }
 
+absl::string_view Scope::source_code() const {
+  if (module_scope_ == this) {
+    return {};
+  }
+  return module_scope_->source_code();
+}
+
+AnalysisArena* Scope::arena() const {
+  if (module_scope_ == this) {
+    return nullptr;
+  }
+  return module_scope_->arena();
+}
+
 Scope* Scope::built_in_scope() const { return built_in_scope_; }
 
 GlobalTypeStore* Scope::type_store() const { return type_store_; }
@@ -166,6 +181,30 @@ absl::Status Scope::AddSubScope(std::unique_ptr<Scope> scope) {
   return absl::OkStatus();
 }
 
+std::unique_ptr<Scope> Scope::ReleaseSubScope(const Scope* scope) {
+  auto it = std::find_if(defined_names_.begin(), defined_names_.end(),
+                         [scope](const std::unique_ptr<NamedObject>& object) {
+                           return object.get() == scope;
+                         });
+  if (it == defined_names_.end()) {
+    return nullptr;
+  }
+  std::unique_ptr<Scope> result(static_cast<Scope*>(it->release()));
+  defined_names_.erase(it);
+  return result;
+}
+
+void Scope::DropFailedBindings(
+    const absl::flat_hash_set<const AnalysisArena*>& arenas) {
+  failed_bindings_.erase(
+      std::remove_if(
+          failed_bindings_.begin(), failed_bindings_.end(),
+          [&arenas](const std::unique_ptr<FunctionBinding>& binding) {
+            return arenas.contains(AnalysisArena::Of(binding.get()));
+          }),
+      failed_bindings_.end());
+}
+
 absl::Status Scope::AddOwnedChildStore(absl::string_view local_name,
                                        std::unique_ptr<NameStore> store) {
   if (IsScopeKind(*store)) {
@@ -207,114 +246,135 @@ absl::StatusOr<Scope*> Scope::AddNewLocalScope(absl::string_view local_name) {
 
 absl::StatusOr<NamedObject*> Scope::FindName(const ScopeName& lookup_scope,
                                              const ScopedName& scoped_name) {
+  if (NamedObject* object = LookupName(lookup_scope, scoped_name)) {
+    return object;
+  }
+  // Not found - redo the lookup, collecting the reasons for the error.
   std::vector<absl::Status> find_status;
+  if (NamedObject* object =
+          LookupNameInternal(lookup_scope, scoped_name, &find_status)) {
+    return object;
+  }
+  return status::JoinStatus(find_status);
+}
+
+NamedObject* Scope::LookupName(const ScopeName& lookup_scope,
+                               const ScopedName& scoped_name) {
+  return LookupNameInternal(lookup_scope, scoped_name, nullptr);
+}
+
+NamedObject* Scope::LookupNameInternal(const ScopeName& lookup_scope,
+                                       const ScopedName& scoped_name,
+                                       std::vector<absl::Status>* find_status) {
   absl::optional<Function*> local_function;
-  std::vector<NamedObject*> result;
-  if (lookup_scope.name() == name()) {
+  if (lookup_scope == scope_name()) {
     local_function = FindFunctionAncestor();
     if (scoped_name.scope_name().empty()) {
       if (HasName(scoped_name.name(), false)) {
-        return GetName(scoped_name.name(), false);
-      } else {
-        find_status.emplace_back(status::StatusWriter(absl::NotFoundError(""))
-                                 << "Cannot find name: `" << scoped_name.name()
-                                 << "` in local " << name());
+        return GetName(scoped_name.name(), false).value_or(nullptr);
+      } else if (find_status) {
+        find_status->emplace_back(status::StatusWriter(absl::NotFoundError(""))
+                                  << "Cannot find name: `" << scoped_name.name()
+                                  << "` in local " << name());
       }
     } else {
       // Finally search it here:
-      auto scope_result = FindChildStore(scoped_name.scope_name());
-      if (scope_result.ok()) {
+      NameStore* store = LookupChildStore(scoped_name.scope_name());
+      if (store) {
         const bool is_unaccessible_function =
-            (Function::IsFunctionKind(*scope_result.value()) &&
-             (!local_function.has_value() ||
-              local_function.value() != scope_result.value()));
-        if (scope_result.value()->HasName(scoped_name.name(), false)) {
-          if (!is_unaccessible_function || scope_result.value() == this) {
-            return scope_result.value()->GetName(scoped_name.name(), false);
-          } else {
-            find_status.emplace_back(
+            (Function::IsFunctionKind(*store) &&
+             (!local_function.has_value() || local_function.value() != store));
+        if (store->HasName(scoped_name.name(), false)) {
+          if (!is_unaccessible_function || store == this) {
+            return store->GetName(scoped_name.name(), false).value_or(nullptr);
+          } else if (find_status) {
+            find_status->emplace_back(
                 status::StatusWriter(absl::NotFoundError(""))
                 << "Found name: " << scoped_name.name()
-                << " in function: " << scope_result.value()->name()
+                << " in function: " << store->name()
                 << " cannot be accessed from scope: " << lookup_scope.name());
           }
         }
-        if (!is_unaccessible_function) {
+        if (!is_unaccessible_function && find_status) {
           // TODO(catalin): Here find closest names, 'Did you mean ...'
-          find_status.emplace_back(
+          find_status->emplace_back(
               status::StatusWriter(absl::NotFoundError(""))
               << "Cannot find name: `" << scoped_name.name()
-              << "` in child name store " << scope_result.value()->name()
+              << "` in child name store " << store->name()
               << "; Available names: "
-              << absl::StrJoin(scope_result.value()->DefinedNames(), ", "));
+              << absl::StrJoin(store->DefinedNames(), ", "));
         }
-      } else {
-        find_status.emplace_back(status::StatusWriter(absl::NotFoundError(""))
-                                 << "Cannot find name store: `"
-                                 << scoped_name.scope_name().name()
-                                 << "` in local " << name());
+      } else if (find_status) {
+        find_status->emplace_back(status::StatusWriter(absl::NotFoundError(""))
+                                  << "Cannot find name store: `"
+                                  << scoped_name.scope_name().name()
+                                  << "` in local " << name());
       }
     }
   }
   for (size_t i = lookup_scope.size() + 1; i > 0; --i) {
     const ScopeName prefix_scope(lookup_scope.PrefixScopeName(i - 1));
-    if (!prefix_scope.function_names().empty() &&
-        (!scoped_name.scope_name().module_name().empty())) {
+    if (prefix_scope.num_function_names() > 0 &&
+        (scoped_name.scope_name().num_module_names() > 0)) {
       // May actually bail out directly on the !function_names().empty()
       continue;
     }
     const ScopeName crt_name(prefix_scope.Subscope(scoped_name.scope_name()));
-    auto result = top_scope()->FindChildStore(crt_name);
-    if (result.ok()) {
-      const bool is_unaccessible_function =
-          (Function::IsFunctionKind(*result.value()) &&
-           (!local_function.has_value() ||
-            local_function.value() != result.value()));
-      if (result.value()->HasName(scoped_name.name(), false)) {
-        if (!is_unaccessible_function || result.value() == this) {
-          return result.value()->GetName(scoped_name.name(), false);
-        } else {
-          find_status.emplace_back(status::StatusWriter(absl::NotFoundError(""))
-                                   << "Found name: " << scoped_name.name()
-                                   << " in function: " << result.value()->name()
-                                   << " cannot be accessed from scope: "
-                                   << lookup_scope.name());
-        }
-      } else if (!result.value()->name().empty() &&
-                 (!is_unaccessible_function || result.value() == this)) {
-        // TODO(catalin): Here find closest names, 'Did you mean ...'
-        find_status.emplace_back(
-            status::StatusWriter(absl::NotFoundError(""))
-            << "Cannot find name: `" << scoped_name.name() << "` in name store "
-            << result.value()->name() << " from: " << crt_name.name()
-            << " available names: "
-            << absl::StrJoin(result.value()->DefinedNames(), ", "));
+    NameStore* store = top_scope()->LookupChildStore(crt_name);
+    if (!store) {
+      continue;
+    }
+    const bool is_unaccessible_function =
+        (Function::IsFunctionKind(*store) &&
+         (!local_function.has_value() || local_function.value() != store));
+    if (store->HasName(scoped_name.name(), false)) {
+      if (!is_unaccessible_function || store == this) {
+        return store->GetName(scoped_name.name(), false).value_or(nullptr);
+      } else if (find_status) {
+        find_status->emplace_back(status::StatusWriter(absl::NotFoundError(""))
+                                  << "Found name: " << scoped_name.name()
+                                  << " in function: " << store->name()
+                                  << " cannot be accessed from scope: "
+                                  << lookup_scope.name());
       }
+    } else if (!store->name().empty() &&
+               (!is_unaccessible_function || store == this) && find_status) {
+      // TODO(catalin): Here find closest names, 'Did you mean ...'
+      find_status->emplace_back(
+          status::StatusWriter(absl::NotFoundError(""))
+          << "Cannot find name: `" << scoped_name.name() << "` in name store "
+          << store->name() << " from: " << crt_name.name()
+          << " available names: "
+          << absl::StrJoin(store->DefinedNames(), ", "));
     }
   }
   if (built_in_scope() && built_in_scope() != this) {
-    auto result = built_in_scope()->FindName(ScopeName(), scoped_name);
-    if (result.ok()) {
-      return result;
+    // Errors in the built-in scope are not reported.
+    if (NamedObject* object =
+            built_in_scope()->LookupNameInternal(ScopeName(), scoped_name,
+                                                 nullptr)) {
+      return object;
     }
   }
-  if (find_status.empty()) {
-    find_status.emplace_back(status::StatusWriter(absl::NotFoundError(""))
-                             << "Cannot find name: `" << scoped_name.full_name()
-                             << "` looked up in scope: `" << lookup_scope.name()
-                             << "`");
-  }
-  if (scoped_name.scope_name().function_names().empty()) {
-    auto type_result =
-        type_store_->FindType(lookup_scope, scoped_name.ToTypeSpec());
-    if (type_result.ok()) {
-      return {const_cast<TypeSpec*>(type_result.value())};
+  if (find_status && find_status->empty()) {
+    find_status->emplace_back(status::StatusWriter(absl::NotFoundError(""))
+                              << "Cannot find name: `"
+                              << scoped_name.full_name()
+                              << "` looked up in scope: `"
+                              << lookup_scope.name() << "`");
+  }
+  if (scoped_name.scope_name().num_function_names() == 0) {
+    if (const TypeSpec* type_spec =
+            type_store_->LookupType(lookup_scope, scoped_name)) {
+      return const_cast<TypeSpec*>(type_spec);
+    }
+    if (find_status) {
+      find_status->emplace_back(status::StatusWriter(absl::NotFoundError(""))
+                                << "Cannot find type name: `"
+                                << scoped_name.full_name() << "` either");
     }
-    find_status.emplace_back(status::StatusWriter(absl::NotFoundError(""))
-                             << "Cannot find type name: `"
-                             << scoped_name.full_name() << "` either");
   }
-  return status::JoinStatus(find_status);
+  return nullptr;
 }
 
 absl::StatusOr<const TypeSpec*> Scope::FindType(const pb::TypeSpec& type_spec) {
@@ -323,9 +383,7 @@ absl::StatusOr<const TypeSpec*> Scope::FindType(const pb::TypeSpec& type_spec) {
 
 absl::StatusOr<const TypeSpec*> Scope::FindTypeByName(
     absl::string_view type_name) {
-  ASSIGN_OR_RETURN(auto type_spec, grammar::ParseTypeSpec(type_name),
-                   _ << "For type_name: `" << type_name << "`");
-  return FindType(*type_spec);
+  return type_store_->FindTypeFromString(scope_name(), type_name);
 }
 
 const TypeSpec* Scope::FindTypeAny() {
@@ -409,13 +467,10 @@ absl::optional<Function*> Scope::FindFunctionAncestor() {
 }
 
 namespace {
-absl::StatusOr<std::unique_ptr<FunctionBinding>> FindFunctionInStore(
-    NameStore* store, const ScopeName& lookup_scope, const ScopedName& name,
+absl::StatusOr<std::unique_ptr<FunctionBinding>> BindFoundFunction(
+    NameStore* store, const ScopedName& name, NamedObject* object,
     const std::vector<FunctionCallArgument>& arguments) {
   std::unique_ptr<FunctionBinding> binding;
-  ASSIGN_OR_RETURN(
-      auto object, store->FindName(lookup_scope, name),
-      _ << "Finding function " << name.name() << " in " << store->full_name());
   if (Function::IsFunctionKind(*object)) {
     ASSIGN_OR_RETURN(binding,
                      static_cast<Function*>(object)->BindArguments(arguments),
@@ -433,40 +488,61 @@ absl::StatusOr<std::unique_ptr<FunctionBinding>> FindFunctionInStore(
          << "The found object: " << object->full_name() << " in "
          << store->full_name() << " is not a function";
 }
+
+absl::StatusOr<std::unique_ptr<FunctionBinding>> FindFunctionInStore(
+    NameStore* store, const ScopeName& lookup_scope, const ScopedName& name,
+    const std::vector<FunctionCallArgument>& arguments) {
+  ASSIGN_OR_RETURN(
+      auto object, store->FindName(lookup_scope, name),
+      _ << "Finding function " << name.name() << " in " << store->full_name());
+  return BindFoundFunction(store, name, object, arguments);
+}
 }  // namespace
 
 absl::StatusOr<std::unique_ptr<FunctionBinding>> Scope::FindFunctionByName(
     const ScopedName& name, const TypeSpec* type_spec,
     const std::vector<FunctionCallArgument>& arguments) {
-  std::vector<absl::Status> find_status;
-  std::vector<absl::Status> bind_status;
+  std::vector<NameStore*> stores;
   if (type_spec && type_spec->type_member_store()) {
-    auto type_stores = type_spec->type_member_store()->FindBindingOrder();
-    for (auto type_store : type_stores) {
-      auto find_result =
-          FindFunctionInStore(type_store, scope_name(), name, arguments);
-      if (find_result.ok()) {
-        return find_result;
-      }
-      if (absl::IsNotFound(find_result.status())) {
-        find_status.emplace_back(std::move(find_result).status());
-      } else {
-        bind_status.emplace_back(std::move(find_result).status());
-      }
-    }
-  }
-  auto find_result = FindFunctionInStore(this, scope_name(), name, arguments);
-  if (find_result.ok()) {
-    return find_result;
+    stores = type_spec->type_member_store()->FindBindingOrder();
   }
-  if (absl::IsNotFound(find_result.status())) {
-    find_status.emplace_back(std::move(find_result).status());
-  } else {
-    bind_status.emplace_back(std::move(find_result).status());
+  stores.emplace_back(this);
+  // The binding errors for the stores in which the name was found.
+  std::vector<absl::optional<absl::Status>> store_status(stores.size());
+  bool has_bind_error = false;
+  for (size_t i = 0; i < stores.size(); ++i) {
+    NamedObject* object = stores[i]->LookupName(scope_name(), name);
+    if (!object) {
+      continue;
+    }
+    auto find_result = BindFoundFunction(stores[i], name, object, arguments);
+    if (find_result.ok()) {
+      return find_result;
+    }
+    has_bind_error = has_bind_error || !absl::IsNotFound(find_result.status());
+    store_status[i] = std::move(find_result).status();
   }
-  if (!bind_status.empty()) {
+  if (has_bind_error) {
+    std::vector<absl::Status> bind_status;
+    for (auto& crt_status : store_status) {
+      if (crt_status.has_value() && !absl::IsNotFound(crt_status.value())) {
+        bind_status.emplace_back(std::move(crt_status).value());
+      }
+    }
     return status::JoinStatus(bind_status);
   }
+  // Nothing bound - only now build the errors for the stores that
+  // missed the name.
+  std::vector<absl::Status> find_status;
+  for (size_t i = 0; i < stores.size(); ++i) {
+    if (store_status[i].has_value()) {
+      find_status.emplace_back(std::move(store_status[i]).value());
+    } else {
+      find_status.emplace_back(
+          FindFunctionInStore(stores[i], scope_name(), name, arguments)
+              .status());
+    }
+  }
   return status::JoinStatus(find_status);
 }
 
@@ -501,17 +577,17 @@ absl::Status CheckNoRedefinitions(const VarBase* var_base,
 absl::StatusOr<std::tuple<VarBase*, bool>> Scope::ProcessVarFind(
     const ScopedName& name, const pb::Assignment& element,
     Expression* assign_expression, const CodeContext& context) {
-  auto find_result = FindName(scope_name(), name);
-  if (find_result.ok()) {
-    NamedObject* scoped_object = find_result.value();
+  // Most assignments define new names, so probe without building errors.
+  if (NamedObject* scoped_object = LookupName(scope_name(), name)) {
     ASSIGN_OR_RETURN(auto var_base, ValidateAssignment(name, scoped_object),
                      _ << context.ToErrorInfo("In assignment expression"));
     RETURN_IF_ERROR(CheckNoRedefinitions(var_base, element, context));
     return std::make_tuple(var_base, false);
   }
   if (!name.scope_name().empty()) {
-    return {status::StatusWriter(find_result.status()) << context.ToErrorInfo(
-                "Cannot find name in assignment expression")};
+    return {status::StatusWriter(FindName(scope_name(), name).status())
+            << context.ToErrorInfo(
+                   "Cannot find name in assignment expression")};
   }
   // We try to add the variable:
   const TypeSpec* type_spec = nullptr;
@@ -553,7 +629,29 @@ absl::StatusOr<VarBase*> Scope::ValidateAssignment(const ScopedName& name,
 
 absl::StatusOr<std::unique_ptr<Expression>> Scope::BuildExpression(
     const pb::Expression& expression) {
-  CodeContext context = CodeContext::FromProto(expression);
+  if (is_temporary_build_) {
+    return BuildExpressionNode(expression);
+  }
+  auto shared_expression = FindSharedExpression(expression);
+  if (shared_expression) {
+    return {std::move(shared_expression)};
+  }
+  ASSIGN_OR_RETURN(auto built_expression, BuildExpressionNode(expression));
+  RecordBuiltExpression(expression, built_expression.get());
+  return {std::move(built_expression)};
+}
+
+std::unique_ptr<Expression> Scope::FindSharedExpression(
+    const pb::Expression& expression) {
+  return nullptr;
+}
+
+void Scope::RecordBuiltExpression(const pb::Expression& expression,
+                                  Expression* built_expression) {}
+
+absl::StatusOr<std::unique_ptr<Expression>> Scope::BuildExpressionNode(
+    const pb::Expression& expression) {
+  CodeContext context = CodeContext::FromProto(expression, source_code());
   std::string expression_type;
   if (expression.has_literal()) {
     return BuildLiteral(expression.literal(), context);
@@ -975,7 +1073,7 @@ absl::StatusOr<std::unique_ptr<Expression>> Scope::BuildExpressionBlock(
   for (int i = 0; i < expression_block.expression_size(); ++i) {
     const auto& expression = expression_block.expression(i);
     if (contains_return) {
-      CodeContext context = CodeContext::FromProto(expression);
+      CodeContext context = CodeContext::FromProto(expression, source_code());
       MergeErrorStatus(status::InvalidArgumentErrorBuilder()
                            << "Meaningless expression after function return"
                            << context.ToErrorInfo("In expression block"),
@@ -1004,7 +1102,7 @@ absl::StatusOr<std::unique_ptr<Expression>> Scope::BuildExpressionBlock(
   CHECK_LE(max_size, expressions.size());
   for (size_t i = 0; i < max_size; ++i) {
     CodeContext context =
-        CodeContext::FromProto(expression_block.expression(i));
+        CodeContext::FromProto(expression_block.expression(i), source_code());
     ASSIGN_OR_RETURN(auto type_spec, expressions[i]->type_spec(),
                      _ << "Determining result type of expression");
     if (expressions[i]->expr_kind() == pb::ExpressionKind::EXPR_FUNCTION_CALL &&
@@ -1025,7 +1123,7 @@ absl::StatusOr<std::unique_ptr<Expression>> Scope::BuildExpressionBlock(
     RET_CHECK(parent_function.has_value())
         << "Expecting to be inside a function " << kBugNotice;
     CodeContext context = CodeContext::FromProto(
-        expression_block.expression(last_expression_index));
+        expression_block.expression(last_expression_index), source_code());
     RETURN_IF_ERROR(parent_function.value()->RegisterResultExpression(
         pb::FunctionResultKind::RESULT_NONE, last_expression, contains_return))
         << context.ToErrorInfo("Registering default function return");
@@ -1473,6 +1571,12 @@ absl::StatusOr<Expression*> Scope::BuildDefaultValueExpression(
   ASSIGN_OR_RETURN(
       auto expression_pb, type_spec->DefaultValueExpression(scope_name()),
       _ << "Preparing default value for type: " << type_spec->full_name());
+  // The expression_pb is local, so its address cannot identify it.
+  const bool was_temporary_build = is_temporary_build_;
+  is_temporary_build_ = true;
+  absl::Cleanup reset_temporary_build = [this, was_temporary_build]() {
+    is_temporary_build_ = was_temporary_build;
+  };
   ASSIGN_OR_RETURN(auto expression, BuildExpression(expression_pb),
                    _ << "Building default value expression for: "
                      << expression_pb.ShortDebugString()
@@ -22,9 +22,11 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "nudl/analysis/arena.h"
 #include "nudl/analysis/errors.h"
 #include "nudl/analysis/named_object.h"
 #include "nudl/analysis/names.h"
@@ -81,6 +83,11 @@ class Scope : public BaseNameStore {
   Scope* module_scope() const;
   // If this is a module type of scope
   bool is_module() const;
+  // The source code of the module containing this scope, if available.
+  virtual absl::string_view source_code() const;
+  // The arena in which the objects of the module containing this scope
+  // are allocated, null if none.
+  virtual AnalysisArena* arena() const;
   // Returns the handler of pragmas for this Scope
   PragmaHandler* pragma_handler() const;
 
@@ -110,10 +117,21 @@ class Scope : public BaseNameStore {
   // Finds a named expression that is looked up this scope.
   absl::StatusOr<NamedObject*> FindName(const ScopeName& lookup_scope,
                                         const ScopedName& scoped_name) override;
+  // Same as above, without building an error when the name is not found.
+  NamedObject* LookupName(const ScopeName& lookup_scope,
+                          const ScopedName& scoped_name) override;
 
   // Adds a child scope to this one. We expect our scope name to
   // be a prefix in the provided scope_name.
   absl::Status AddSubScope(std::unique_ptr<Scope> scope);
+  // Releases the ownership of a child scope added with AddSubScope,
+  // after its name was removed with RemoveChildStore. Returns null if
+  // the scope is not owned by this one.
+  std::unique_ptr<Scope> ReleaseSubScope(const Scope* scope);
+  // Drops the failed bindings kept by this scope, that were allocated
+  // in the provided arenas, e.g. while analyzing released modules.
+  void DropFailedBindings(
+      const absl::flat_hash_set<const AnalysisArena*>& arenas);
   // Adds a general child - specializes for scopes.
   absl::Status AddOwnedChildStore(absl::string_view local_name,
                                   std::unique_ptr<NameStore> store) override;
@@ -180,6 +198,12 @@ class Scope : public BaseNameStore {
   static bool IsScopeKind(const NamedObject& object);
 
  protected:
+  // Implements the name lookup. When find_status is provided, it collects
+  // the reasons for which the probed scopes did not contain the name.
+  NamedObject* LookupNameInternal(const ScopeName& lookup_scope,
+                                  const ScopedName& scoped_name,
+                                  std::vector<absl::Status>* find_status);
+
   // Validates if the provided scope name/object can be assigned in this scope.
   virtual absl::StatusOr<VarBase*> ValidateAssignment(
       const ScopedName& name, NamedObject* object) const;
@@ -193,6 +217,19 @@ class Scope : public BaseNameStore {
   absl::Status ProcessAssignment(const pb::Assignment& element,
                                  const CodeContext& context);
 
+  // Hooks around BuildExpression: an already analyzed expression returned
+  // by FindSharedExpression is used instead of building the provided one.
+  // RecordBuiltExpression is called for each expression built from a proto.
+  // The hooks are skipped for protos that do not outlive the build (e.g.
+  // default values), as the protos are identified by address.
+  virtual std::unique_ptr<Expression> FindSharedExpression(
+      const pb::Expression& expression);
+  virtual void RecordBuiltExpression(const pb::Expression& expression,
+                                     Expression* built_expression);
+  // Builds the expression, dispatching on its kind.
+  absl::StatusOr<std::unique_ptr<Expression>> BuildExpressionNode(
+      const pb::Expression& expression);
+
   absl::StatusOr<std::unique_ptr<Expression>> BuildAssignment(
       const pb::Assignment& element, const CodeContext& context);
   absl::StatusOr<std::unique_ptr<Expression>> BuildLiteral(
@@ -250,6 +287,8 @@ class Scope : public BaseNameStore {
   GlobalTypeStore* const type_store_;
 
   size_t next_name_id_ = 0;
+  // Set while building from a temporary proto, which cannot be shared.
+  bool is_temporary_build_ = false;
 
   std::vector<std::unique_ptr<NamedObject>> defined_names_;
   std::vector<std::unique_ptr<Expression>> expressions_;
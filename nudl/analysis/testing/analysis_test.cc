@@ -78,6 +78,16 @@ absl::StatusOr<Module*> AnalysisTest::ImportCode(
   return module;
 }
 
+absl::StatusOr<Function*> AnalysisTest::FindFunction(
+    Module* module, absl::string_view name) const {
+  ASSIGN_OR_RETURN(auto group, module->GetName(name, true));
+  RET_CHECK(FunctionGroup::IsFunctionGroup(*group))
+      << "Not a function: " << name;
+  ASSIGN_OR_RETURN(auto fun, static_cast<FunctionGroup*>(group)->GetName(
+                                 absl::StrCat(name, "__i0"), true));
+  return static_cast<Function*>(fun);
+}
+
 void AnalysisTest::CheckCode(absl::string_view test_name,
                              absl::string_view module_name,
                              absl::string_view code) {
@@ -85,6 +85,9 @@ class AnalysisTest : public ::testing::Test {
   Environment* env() const;
   absl::StatusOr<Module*> ImportCode(absl::string_view module_name,
                                      absl::string_view module_content) const;
+  // Finds the first function defined under `name` in the provided module.
+  absl::StatusOr<Function*> FindFunction(Module* module,
+                                         absl::string_view name) const;
 
   // Normal mode of operation: used to check an existing
   // prepared proto file test agains code.
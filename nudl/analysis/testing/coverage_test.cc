@@ -125,6 +125,15 @@ param a: Int = 20;
                      ScopedName::Parse("quxix").value())
           .status(),
       NotFound, testing::HasSubstr("looked up in scope"));
+  EXPECT_EQ(module.value()->LookupName(ScopeName::Parse("foox.bar").value(),
+                                       ScopedName::Parse("quxix").value()),
+            nullptr);
+  EXPECT_EQ(module.value()->LookupName(module.value()->scope_name(),
+                                       ScopedName::Parse("x").value()),
+            module.value()->FindName(module.value()->scope_name(),
+                                     ScopedName::Parse("x").value())
+                .value());
+  EXPECT_EQ(ws.LookupChildStore(ScopeName()), &ws);
 }
 
 TEST_F(AnalysisTest, ObjectNames) {
@@ -16,7 +16,9 @@
 
 #include "absl/flags/declare.h"
 #include "absl/flags/flag.h"
+#include "gmock/gmock.h"
 #include "nudl/analysis/testing/analysis_test.h"
+#include "nudl/conversion/python_converter.h"
 #include "nudl/status/testing.h"
 #include "nudl/testing/protobuf_matchers.h"
 
@@ -51,6 +53,126 @@ TEST_F(AnalysisTest, ExpressionLiteral) {
   EXPECT_EQ(literal->named_object().value(), &var);
 }
 
+TEST_F(AnalysisTest, ExpressionArena) {
+  Scope base_scope;
+  pb::Literal exp;
+  exp.set_int_value(3);
+  const size_t num_arenas = AnalysisArena::stats().num_arenas;
+  auto arena = AnalysisArena::Build(1024);
+  std::unique_ptr<Literal> literal;
+  {
+    AnalysisArena::Activation activation(arena.get());
+    EXPECT_EQ(AnalysisArena::Current(), arena.get());
+    ASSERT_OK_AND_ASSIGN(literal, Literal::Build(&base_scope, exp));
+    EXPECT_EQ(AnalysisArena::Of(literal.get()), arena.get());
+    EXPECT_GT(arena->allocated_bytes(), sizeof(Literal));
+    EXPECT_EQ(arena->num_blocks(), 1);
+    {
+      AnalysisArena::Activation no_arena(nullptr);
+      ASSERT_OK_AND_ASSIGN(auto heap_literal,
+                           Literal::Build(&base_scope, exp));
+      EXPECT_EQ(AnalysisArena::Of(heap_literal.get()), nullptr);
+      EXPECT_EQ(arena->num_blocks(), 1);
+    }
+    EXPECT_EQ(AnalysisArena::Current(), arena.get());
+  }
+  EXPECT_EQ(AnalysisArena::Current(), nullptr);
+  // The arena is freed once released by its owner, and all its objects
+  // are destroyed:
+  arena.reset();
+  EXPECT_EQ(AnalysisArena::stats().num_arenas, num_arenas + 1);
+  literal.reset();
+  EXPECT_EQ(AnalysisArena::stats().num_arenas, num_arenas);
+
+  // Each imported module allocates its objects in its own arena, which
+  // is freed when the module is released:
+  constexpr absl::string_view kCode = R"(
+def f(x: Int) => x + 1
+def g(y: {T}) => [y, y]
+def h() => len(g("a")) + len(g(2.5))
+def k() => f(2)
+)";
+  ASSERT_OK_AND_ASSIGN(auto module, ImportCode("arena_module", kCode));
+  ASSERT_NE(module->arena(), nullptr);
+  EXPECT_NE(module->arena(), env()->builtin_module()->arena());
+  EXPECT_GT(module->arena()->allocated_bytes(), 0);
+  EXPECT_EQ(AnalysisArena::stats().num_arenas, num_arenas + 1);
+  env()->module_store()->InvalidateModule("arena_module");
+  EXPECT_EQ(AnalysisArena::stats().num_arenas, num_arenas);
+  // Modules imported again use their own arena as well:
+  ASSERT_OK_AND_ASSIGN(module, ImportCode("arena_module", kCode));
+  ASSERT_NE(module->arena(), nullptr);
+  EXPECT_EQ(AnalysisArena::stats().num_arenas, num_arenas + 1);
+}
+
+TEST_F(AnalysisTest, SharedBindingExpressions) {
+  ASSERT_OK_AND_ASSIGN(auto module, ImportCode("shared_module", R"(
+def shared_size(x: {T}) : UInt => len([1, 2, 3])
+def use_shared() => shared_size(1) + shared_size("x")
+)"));
+  ASSERT_OK_AND_ASSIGN(auto fun, FindFunction(module, "shared_size"));
+  ASSERT_GE(fun->bindings().size(), 2);
+  // The first instance analyzes the body, the next ones copy the
+  // `len([1, 2, 3])` call, as it does not depend on the type of x.
+  EXPECT_EQ(fun->bindings().front()->num_shared_expressions(), 0);
+  size_t num_shared = 0;
+  for (const auto& binding : fun->bindings()) {
+    num_shared += binding->num_shared_expressions();
+  }
+  EXPECT_GE(num_shared, 1);
+}
+
+TEST_F(AnalysisTest, SharedExpressionsOutliveTheirInstance) {
+  ASSERT_OK(ImportCode("shared_drop_lib", R"(
+def shared_size(x: {T}) : UInt => len([1, 2, 3])
+)")
+                .status());
+  // The first bind instance, which builds the shared expressions, is on
+  // a type of a module that is dropped below.
+  ASSERT_OK(ImportCode("shared_drop_type", R"(
+import shared_drop_lib
+schema DropRecord = {
+  name: String;
+};
+def first_use(r: DropRecord) => shared_drop_lib.shared_size(r)
+)")
+                .status());
+  ASSERT_OK(ImportCode("shared_drop_user", R"(
+import shared_drop_lib
+def second_use() => shared_drop_lib.shared_size("x")
+)")
+                .status());
+  Module* lib = env()->module_store()->GetModule("shared_drop_lib").value();
+  ASSERT_OK_AND_ASSIGN(auto fun, FindFunction(lib, "shared_size"));
+  ASSERT_EQ(fun->bindings().size(), 2);
+  Function* kept = fun->bindings().back().get();
+  EXPECT_GE(kept->num_shared_expressions(), 1);
+
+  env()->module_store()->InvalidateModule("shared_drop_type");
+  ASSERT_EQ(fun->bindings().size(), 1);
+  ASSERT_EQ(fun->bindings().front().get(), kept);
+  // The copies of the shared expressions belong to the kept instance.
+  class ScopeChecker : public ExpressionVisitor {
+   public:
+    explicit ScopeChecker(Scope* scope) : scope_(scope) {}
+    bool Visit(Expression* expression) override {
+      EXPECT_EQ(expression->scope(), scope_) << expression->DebugString();
+      return true;
+    }
+
+   private:
+    Scope* const scope_;
+  };
+  ScopeChecker checker(kept);
+  for (const auto& expression : kept->expressions()) {
+    expression->VisitExpressions(&checker);
+  }
+  ASSERT_OK_AND_ASSIGN(auto lib_code,
+                       conversion::PythonConverter().ConvertModule(lib));
+  ASSERT_FALSE(lib_code.files.empty());
+  EXPECT_THAT(lib_code.files.front().content, testing::HasSubstr("len"));
+}
+
 TEST_F(AnalysisTest, ExpressionNamedObject) {
   // Goes over named_object method testing in most expressions.
   pb::Literal exp;
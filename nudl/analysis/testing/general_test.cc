@@ -14,9 +14,16 @@
 // limitations under the License.
 //
 
+#include <fstream>
+#include <iterator>
+
 #include "absl/flags/declare.h"
 #include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
 #include "nudl/analysis/testing/analysis_test.h"
+#include "nudl/conversion/python_converter.h"
+#include "nudl/status/status.h"
 #include "nudl/status/testing.h"
 
 ABSL_DECLARE_FLAG(bool, nudl_accept_abstract_function_objects);
@@ -236,6 +243,38 @@ x = 10;
   CheckError("parse_error", "10x; x = 2$", "Parse errors in code");
 }
 
+TEST_F(AnalysisTest, PreparsedImports) {
+  auto store = env()->module_store();
+  store->set_module_code("preparse_main", R"(
+import preparse_lib
+import submodule.compute
+z = preparse_lib.f(10)
+)");
+  store->set_module_code("preparse_lib", R"(
+import submodule
+def f(x: Int) => submodule.area(x)
+)");
+  store->set_module_code("preparse_cycle", R"(
+import preparse_cycle
+x = 10
+)");
+  store->set_module_code("preparse_error", "10x; x = 2$");
+  store->PreparseModules(
+      {"preparse_main", "preparse_cycle", "preparse_error", "preparse_none"},
+      4);
+  // Nothing is analyzed until imported:
+  EXPECT_FALSE(store->HasModule("preparse_lib"));
+  ASSERT_OK(store->ImportModule("preparse_main").status());
+  EXPECT_TRUE(store->HasModule("preparse_lib"));
+  EXPECT_TRUE(store->HasModule("submodule"));
+  EXPECT_TRUE(store->HasModule("submodule.compute"));
+  EXPECT_RAISES_WITH_MESSAGE_THAT(
+      store->ImportModule("preparse_cycle").status(), FailedPrecondition,
+      testing::HasSubstr("Chain detected in import order"));
+  EXPECT_FALSE(store->ImportModule("preparse_error").ok());
+  EXPECT_RAISES(store->ImportModule("preparse_none").status(), NotFound);
+}
+
 TEST_F(AnalysisTest, Ifs) {
   CheckCode("general_test", "if_simple", R"(
 def f(x: Int) => {
@@ -364,6 +403,24 @@ z = f(10)
 )",
              "Found too many functions matching the "
              "provided call signature");
+  CheckError("overload_arity", R"(
+def f(x: Int) => x + 1
+def f(x: Int, y: Int, z: Int = 0) => x + y + z
+w = f(1, 2, 3, 4)
+)",
+             "unused arguments provided for function call");
+  CheckError("overload_named_arg", R"(
+def f(x: Int) => x + 1
+def f(x: Int, y: Int = 0) => x + y
+w = f(1, z = 2)
+)",
+             "Cannot find any function signature matching arguments");
+  CheckError("overload_first_arg", R"(
+def f(x: Int) => x + 1
+def f(x: String) => len(x)
+def g(y: Bool) => f(y)
+)",
+             "is incompatible with declared type of argument");
   CheckError("name_conflict1", R"(
 def foo(x: Int) => { x - 1 }
 foo : Int = 10
@@ -526,6 +583,80 @@ def f() => {
              "binding for improper function type");
 }
 
+TEST_F(AnalysisTest, OverloadSelection) {
+  // Exercises the signature filters of function groups. Each overload
+  // has a distinct result type, which tells which one a call binds.
+  ASSERT_OK_AND_ASSIGN(Module * module, ImportCode("overload_selection", R"(
+def f(x: Int) : Int => x + 1
+def f(x: String) : String => x
+def f(x: Int, y: Int, z: Int = 2) : Bool => x * y + z > 0
+def f(x: Float64, name: String) : Float64 => x
+def k(x: Float64, y: Int) : Float64 => x
+def k(x: String, y: Int) : String => x
+def call_int(i: Int) => f(i)
+def call_string(s: String) => f(s)
+def call_two(i: Int) => f(i, i)
+def call_named(i: Int) => f(i, y = i, z = 3)
+def call_float(d: Float64, s: String) => f(d, name = s)
+def call_k_float(d: Float64, i: Int) => k(d, i)
+def call_k_string(s: String, i: Int) => k(s, i)
+)"));
+  // The result type of the function that calls the overload.
+  auto result_type = [this, module](absl::string_view name) -> std::string {
+    auto fun = FindFunction(module, name);
+    if (!fun.ok() || !fun.value()->type_spec()->ResultType()) {
+      return "";
+    }
+    return fun.value()->type_spec()->ResultType()->full_name();
+  };
+  // Arity filter: f(x: Int) vs. the three argument overload.
+  EXPECT_EQ(result_type("call_int"), "Int");
+  EXPECT_EQ(result_type("call_two"), "Bool");
+  // Argument name filter.
+  EXPECT_EQ(result_type("call_named"), "Bool");
+  EXPECT_EQ(result_type("call_float"), "Float64");
+  // First argument filter: these overloads take the same number of
+  // arguments, with the same names, and differ only by the first type.
+  EXPECT_EQ(result_type("call_string"), "String");
+  EXPECT_EQ(result_type("call_k_float"), "Float64");
+  EXPECT_EQ(result_type("call_k_string"), "String");
+}
+
+TEST_F(AnalysisTest, SignatureCache) {
+  const auto before = FunctionGroup::signature_cache_stats();
+  ASSERT_OK(ImportCode("signature_cache", R"(
+def f(x: Int) => x + 1
+def f(x: String) => len(x)
+def g(i: Int, s: String) => {
+  a = f(i);
+  b = f(i);
+  c = f(s);
+  d = f(s);
+  a + b
+}
+)")
+                .status());
+  const auto after = FunctionGroup::signature_cache_stats();
+  // The second calls with the same argument types are found in the cache.
+  EXPECT_GE(after.hits, before.hits + 2);
+  EXPECT_GT(after.misses, before.misses);
+}
+
+TEST_F(AnalysisTest, SignatureCacheAmbiguous) {
+  const auto before = FunctionGroup::signature_cache_stats();
+  CheckError("signature_cache_ambiguous", R"(
+def f(x: Int) => { x + 1 }
+def f(x: Int, y: Int = 0) => { x - y }
+z = f(10)
+w = f(11)
+)",
+             "Found too many functions matching the "
+             "provided call signature");
+  const auto after = FunctionGroup::signature_cache_stats();
+  // The second call gets the ambiguity error from the cache.
+  EXPECT_GE(after.hits, before.hits + 1);
+}
+
 TEST_F(AnalysisTest, ReturnValues) {
   CheckCode("general_test", "compatible_nullable_results1", R"(
 def foo(x: Int) => {
@@ -850,6 +981,376 @@ x = agg(0)
              "Cannot coerce Tuple type to: Int");
 }
 
+TEST_F(AnalysisTest, LazyFunctionBodies) {
+  env()->module_store()->set_lazy_function_bodies(true);
+  ASSERT_OK_AND_ASSIGN(auto module, ImportCode("lazy_bodies", R"(
+def used(x: Int) : Int => x * 2
+def unused(x: Int) : Int => x + 1
+def bad(x: Int) : Int => undefined_name + x
+def untyped(x) => x
+y = used(3)
+)"));
+  env()->module_store()->set_lazy_function_bodies(false);
+  ASSERT_OK_AND_ASSIGN(Function * used, FindFunction(module, "used"));
+  EXPECT_FALSE(used->has_deferred_body());
+  EXPECT_FALSE(used->expressions().empty());
+  ASSERT_OK_AND_ASSIGN(Function * unused, FindFunction(module, "unused"));
+  EXPECT_TRUE(unused->has_deferred_body());
+  EXPECT_TRUE(unused->expressions().empty());
+  ASSERT_OK_AND_ASSIGN(Function * bad, FindFunction(module, "bad"));
+  EXPECT_TRUE(bad->has_deferred_body());
+  // Errors in deferred bodies are reported when these are built, e.g.
+  // by the converter, before converting the module.
+  auto build_status = module->BuildDeferredBodies();
+  EXPECT_FALSE(build_status.ok());
+  EXPECT_THAT(build_status.message(), testing::HasSubstr("undefined_name"));
+  EXPECT_FALSE(unused->has_deferred_body());
+  EXPECT_FALSE(unused->expressions().empty());
+  EXPECT_FALSE(bad->has_deferred_body());
+  // The error is kept, and reported on each request for the body.
+  EXPECT_THAT(bad->BuildDeferredBody().message(),
+              testing::HasSubstr("undefined_name"));
+  EXPECT_THAT(module->BuildDeferredBodies().message(),
+              testing::HasSubstr("undefined_name"));
+  ASSERT_OK_AND_ASSIGN(Function * untyped, FindFunction(module, "untyped"));
+  EXPECT_FALSE(untyped->has_deferred_body());
+}
+
+TEST_F(AnalysisTest, LazyFunctionBodyErrorOnCall) {
+  env()->module_store()->set_lazy_function_bodies(true);
+  ASSERT_OK_AND_ASSIGN(auto module, ImportCode("lazy_call_lib", R"(
+def bad(x: Int) : Int => undefined_name + x
+)"));
+  env()->module_store()->set_lazy_function_bodies(false);
+  ASSERT_OK_AND_ASSIGN(Function * bad, FindFunction(module, "bad"));
+  EXPECT_TRUE(bad->has_deferred_body());
+  // The body is built, and fails, on the first call.
+  EXPECT_FALSE(ImportCode("lazy_call_user", R"(
+import lazy_call_lib
+y = lazy_call_lib.bad(1)
+)")
+                   .ok());
+  EXPECT_FALSE(bad->has_deferred_body());
+  EXPECT_TRUE(bad->expressions().empty());
+  // So the module that defines it cannot be converted without its body.
+  EXPECT_THAT(bad->BuildDeferredBody().message(),
+              testing::HasSubstr("undefined_name"));
+  EXPECT_THAT(module->BuildDeferredBodies().message(),
+              testing::HasSubstr("undefined_name"));
+}
+
+TEST_F(AnalysisTest, IncrementalReimport) {
+  auto store = env()->module_store();
+  store->set_module_code("incr_base", "def base_value() : Int => 1\n");
+  store->set_module_code("incr_other", "def other_value() : Int => 2\n");
+  store->set_module_code("incr_mid", R"(
+import incr_base
+def mid_value() : Int => incr_base.base_value() + 1
+)");
+  store->set_module_code("incr_top", R"(
+import incr_mid
+import incr_other
+def top_value() : Int => incr_mid.mid_value() + incr_other.other_value()
+)");
+  ASSERT_OK(store->ImportModule("incr_top").status());
+  EXPECT_THAT(store->ModuleImports("incr_top"),
+              testing::UnorderedElementsAre("incr_mid", "incr_other"));
+  EXPECT_THAT(store->TransitiveImporters("incr_base"),
+              testing::UnorderedElementsAre("incr_mid", "incr_top"));
+  ASSERT_TRUE(store->ModuleHash("incr_base").has_value());
+  Module* other = store->GetModule("incr_other").value();
+  ASSERT_OK_AND_ASSIGN(auto unchanged, store->ReimportChangedModules());
+  EXPECT_TRUE(unchanged.empty());
+
+  store->set_module_code("incr_base", "def base_value() : Int => 10\n");
+  ASSERT_OK_AND_ASSIGN(auto reimported, store->ReimportChangedModules());
+  EXPECT_THAT(reimported, testing::ElementsAre("incr_base", "incr_mid",
+                                               "incr_top"));
+  EXPECT_EQ(store->GetModule("incr_other").value(), other);
+  ASSERT_TRUE(store->GetModule("incr_top").has_value());
+  EXPECT_THAT(store->TransitiveImporters("incr_base"),
+              testing::UnorderedElementsAre("incr_mid", "incr_top"));
+
+  // Errors in the changed modules are reported, and these are dropped.
+  store->set_module_code("incr_base", "def base_value() : Int => nope\n");
+  EXPECT_FALSE(store->ReimportChangedModules().ok());
+  EXPECT_FALSE(store->HasModule("incr_top"));
+  EXPECT_TRUE(store->HasModule("incr_other"));
+}
+
+TEST_F(AnalysisTest, ReimportStructBindings) {
+  auto store = env()->module_store();
+  store->set_module_code("rebind_lib", "def get_a(x) => x.a\n");
+  auto main_code = [](absl::string_view field_type) {
+    return absl::StrCat(R"(
+import rebind_lib
+schema S = {
+  a: )",
+                        field_type, R"(;
+}
+def f(s: S) => rebind_lib.get_a(s)
+)");
+  };
+  store->set_module_code("rebind_main", main_code("Int"));
+  ASSERT_OK(store->ImportModule("rebind_main").status());
+  Module* lib = store->GetModule("rebind_lib").value();
+  ASSERT_OK_AND_ASSIGN(Function * get_a, FindFunction(lib, "get_a"));
+  ASSERT_EQ(get_a->bindings().size(), 1);
+  EXPECT_EQ(get_a->bindings().front()->result_type()->name(), "Int");
+
+  // The structure changes, but keeps its name: the binding on the
+  // previous structure is dropped, and the function is bound again.
+  store->set_module_code("rebind_main", main_code("String"));
+  ASSERT_OK_AND_ASSIGN(auto reimported, store->ReimportChangedModules());
+  EXPECT_THAT(reimported, testing::ElementsAre("rebind_main"));
+  EXPECT_EQ(store->GetModule("rebind_lib").value(), lib);
+  ASSERT_EQ(get_a->bindings().size(), 1);
+  EXPECT_EQ(get_a->bindings().front()->result_type()->name(), "String");
+}
+
+TEST_F(AnalysisTest, ReimportMethods) {
+  auto store = env()->module_store();
+  store->set_module_code("remethod_lib",
+                         "def method twice(x: Int) : Int => x * 2\n");
+  store->set_module_code("remethod_main", R"(
+import remethod_lib
+def f(x: Int) : Int => x.twice()
+)");
+  ASSERT_OK(store->ImportModule("remethod_main").status());
+
+  // The method on the built-in type is removed with its module, so it
+  // can be defined again.
+  store->set_module_code("remethod_lib",
+                         "def method twice(x: Int) : Int => x + x\n");
+  ASSERT_OK_AND_ASSIGN(auto reimported, store->ReimportChangedModules());
+  EXPECT_THAT(reimported,
+              testing::ElementsAre("remethod_lib", "remethod_main"));
+  ASSERT_OK_AND_ASSIGN(Function * twice,
+                       FindFunction(store->GetModule("remethod_lib").value(),
+                                    "twice"));
+  ASSERT_EQ(twice->member_groups().size(), 1);
+  EXPECT_THAT(twice->member_groups().front().second->functions(),
+              testing::ElementsAre(twice));
+}
+
+TEST_F(AnalysisTest, FailedImportReleased) {
+  auto store = env()->module_store();
+  store->set_module_code("failed_release_lib", "def get_a(x) => x.a\n");
+  const std::string user_code(R"(
+import failed_release_lib
+schema S = {
+  a: Int;
+}
+def method twice(x: Int) : Int => x * 2
+def f(s: S) => failed_release_lib.get_a(s)
+)");
+  store->set_module_code("failed_release_user",
+                         absl::StrCat(user_code, "z = nope\n"));
+  EXPECT_FALSE(store->ImportModule("failed_release_user").ok());
+  EXPECT_FALSE(store->HasModule("failed_release_user"));
+  EXPECT_FALSE(
+      store->top_module()->GetName("failed_release_user", true).ok());
+  // The binding of the kept function on the failed module type is dropped.
+  Module* lib = store->GetModule("failed_release_lib").value();
+  ASSERT_OK_AND_ASSIGN(Function * get_a, FindFunction(lib, "get_a"));
+  EXPECT_TRUE(get_a->bindings().empty());
+
+  // The method of the failed module is removed from the built-in type,
+  // so it can be defined again.
+  store->set_module_code("failed_release_user", user_code);
+  ASSERT_OK_AND_ASSIGN(Module * user,
+                       store->ImportModule("failed_release_user"));
+  ASSERT_OK_AND_ASSIGN(Function * twice, FindFunction(user, "twice"));
+  ASSERT_EQ(twice->member_groups().size(), 1);
+  EXPECT_THAT(twice->member_groups().front().second->functions(),
+              testing::ElementsAre(twice));
+  EXPECT_EQ(get_a->bindings().size(), 1);
+}
+
+TEST_F(AnalysisTest, ModuleInterfaces) {
+  auto store = env()->module_store();
+  const std_filesystem::path interface_dir =
+      std_filesystem::path(testing::TempDir()) / "module_interfaces";
+  std_filesystem::remove_all(interface_dir);
+  ASSERT_OK(store->SetInterfaceDir(interface_dir.native()));
+  const std::string lib_code = R"(
+def typed(x: Int) : Int => x * 2
+def generic(x: {T: Numeric}) => x + x
+)";
+  store->set_module_code("iface_lib", lib_code);
+  store->set_module_code("iface_main", R"(
+import iface_lib
+y = iface_lib.typed(2) + iface_lib.generic(3)
+)");
+  ASSERT_OK(store->ImportModule("iface_main").status());
+  EXPECT_FALSE(store->GetModule("iface_lib").value()->is_interface());
+  EXPECT_TRUE(std_filesystem::exists(interface_dir / "iface_lib.ndli"));
+
+  // Analyzed again, the imported module comes from its interface.
+  store->InvalidateModule("iface_lib");
+  ASSERT_OK(store->ImportModule("iface_main").status());
+  Module* lib = store->GetModule("iface_lib").value();
+  EXPECT_TRUE(lib->is_interface());
+  EXPECT_FALSE(store->GetModule("iface_main").value()->is_interface());
+  ASSERT_OK_AND_ASSIGN(Function * typed, FindFunction(lib, "typed"));
+  EXPECT_TRUE(typed->body_elided());
+  EXPECT_TRUE(typed->expressions().empty());
+  ASSERT_OK_AND_ASSIGN(Function * generic, FindFunction(lib, "generic"));
+  EXPECT_FALSE(generic->body_elided());
+  // With bindings on use, the new bindings of the generic function are
+  // converted in the importing module, and the typed function is called
+  // in its module, while the interface module itself cannot be converted.
+  ASSERT_OK_AND_ASSIGN(auto main_code,
+                       conversion::PythonConverter(true).ConvertModule(
+                           store->GetModule("iface_main").value()));
+  ASSERT_FALSE(main_code.files.empty());
+  EXPECT_THAT(main_code.files.front().content,
+              testing::HasSubstr("iface_lib__generic"));
+  EXPECT_THAT(main_code.files.front().content,
+              testing::HasSubstr("iface_lib.typed("));
+  EXPECT_FALSE(generic->bindings().empty());
+  EXPECT_THAT(
+      conversion::PythonConverter().ConvertModule(lib).status().message(),
+      testing::HasSubstr("without its body"));
+
+  // Once the source changes, the interface is no longer used.
+  store->set_module_code("iface_lib", absl::StrCat(lib_code, "z = 1\n"));
+  ASSERT_OK(store->ReimportChangedModules().status());
+  EXPECT_FALSE(store->GetModule("iface_lib").value()->is_interface());
+  ASSERT_OK(store->SetInterfaceDir(""));
+}
+
+TEST_F(AnalysisTest, ModuleInterfaceDependencies) {
+  auto store = env()->module_store();
+  const std_filesystem::path interface_dir =
+      std_filesystem::path(testing::TempDir()) / "module_interface_deps";
+  std_filesystem::remove_all(interface_dir);
+  ASSERT_OK(store->SetInterfaceDir(interface_dir.native()));
+  store->set_module_code("iface_dep_base", "def base(x: Int) => x + 1\n");
+  store->set_module_code("iface_dep_lib", R"(
+import iface_dep_base
+def typed(x: Int) : Int => iface_dep_base.base(x)
+)");
+  store->set_module_code("iface_dep_main", R"(
+import iface_dep_lib
+y = iface_dep_lib.typed(2)
+)");
+  ASSERT_OK(store->ImportModule("iface_dep_main").status());
+
+  // With the same imported sources, the interface is used.
+  store->InvalidateModule("iface_dep_lib");
+  ASSERT_OK(store->ImportModule("iface_dep_main").status());
+  EXPECT_TRUE(store->GetModule("iface_dep_lib").value()->is_interface());
+
+  // Once an imported module changes, the interface is no longer used,
+  // even if the source of the module itself did not change.
+  store->set_module_code("iface_dep_base", "def base(x: Int) => x + 2\n");
+  store->InvalidateModule("iface_dep_base");
+  ASSERT_OK(store->ImportModule("iface_dep_main").status());
+  EXPECT_FALSE(store->GetModule("iface_dep_lib").value()->is_interface());
+  ASSERT_OK(store->SetInterfaceDir(""));
+}
+
+TEST_F(AnalysisTest, ModuleInterfaceBuiltinDependency) {
+  const std_filesystem::path base_dir =
+      std_filesystem::path(testing::TempDir()) / "module_interface_builtin";
+  std_filesystem::remove_all(base_dir);
+  const std_filesystem::path interface_dir = base_dir / "interfaces";
+  auto store = env()->module_store();
+  ASSERT_OK(store->SetInterfaceDir(interface_dir.native()));
+  store->set_module_code("iface_builtin_lib", "def typed(x: Int) => x + 1\n");
+  ASSERT_OK(store->ImportModule("iface_builtin_lib").status());
+  ASSERT_OK(store->SetInterfaceDir(""));
+
+  // An environment with the same builtin module uses the interface.
+  auto import_lib = [&interface_dir](
+                        absl::string_view builtin_file,
+                        absl::string_view search_path) -> absl::StatusOr<bool> {
+    ASSIGN_OR_RETURN(
+        auto env, Environment::Build(builtin_file, {std::string(search_path)},
+                                     EnvironmentOptions{
+                                         "", false, interface_dir.native()}));
+    auto env_store = env->module_store();
+    env_store->set_module_code("iface_builtin_lib",
+                               "def typed(x: Int) => x + 1\n");
+    env_store->set_module_code("iface_builtin_main", R"(
+import iface_builtin_lib
+y = iface_builtin_lib.typed(2)
+)");
+    RETURN_IF_ERROR(env_store->ImportModule("iface_builtin_main").status());
+    return env_store->GetModule("iface_builtin_lib").value()->is_interface();
+  };
+  ASSERT_OK_AND_ASSIGN(bool is_interface,
+                       import_lib(builtin_file_, search_path_));
+  EXPECT_TRUE(is_interface);
+
+  // Once the builtin module changes, the interface is no longer used.
+  std::string builtin_code;
+  {
+    std::ifstream builtin_in(builtin_file_);
+    builtin_code.assign(std::istreambuf_iterator<char>(builtin_in),
+                        std::istreambuf_iterator<char>());
+  }
+  ASSERT_FALSE(builtin_code.empty());
+  const std_filesystem::path changed_builtin = base_dir / "nudl_builtins.ndl";
+  std::ofstream(changed_builtin) << builtin_code << "\n// Changed.\n";
+  ASSERT_OK_AND_ASSIGN(is_interface,
+                       import_lib(changed_builtin.native(), search_path_));
+  EXPECT_FALSE(is_interface);
+}
+
+TEST_F(AnalysisTest, BuiltinSnapshot) {
+  const std_filesystem::path base_dir =
+      std_filesystem::path(testing::TempDir()) / "builtin_snapshot";
+  std_filesystem::remove_all(base_dir);
+  std_filesystem::create_directories(base_dir);
+  const std_filesystem::path snapshot_path = base_dir / "builtins.pb";
+  ASSERT_OK(
+      Environment::WriteBuiltinSnapshot(builtin_file_, snapshot_path.native()));
+  auto num_deferred = [](Module* module) {
+    size_t count = 0;
+    for (Function* fun : module->DefinedFunctions()) {
+      count += fun->has_deferred_body() ? 1 : 0;
+    }
+    return count;
+  };
+  // Without the snapshot, all builtin bodies are built upfront.
+  EXPECT_EQ(num_deferred(env()->builtin_module()), 0);
+
+  EnvironmentOptions options;
+  options.builtin_snapshot_path = snapshot_path.native();
+  ASSERT_OK_AND_ASSIGN(
+      auto snapshot_env,
+      Environment::Build(builtin_file_, {search_path_}, options));
+  Module* builtin = snapshot_env->builtin_module();
+  const size_t initial_deferred = num_deferred(builtin);
+  EXPECT_GT(initial_deferred, 0);
+  // The verified bodies are built when first called.
+  auto store = snapshot_env->module_store();
+  store->set_module_code("snapshot_main", R"(
+def f(s: Nullable<String>) : String => ensure(s)
+)");
+  ASSERT_OK(store->ImportModule("snapshot_main").status());
+  EXPECT_LT(num_deferred(builtin), initial_deferred);
+  ASSERT_OK(builtin->BuildDeferredBodies());
+  EXPECT_EQ(num_deferred(builtin), 0);
+
+  // A snapshot of different builtin code is not used.
+  std::string builtin_code;
+  {
+    std::ifstream builtin_in(builtin_file_);
+    builtin_code.assign(std::istreambuf_iterator<char>(builtin_in),
+                        std::istreambuf_iterator<char>());
+  }
+  ASSERT_FALSE(builtin_code.empty());
+  const std_filesystem::path changed_builtin = base_dir / "nudl_builtins.ndl";
+  std::ofstream(changed_builtin) << builtin_code << "\n// Changed.\n";
+  ASSERT_OK_AND_ASSIGN(
+      auto changed_env,
+      Environment::Build(changed_builtin.native(), {search_path_}, options));
+  EXPECT_EQ(num_deferred(changed_env->builtin_module()), 0);
+}
+
 TEST_F(AnalysisTest, JustPrepare) {
   PrepareCode("general_test", "prepare_test", "x = null", true);
 }
@@ -0,0 +1,77 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Writes a synthetic nudl workload, for scale testing. E.g.:
+//  ./bazel-bin/nudl/analysis/testing/generate_workload
+//      --output_dir=/tmp/workload --num_modules=20
+//      --functions_per_module=200 --overloads_per_function=4
+// The generated modules can then be converted with:
+//  ./bazel-bin/nudl/conversion/convert --search_paths=/tmp/workload
+//      --input=workload_19 ...
+
+#include <iostream>
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "nudl/analysis/testing/workload_generator.h"
+
+ABSL_FLAG(std::string, output_dir, "",
+          "Directory where to write the generated modules.");
+ABSL_FLAG(size_t, num_modules, 1,
+          "Number of modules in the import chain. At least one.");
+ABSL_FLAG(size_t, functions_per_module, 10,
+          "Number of function groups in each module.");
+ABSL_FLAG(size_t, overloads_per_function, 1,
+          "Number of overloads in each function group.");
+ABSL_FLAG(size_t, schema_fields, 10,
+          "Number of fields in the schema of each module.");
+ABSL_FLAG(size_t, type_depth, 1,
+          "Nesting levels of array types in function parameters.");
+ABSL_FLAG(size_t, generic_depth, 1,
+          "Number of functions in the generic function call chain.");
+ABSL_FLAG(size_t, lambda_nesting, 1, "Nesting levels of lambda functions.");
+ABSL_FLAG(std::string, module_prefix, "workload",
+          "Prefix of the generated module names.");
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  if (absl::GetFlag(FLAGS_output_dir).empty()) {
+    std::cerr << "Please specify --output_dir" << std::endl;
+    return 1;
+  }
+  if (absl::GetFlag(FLAGS_num_modules) < 1) {
+    std::cerr << "Please specify a --num_modules of at least 1" << std::endl;
+    return 1;
+  }
+  nudl::analysis::WorkloadOptions options;
+  options.num_modules = absl::GetFlag(FLAGS_num_modules);
+  options.functions_per_module = absl::GetFlag(FLAGS_functions_per_module);
+  options.overloads_per_function = absl::GetFlag(FLAGS_overloads_per_function);
+  options.schema_fields = absl::GetFlag(FLAGS_schema_fields);
+  options.type_depth = absl::GetFlag(FLAGS_type_depth);
+  options.generic_depth = absl::GetFlag(FLAGS_generic_depth);
+  options.lambda_nesting = absl::GetFlag(FLAGS_lambda_nesting);
+  options.module_prefix = absl::GetFlag(FLAGS_module_prefix);
+  auto status =
+      nudl::analysis::WriteWorkload(nudl::analysis::GenerateWorkload(options),
+                                    absl::GetFlag(FLAGS_output_dir));
+  if (!status.ok()) {
+    std::cerr << "Error writing the workload: " << status << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -264,6 +264,45 @@ TEST(ScopeName, IsPrefix) {
   }
 }
 
+TEST(ScopeName, Interned) {
+  ASSERT_OK_AND_ASSIGN(ScopeName n1, ScopeName::Parse("foo.bar::baz"));
+  ASSERT_OK_AND_ASSIGN(ScopeName n2, ScopeName::Parse("foo.bar"));
+  ASSERT_OK_AND_ASSIGN(ScopeName n3, n2.Subfunction("baz"));
+  ASSERT_OK_AND_ASSIGN(ScopeName n4, ScopeName::Parse("foo.bar::qux"));
+  EXPECT_EQ(n1, n3);
+  EXPECT_EQ(n1.id(), n3.id());
+  EXPECT_EQ(n1.hash(), n3.hash());
+  EXPECT_EQ(&n1.name(), &n3.name());
+  EXPECT_NE(n1, n4);
+  EXPECT_NE(n1.id(), n4.id());
+  EXPECT_EQ(n1.PrefixScopeName(2), n2);
+  EXPECT_EQ(n1.PrefixScopeName(0), ScopeName());
+  EXPECT_EQ(n4.PrefixScopeName(2), n2);
+  EXPECT_EQ(n2.Subscope(n1.SuffixScopeName(2)), n1);
+  EXPECT_EQ(ScopeName(n1.module_names(), n1.function_names()), n1);
+  ASSERT_OK_AND_ASSIGN(ScopeName n5, ScopeName::FromProto(n1.ToProto()));
+  EXPECT_EQ(n5, n1);
+}
+
+TEST(ScopeName, Released) {
+  ScopeName kept;
+  size_t full_id = 0;
+  {
+    ASSERT_OK_AND_ASSIGN(ScopeName n1, ScopeName::Parse("released.mod::fun"));
+    full_id = n1.id();
+    kept = n1.PrefixScopeName(2);
+  }
+  // The unused name is dropped from the table, and interned again,
+  // while its prefix, still in use, keeps its entry.
+  ScopeName::ReleaseUnusedNames();
+  ASSERT_OK_AND_ASSIGN(ScopeName n2, ScopeName::Parse("released.mod::fun"));
+  EXPECT_NE(n2.id(), full_id);
+  EXPECT_EQ(n2.PrefixScopeName(2), kept);
+  EXPECT_EQ(n2.PrefixScopeName(2).id(), kept.id());
+  ASSERT_OK_AND_ASSIGN(ScopeName n3, kept.Subfunction("fun"));
+  EXPECT_EQ(n3, n2);
+}
+
 TEST(SopeName, Protos) {
   ASSERT_OK_AND_ASSIGN(auto scope_name, ScopeName::Parse("foo.bar::baz::qux"));
   auto proto = scope_name.ToProto();
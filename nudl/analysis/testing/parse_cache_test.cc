@@ -0,0 +1,73 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "nudl/analysis/parse_cache.h"
+
+#include <fstream>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "nudl/grammar/dsl.h"
+#include "nudl/status/testing.h"
+#include "nudl/testing/protobuf_matchers.h"
+
+namespace nudl {
+namespace analysis {
+
+TEST(ParseCache, StoreAndFind) {
+  const std_filesystem::path cache_dir =
+      std_filesystem::path(::testing::TempDir()) / "parse_cache_test";
+  std_filesystem::remove_all(cache_dir);
+  ASSERT_OK_AND_ASSIGN(auto cache, ParseCache::Build(cache_dir.native()));
+  EXPECT_TRUE(std_filesystem::is_directory(cache_dir));
+  const std::string code = "x = 1";
+  ASSERT_OK_AND_ASSIGN(auto module, grammar::ParseModule(code));
+  EXPECT_FALSE(cache->Find(code).has_value());
+  EXPECT_EQ(cache->misses(), 1);
+  ASSERT_OK(cache->Store(code, *module));
+  auto cached_module = cache->Find(code);
+  ASSERT_TRUE(cached_module.has_value());
+  EXPECT_THAT(*cached_module.value(), EqualsProto(*module));
+  EXPECT_EQ(cache->hits(), 1);
+  EXPECT_NE(cache->CachePath(code), cache->CachePath("x = 2"));
+  EXPECT_FALSE(cache->Find("x = 2").has_value());
+  // A corrupted cache entry is just a miss:
+  {
+    std::ofstream ofile(cache->CachePath(code),
+                        std::ios::out | std::ios::trunc);
+    ofile << "garbage";
+  }
+  EXPECT_FALSE(cache->Find(code).has_value());
+  EXPECT_EQ(cache->misses(), 3);
+}
+
+TEST(ParseCache, Snapshot) {
+  const std_filesystem::path snapshot_path =
+      std_filesystem::path(::testing::TempDir()) / "parse_snapshot.pb";
+  const std::string code = "x = 1";
+  ASSERT_OK_AND_ASSIGN(auto module, grammar::ParseModule(code));
+  EXPECT_RAISES(ReadParseSnapshot(snapshot_path / "missing", code).status(),
+                NotFound);
+  ASSERT_OK(WriteParseSnapshot(snapshot_path, code, *module));
+  ASSERT_OK_AND_ASSIGN(auto snapshot_module,
+                       ReadParseSnapshot(snapshot_path, code));
+  EXPECT_THAT(*snapshot_module, EqualsProto(*module));
+  EXPECT_RAISES(ReadParseSnapshot(snapshot_path, "x = 2").status(),
+                FailedPrecondition);
+}
+
+}  // namespace analysis
+}  // namespace nudl
@@ -0,0 +1,496 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for the stages of the nudl pipeline: parsing, module
+// import (parse + analysis), function signature lookup, function binding
+// and python conversion. Run from the repository top directory (or the
+// runfiles directory), e.g.:
+//   ./bazel-bin/nudl/analysis/testing/pipeline_benchmark
+//       --benchmark_filter=Import
+// Besides the time, each benchmark reports the number of heap
+// allocations per iteration, in the `allocs` counter.
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "benchmark/benchmark.h"
+#include "nudl/analysis/analysis.h"
+#include "nudl/analysis/testing/workload_generator.h"
+#include "nudl/conversion/python_converter.h"
+#include "nudl/grammar/dsl.h"
+#include "nudl/status/status.h"
+
+namespace {
+std::atomic<size_t> num_allocations{0};
+}  // namespace
+
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t size) noexcept { std::free(ptr); }
+
+namespace nudl {
+namespace analysis {
+
+namespace {
+
+// Sets the `allocs` counter of the benchmark, upon destruction, to the
+// number of allocations per iteration, made during its lifetime.
+class AllocationCounter {
+ public:
+  explicit AllocationCounter(benchmark::State* state)
+      : state_(state), start_(num_allocations.load()) {}
+  ~AllocationCounter() {
+    state_->counters["allocs"] =
+        benchmark::Counter(num_allocations.load() - start_,
+                           benchmark::Counter::kAvgIterations);
+  }
+
+ private:
+  benchmark::State* const state_;
+  const size_t start_;
+};
+
+struct BenchmarkInput {
+  // Name of the input, as it appears in the benchmark name.
+  std::string name;
+  // The builtin module for the environment in which we import the input.
+  std::string builtin_path;
+  // Search path for the input module and its imports.
+  std::string search_path;
+  // The module to use as input.
+  std::string module_name;
+};
+
+constexpr absl::string_view kTestdataBuiltin =
+    "nudl/analysis/testing/testdata/nudl_builtins.ndl";
+constexpr absl::string_view kTestdataPath = "nudl/analysis/testing/testdata";
+constexpr absl::string_view kPylibBuiltin =
+    "nudl/conversion/pylib/nudl_builtins.ndl";
+constexpr absl::string_view kPylibPath = "nudl/conversion/pylib";
+
+std::vector<BenchmarkInput> FileInputs() {
+  return std::vector<BenchmarkInput>{
+      {"cdm", std::string(kTestdataBuiltin), std::string(kTestdataPath),
+       "cdm"},
+      {"lambda", std::string(kTestdataBuiltin), std::string(kTestdataPath),
+       "lambda"},
+      {"submodule.compute", std::string(kTestdataBuiltin),
+       std::string(kTestdataPath), "submodule.compute"},
+      {"examples.cdm", std::string(kPylibBuiltin), std::string(kPylibPath),
+       "examples.cdm"},
+      {"examples.claim", std::string(kPylibBuiltin), std::string(kPylibPath),
+       "examples.claim"},
+      {"examples.examples", std::string(kPylibBuiltin),
+       std::string(kPylibPath), "examples.examples"},
+  };
+}
+
+absl::StatusOr<std::string> ReadInputCode(const BenchmarkInput& input) {
+  const std::string path =
+      absl::StrCat(input.search_path, "/",
+                   absl::StrReplaceAll(input.module_name, {{".", "/"}}),
+                   ".ndl");
+  std::ifstream infile(path);
+  if (!infile.is_open()) {
+    return status::NotFoundErrorBuilder()
+           << "Cannot open benchmark input: " << path;
+  }
+  std::stringstream buffer;
+  buffer << infile.rdbuf();
+  return buffer.str();
+}
+
+// A single generated module, with size functions and schema fields,
+// to observe how the stages scale with the module size.
+std::string SyntheticModule(size_t size) {
+  WorkloadOptions options;
+  options.functions_per_module = size;
+  options.schema_fields = size;
+  return GenerateWorkload(options).front().code;
+}
+
+// Environments are expensive to build, so we keep one per builtin module,
+// and arena setting.
+absl::StatusOr<Environment*> GetEnvironment(absl::string_view builtin_path,
+                                            absl::string_view search_path,
+                                            bool use_arena = true) {
+  static auto* const environments =
+      new absl::flat_hash_map<std::string, std::unique_ptr<Environment>>();
+  const std::string key =
+      absl::StrCat(builtin_path, use_arena ? "" : ":no_arena");
+  auto it = environments->find(key);
+  if (it != environments->end()) {
+    return it->second.get();
+  }
+  EnvironmentOptions options;
+  options.use_arena = use_arena;
+  ASSIGN_OR_RETURN(auto env,
+                   Environment::Build(builtin_path, {std::string(search_path)},
+                                      options));
+  Environment* result = env.get();
+  environments->emplace(key, std::move(env));
+  return result;
+}
+
+// Each import needs a new module name, as modules are imported just once.
+std::string NextModuleName() {
+  static size_t next_id = 0;
+  return absl::StrCat("benchmark_module_", next_id++);
+}
+
+void BenchmarkParse(benchmark::State& state, const std::string& code) {
+  AllocationCounter allocations(&state);
+  for (auto _ : state) {
+    auto result = grammar::ParseModule(code);
+    if (!result.ok()) {
+      state.SkipWithError(result.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetBytesProcessed(state.iterations() * code.size());
+}
+
+void BenchmarkImport(benchmark::State& state, Environment* env,
+                     const std::string& code) {
+  AllocationCounter allocations(&state);
+  for (auto _ : state) {
+    state.PauseTiming();
+    const std::string module_name = NextModuleName();
+    state.ResumeTiming();
+    auto result = env->module_store()->ImportFromString(module_name, code);
+    if (!result.ok()) {
+      state.SkipWithError(result.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(result);
+  }
+}
+
+void BenchmarkConvert(benchmark::State& state, Environment* env,
+                      const std::string& code) {
+  auto module = env->module_store()->ImportFromString(NextModuleName(), code);
+  if (!module.ok()) {
+    state.SkipWithError(module.status().ToString().c_str());
+    return;
+  }
+  conversion::PythonConverter converter;
+  AllocationCounter allocations(&state);
+  for (auto _ : state) {
+    auto result = converter.ConvertModule(module.value());
+    if (!result.ok()) {
+      state.SkipWithError(result.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(result);
+  }
+}
+
+void BM_ParseFile(benchmark::State& state, const BenchmarkInput& input) {
+  auto code = ReadInputCode(input);
+  if (!code.ok()) {
+    state.SkipWithError(code.status().ToString().c_str());
+    return;
+  }
+  BenchmarkParse(state, code.value());
+}
+
+void BM_ImportFile(benchmark::State& state, const BenchmarkInput& input) {
+  auto code = ReadInputCode(input);
+  auto env = GetEnvironment(input.builtin_path, input.search_path);
+  if (!code.ok() || !env.ok()) {
+    state.SkipWithError(
+        (code.ok() ? env.status() : code.status()).ToString().c_str());
+    return;
+  }
+  BenchmarkImport(state, env.value(), code.value());
+}
+
+void BM_ConvertFile(benchmark::State& state, const BenchmarkInput& input) {
+  auto code = ReadInputCode(input);
+  auto env = GetEnvironment(input.builtin_path, input.search_path);
+  if (!code.ok() || !env.ok()) {
+    state.SkipWithError(
+        (code.ok() ? env.status() : code.status()).ToString().c_str());
+    return;
+  }
+  BenchmarkConvert(state, env.value(), code.value());
+}
+
+void BM_ParseSynthetic(benchmark::State& state) {
+  BenchmarkParse(state, SyntheticModule(state.range(0)));
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_ParseSynthetic)->RangeMultiplier(4)->Range(8, 512)->Complexity();
+
+void BM_ImportSynthetic(benchmark::State& state) {
+  auto env = GetEnvironment(kTestdataBuiltin, kTestdataPath);
+  if (!env.ok()) {
+    state.SkipWithError(env.status().ToString().c_str());
+    return;
+  }
+  BenchmarkImport(state, env.value(), SyntheticModule(state.range(0)));
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_ImportSynthetic)->RangeMultiplier(4)->Range(8, 512)->Complexity();
+
+void BM_ConvertSynthetic(benchmark::State& state) {
+  auto env = GetEnvironment(kTestdataBuiltin, kTestdataPath);
+  if (!env.ok()) {
+    state.SkipWithError(env.status().ToString().c_str());
+    return;
+  }
+  BenchmarkConvert(state, env.value(), SyntheticModule(state.range(0)));
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_ConvertSynthetic)
+    ->RangeMultiplier(4)
+    ->Range(8, 512)
+    ->Complexity();
+
+// Imports a generated module, then invalidates it, as done by the
+// conversion server, with the analysis objects allocated in per-module
+// arenas (use_arena = 1), or on the heap (0).
+void BM_ImportRelease(benchmark::State& state) {
+  const bool use_arena = state.range(0) != 0;
+  auto env = GetEnvironment(kTestdataBuiltin, kTestdataPath, use_arena);
+  if (!env.ok()) {
+    state.SkipWithError(env.status().ToString().c_str());
+    return;
+  }
+  ModuleStore* module_store = env.value()->module_store();
+  const std::string code = SyntheticModule(state.range(1));
+  AllocationCounter allocations(&state);
+  for (auto _ : state) {
+    state.PauseTiming();
+    const std::string module_name = NextModuleName();
+    state.ResumeTiming();
+    auto result = module_store->ImportFromString(module_name, code);
+    if (!result.ok()) {
+      state.SkipWithError(result.status().ToString().c_str());
+      break;
+    }
+    module_store->InvalidateModule(module_name);
+  }
+  state.SetComplexityN(state.range(1));
+}
+BENCHMARK(BM_ImportRelease)
+    ->ArgNames({"use_arena", "size"})
+    ->ArgsProduct({{0, 1}, {8, 64, 512}});
+
+// Imports a generated workload, with a new module prefix per iteration.
+void BenchmarkWorkloadImport(benchmark::State& state,
+                             WorkloadOptions options) {
+  if (options.num_modules < 1) {
+    state.SkipWithError("No workload module to import");
+    return;
+  }
+  auto env = GetEnvironment(kTestdataBuiltin, kTestdataPath);
+  if (!env.ok()) {
+    state.SkipWithError(env.status().ToString().c_str());
+    return;
+  }
+  ModuleStore* module_store = env.value()->module_store();
+  AllocationCounter allocations(&state);
+  for (auto _ : state) {
+    state.PauseTiming();
+    options.module_prefix = NextModuleName();
+    const auto modules = GenerateWorkload(options);
+    for (const auto& module : modules) {
+      module_store->set_module_code(module.name, module.code);
+    }
+    state.ResumeTiming();
+    auto result = module_store->ImportModule(modules.back().name);
+    if (!result.ok()) {
+      state.SkipWithError(result.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetComplexityN(state.range(0));
+}
+
+void BM_ImportWorkloadChain(benchmark::State& state) {
+  WorkloadOptions options;
+  options.num_modules = state.range(0);
+  BenchmarkWorkloadImport(state, options);
+}
+BENCHMARK(BM_ImportWorkloadChain)
+    ->RangeMultiplier(2)
+    ->Range(1, 32)
+    ->Complexity();
+
+void BM_ImportWorkloadOverloads(benchmark::State& state) {
+  WorkloadOptions options;
+  options.overloads_per_function = state.range(0);
+  BenchmarkWorkloadImport(state, options);
+}
+BENCHMARK(BM_ImportWorkloadOverloads)
+    ->RangeMultiplier(2)
+    ->Range(1, 32)
+    ->Complexity();
+
+void BM_ImportWorkloadGenerics(benchmark::State& state) {
+  WorkloadOptions options;
+  options.generic_depth = state.range(0);
+  BenchmarkWorkloadImport(state, options);
+}
+BENCHMARK(BM_ImportWorkloadGenerics)
+    ->RangeMultiplier(2)
+    ->Range(1, 32)
+    ->Complexity();
+
+void BM_ImportWorkloadLambdas(benchmark::State& state) {
+  WorkloadOptions options;
+  options.lambda_nesting = state.range(0);
+  BenchmarkWorkloadImport(state, options);
+}
+BENCHMARK(BM_ImportWorkloadLambdas)->DenseRange(1, 4)->Complexity();
+
+absl::StatusOr<NamedObject*> FindObject(Scope* scope, absl::string_view name) {
+  ASSIGN_OR_RETURN(auto scoped_name, ScopedName::Parse(name));
+  return scope->FindName(scope->scope_name(), scoped_name);
+}
+
+absl::StatusOr<std::vector<FunctionCallArgument>> TypeArguments(
+    Scope* scope, const std::vector<std::string>& type_names) {
+  std::vector<FunctionCallArgument> arguments;
+  for (const auto& type_name : type_names) {
+    ASSIGN_OR_RETURN(auto type_spec, scope->FindTypeByName(type_name));
+    FunctionCallArgument argument;
+    argument.type_spec = type_spec;
+    arguments.emplace_back(std::move(argument));
+  }
+  return arguments;
+}
+
+// Finds the signature of the builtin `__add__` operator function group,
+// for two arguments of the provided type.
+void BM_FindSignature(benchmark::State& state, const std::string& type_name) {
+  auto env = GetEnvironment(kTestdataBuiltin, kTestdataPath);
+  if (!env.ok()) {
+    state.SkipWithError(env.status().ToString().c_str());
+    return;
+  }
+  Module* builtin = env.value()->builtin_module();
+  auto object = FindObject(builtin, "__add__");
+  auto arguments = TypeArguments(builtin, {type_name, type_name});
+  if (!object.ok() || !arguments.ok() ||
+      !FunctionGroup::IsFunctionGroup(*object.value())) {
+    state.SkipWithError("Cannot prepare the __add__ signature lookup");
+    return;
+  }
+  auto group = static_cast<FunctionGroup*>(object.value());
+  AllocationCounter allocations(&state);
+  for (auto _ : state) {
+    auto result = group->FindSignature(arguments.value());
+    if (!result.ok()) {
+      state.SkipWithError(result.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(result);
+  }
+}
+BENCHMARK_CAPTURE(BM_FindSignature, Int, std::string("Int"));
+BENCHMARK_CAPTURE(BM_FindSignature, Float64, std::string("Float64"));
+BENCHMARK_CAPTURE(BM_FindSignature, String, std::string("String"));
+
+// Binds the arguments of a generic (non-native) function, and obtains
+// the function instance for the binding. The instance is created on the
+// first iteration, then reused.
+void BM_FunctionBind(benchmark::State& state, const std::string& type_name) {
+  auto env = GetEnvironment(kTestdataBuiltin, kTestdataPath);
+  if (!env.ok()) {
+    state.SkipWithError(env.status().ToString().c_str());
+    return;
+  }
+  auto module = env.value()->module_store()->ImportFromString(
+      NextModuleName(), "def twice(x: {T: Numeric}) => x + x");
+  if (!module.ok()) {
+    state.SkipWithError(module.status().ToString().c_str());
+    return;
+  }
+  auto object = FindObject(module.value(), "twice");
+  auto arguments = TypeArguments(module.value(), {type_name});
+  if (!object.ok() || !arguments.ok() ||
+      !FunctionGroup::IsFunctionGroup(*object.value()) ||
+      static_cast<FunctionGroup*>(object.value())->functions().empty()) {
+    state.SkipWithError("Cannot prepare the function to bind");
+    return;
+  }
+  Function* function =
+      static_cast<FunctionGroup*>(object.value())->functions().front();
+  AllocationCounter allocations(&state);
+  for (auto _ : state) {
+    auto binding = function->BindArguments(arguments.value());
+    if (!binding.ok()) {
+      state.SkipWithError(binding.status().ToString().c_str());
+      break;
+    }
+    auto bound_function = function->Bind(binding.value().get(), true);
+    if (!bound_function.ok()) {
+      state.SkipWithError(bound_function.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(bound_function);
+  }
+}
+BENCHMARK_CAPTURE(BM_FunctionBind, Int, std::string("Int"));
+BENCHMARK_CAPTURE(BM_FunctionBind, Float64, std::string("Float64"));
+
+void RegisterFileBenchmarks() {
+  for (const auto& input : FileInputs()) {
+    benchmark::RegisterBenchmark(
+        absl::StrCat("BM_ParseFile/", input.name).c_str(), BM_ParseFile,
+        input);
+    benchmark::RegisterBenchmark(
+        absl::StrCat("BM_ImportFile/", input.name).c_str(), BM_ImportFile,
+        input);
+    benchmark::RegisterBenchmark(
+        absl::StrCat("BM_ConvertFile/", input.name).c_str(), BM_ConvertFile,
+        input);
+  }
+}
+
+}  // namespace
+
+}  // namespace analysis
+}  // namespace nudl
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  nudl::analysis::RegisterFileBenchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -919,6 +919,122 @@ TEST_F(TypesTest, TypeStore) {
   EXPECT_EQ(TypeUtils::DedupTypes({&types[0], types.size()}).size(), 2);
 }
 
+TEST_F(TypesTest, TypeNameCache) {
+  ASSERT_OK_AND_ASSIGN(auto foo_name, ScopeName::Parse("foo"));
+  ASSERT_OK_AND_ASSIGN(auto bar_name, ScopeName::Parse("foo.bar"));
+  auto type_int = FindType("Int").value();
+  auto type_string = FindType("String").value();
+  ASSERT_OK_AND_ASSIGN(auto boom,
+                       store_.DeclareType(foo_name, "Boom", type_int->Clone()));
+  ASSERT_OK_AND_ASSIGN(auto f1,
+                       store_.FindTypeFromString(bar_name, "Array<Boom>"));
+  EXPECT_EQ(f1->parameters().front()->type_id(), boom->type_id());
+  EXPECT_EQ(store_.name_cache_stats().parse_misses, 1);
+  EXPECT_EQ(store_.name_cache_stats().find_misses, 1);
+  ASSERT_OK_AND_ASSIGN(auto f2,
+                       store_.FindTypeFromString(bar_name, "Array<Boom>"));
+  EXPECT_EQ(f1, f2);
+  EXPECT_EQ(store_.name_cache_stats().find_hits, 1);
+  // Same type name from another scope reuses the parsed specification.
+  ASSERT_OK(store_.FindTypeFromString(foo_name, "Array<Boom>").status());
+  EXPECT_EQ(store_.name_cache_stats().parse_hits, 1);
+  // Shadowing Boom in the inner scope invalidates the cached lookup.
+  ASSERT_OK_AND_ASSIGN(
+      auto boom2, store_.DeclareType(bar_name, "Boom", type_string->Clone()));
+  EXPECT_EQ(store_.name_cache_stats().invalidations, 2);
+  ASSERT_OK_AND_ASSIGN(auto f3,
+                       store_.FindTypeFromString(bar_name, "Array<Boom>"));
+  EXPECT_EQ(f3->parameters().front()->type_id(), boom2->type_id());
+  EXPECT_EQ(f3->parameters().front()->type_id(), pb::TypeId::STRING_ID);
+  // Local types are never cached:
+  const size_t find_misses = store_.name_cache_stats().find_misses;
+  ASSERT_OK(store_.FindTypeFromString(bar_name, "Array<{X}>").status());
+  ASSERT_OK(store_.FindTypeFromString(bar_name, "Array<{X}>").status());
+  EXPECT_EQ(store_.name_cache_stats().find_misses, find_misses + 2);
+  EXPECT_FALSE(store_.FindTypeFromString(bar_name, "Array<").ok());
+}
+
+TEST_F(TypesTest, CanonicalBoundTypes) {
+  ASSERT_OK_AND_ASSIGN(auto a1, FindType("Array<Int>"));
+  const BoundTypeStats stats = store_.bound_type_stats();
+  ASSERT_OK_AND_ASSIGN(auto a2, FindType("Array<Int>"));
+  EXPECT_EQ(a1, a2);
+  EXPECT_EQ(store_.bound_type_stats().hits, stats.hits + 1);
+  // Nested bindings reuse the canonical argument types:
+  ASSERT_OK_AND_ASSIGN(auto m1, FindType("Map<String, Array<Int>>"));
+  ASSERT_OK_AND_ASSIGN(auto m2, FindType("Map<String, Array<Int>>"));
+  EXPECT_EQ(m1, m2);
+  EXPECT_EQ(m1->parameters().back(), a1);
+  // Different arguments produce different types:
+  ASSERT_OK_AND_ASSIGN(auto a3, FindType("Array<String>"));
+  EXPECT_NE(a1, a3);
+  ASSERT_OK_AND_ASSIGN(auto d1, FindType("Decimal<10, 2>"));
+  ASSERT_OK_AND_ASSIGN(auto d2, FindType("Decimal<10, 3>"));
+  EXPECT_NE(d1, d2);
+  EXPECT_EQ(d1, FindType("Decimal<10, 2>").value());
+}
+
+TEST_F(TypesTest, RelationCache) {
+  ASSERT_OK_AND_ASSIGN(auto iter_num, FindType("Iterable<Numeric>"));
+  ASSERT_OK_AND_ASSIGN(auto array_int, FindType("Array<Int>"));
+  ASSERT_OK_AND_ASSIGN(auto array_str, FindType("Array<String>"));
+  const TypeRelationCacheStats stats = TypeSpec::relation_cache_stats();
+  EXPECT_TRUE(iter_num->IsAncestorOf(*array_int));
+  EXPECT_FALSE(iter_num->IsAncestorOf(*array_str));
+  EXPECT_EQ(TypeSpec::relation_cache_stats().misses, stats.misses + 2);
+  EXPECT_TRUE(iter_num->IsAncestorOf(*array_int));
+  EXPECT_FALSE(iter_num->IsAncestorOf(*array_str));
+  EXPECT_EQ(TypeSpec::relation_cache_stats().hits, stats.hits + 2);
+  // Relations are cached separately:
+  EXPECT_FALSE(array_int->IsEqual(*array_str));
+  EXPECT_TRUE(array_int->IsEqual(*array_int));
+  EXPECT_EQ(TypeSpec::relation_cache_stats().misses, stats.misses + 4);
+  // Types built anew get their own cache entries, even if equal:
+  {
+    auto array_clone = array_int->Clone();
+    EXPECT_TRUE(iter_num->IsAncestorOf(*array_clone));
+    EXPECT_EQ(TypeSpec::relation_cache_stats().misses, stats.misses + 5);
+  }
+  // Which are dropped with the type:
+  EXPECT_EQ(TypeSpec::relation_cache_stats().dropped, stats.dropped + 1);
+  // Non parameterized types are not cached:
+  ASSERT_OK_AND_ASSIGN(auto type_int, FindType("Int"));
+  ASSERT_OK_AND_ASSIGN(auto type_numeric, FindType("Numeric"));
+  EXPECT_TRUE(type_numeric->IsAncestorOf(*type_int));
+  EXPECT_EQ(TypeSpec::relation_cache_stats().misses, stats.misses + 5);
+}
+
+TEST_F(TypesTest, TypeFingerprint) {
+  ASSERT_OK_AND_ASSIGN(auto array_int, FindType("Array<Int>"));
+  ASSERT_OK_AND_ASSIGN(auto array_str, FindType("Array<String>"));
+  ASSERT_OK_AND_ASSIGN(auto nullable_int, FindType("Nullable<Int>"));
+  ASSERT_OK_AND_ASSIGN(auto type_int, FindType("Int"));
+  EXPECT_EQ(array_int->TypeFingerprint(),
+            array_int->Clone()->TypeFingerprint());
+  EXPECT_NE(array_int->TypeFingerprint(), array_str->TypeFingerprint());
+  EXPECT_NE(nullable_int->TypeFingerprint(), type_int->TypeFingerprint());
+  const std::vector<const TypeSpec*> types({array_int, type_int});
+  const std::vector<const TypeSpec*> swapped({type_int, array_int});
+  EXPECT_EQ(TypeSpec::TypeBindingFingerprint(absl::MakeConstSpan(types)),
+            TypeSpec::TypeBindingFingerprint(
+                std::vector<TypeBindingArg>({array_int, type_int})));
+  EXPECT_NE(TypeSpec::TypeBindingFingerprint(absl::MakeConstSpan(types)),
+            TypeSpec::TypeBindingFingerprint(absl::MakeConstSpan(swapped)));
+  EXPECT_NE(TypeSpec::TypeBindingFingerprint(std::vector<TypeBindingArg>({1})),
+            TypeSpec::TypeBindingFingerprint(std::vector<TypeBindingArg>({2})));
+  EXPECT_TRUE(array_int->HasSameSignature(*array_int->Clone()));
+  EXPECT_FALSE(array_int->HasSameSignature(*array_str));
+  EXPECT_TRUE(nullable_int->HasSameSignature(*nullable_int->Clone()));
+  EXPECT_FALSE(nullable_int->HasSameSignature(*type_int));
+  EXPECT_FALSE(type_int->HasSameSignature(*nullable_int));
+  // Bindings to equal, but separately built types share their members.
+  ASSERT_OK_AND_ASSIGN(auto type_array, FindType("Array"));
+  const std::unique_ptr<TypeSpec> int_copy = type_int->Clone();
+  ASSERT_OK_AND_ASSIGN(auto bound_int, type_array->Bind({type_int}));
+  ASSERT_OK_AND_ASSIGN(auto bound_copy, type_array->Bind({int_copy.get()}));
+  EXPECT_EQ(bound_int->type_member_store(), bound_copy->type_member_store());
+}
+
 TEST_F(TypesTest, TypesFromBindings) {
   ASSERT_OK_AND_ASSIGN(auto scope_name, ScopeName::Parse("foo.bar"));
   ASSERT_OK(store_.AddScope(std::make_shared<ScopeName>(scope_name)));
@@ -0,0 +1,183 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "nudl/analysis/testing/workload_generator.h"
+
+#include <fstream>
+#include <system_error>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "nudl/analysis/module.h"
+#include "nudl/status/status.h"
+
+namespace nudl {
+namespace analysis {
+
+namespace {
+
+std::string ModuleName(const WorkloadOptions& options, size_t index) {
+  return absl::StrCat(options.module_prefix, "_", index);
+}
+
+void AppendSchema(const WorkloadOptions& options, std::string* code) {
+  if (!options.schema_fields) {
+    return;
+  }
+  absl::StrAppend(code, "schema Record = {\n");
+  std::vector<std::string> fields;
+  for (size_t i = 0; i < options.schema_fields; ++i) {
+    absl::StrAppend(code, "  field_", i, ": Int;\n");
+    fields.emplace_back(absl::StrCat("r.field_", i));
+  }
+  absl::StrAppend(code, "}\n\n",
+                  "def record_sum(r: Record) : Int =>\n  ",
+                  absl::StrJoin(fields, " + "), "\n\n");
+}
+
+void AppendFunctions(const WorkloadOptions& options, std::string* code) {
+  for (size_t i = 0; i < options.functions_per_module; ++i) {
+    for (size_t arity = 1; arity <= options.overloads_per_function;
+         ++arity) {
+      std::vector<std::string> params;
+      std::vector<std::string> terms;
+      for (size_t j = 0; j < arity; ++j) {
+        params.emplace_back(absl::StrCat("x", j, ": Int"));
+        terms.emplace_back(absl::StrCat("x", j));
+      }
+      if (i > 0) {
+        terms.front() = absl::StrCat("f_", i - 1, "(x0) * 2");
+      }
+      terms.emplace_back(absl::StrCat(i + 1));
+      absl::StrAppend(code, "def f_", i, "(", absl::StrJoin(params, ", "),
+                      ") : Int =>\n  ", absl::StrJoin(terms, " + "), "\n");
+    }
+  }
+  absl::StrAppend(code, "\n");
+}
+
+void AppendGenerics(const WorkloadOptions& options, std::string* code) {
+  if (!options.generic_depth) {
+    return;
+  }
+  absl::StrAppend(code, "def generic_0(x: {T: Numeric}) => x + x\n");
+  for (size_t i = 1; i < options.generic_depth; ++i) {
+    absl::StrAppend(code, "def generic_", i, "(x: {T: Numeric}) => generic_",
+                    i - 1, "(x) + x\n");
+  }
+  const size_t last = options.generic_depth - 1;
+  absl::StrAppend(code, "def use_generic_int(x: Int) : Int => generic_", last,
+                  "(x)\n", "def use_generic_float(x: Float64) : Float64 => ",
+                  "generic_", last, "(x)\n\n");
+}
+
+void AppendNested(const WorkloadOptions& options, std::string* code) {
+  if (!options.type_depth) {
+    return;
+  }
+  std::string type_name("Int");
+  for (size_t i = 0; i < options.type_depth; ++i) {
+    type_name = absl::StrCat("Array<", type_name, ">");
+  }
+  absl::StrAppend(code, "def nested(x: ", type_name, ") : UInt => len(x)\n\n");
+}
+
+void AppendLambdas(const WorkloadOptions& options, std::string* code) {
+  if (!options.lambda_nesting) {
+    return;
+  }
+  const size_t last = options.lambda_nesting - 1;
+  std::string body = absl::StrCat("len(s_", last, ")");
+  for (size_t i = last; i > 0; --i) {
+    body = absl::StrCat("sum(map([s_", i - 1, "], s_", i, " => ", body, "))");
+  }
+  absl::StrAppend(code, "def lambdas(names: Array<String>) : UInt =>\n",
+                  "  sum(map(names, s_0 => ", body, "))\n\n");
+}
+
+void AppendChain(const WorkloadOptions& options, size_t index,
+                 std::string* code) {
+  std::vector<std::string> terms;
+  if (index > 0) {
+    terms.emplace_back(absl::StrCat(ModuleName(options, index - 1),
+                                    ".chain(x)"));
+  } else {
+    terms.emplace_back("x");
+  }
+  if (options.functions_per_module) {
+    terms.emplace_back(
+        absl::StrCat("f_", options.functions_per_module - 1, "(x)"));
+  }
+  if (options.generic_depth) {
+    terms.emplace_back("use_generic_int(x)");
+  }
+  absl::StrAppend(code, "def chain(x: Int) : Int =>\n  ",
+                  absl::StrJoin(terms, " + "), "\n");
+}
+
+}  // namespace
+
+std::vector<WorkloadModule> GenerateWorkload(const WorkloadOptions& options) {
+  std::vector<WorkloadModule> modules;
+  modules.reserve(options.num_modules);
+  for (size_t index = 0; index < options.num_modules; ++index) {
+    std::string code("// Generated nudl workload module.\n\n");
+    if (index > 0) {
+      absl::StrAppend(&code, "import ", ModuleName(options, index - 1),
+                      "\n\n");
+    }
+    AppendSchema(options, &code);
+    AppendFunctions(options, &code);
+    AppendGenerics(options, &code);
+    AppendNested(options, &code);
+    AppendLambdas(options, &code);
+    AppendChain(options, index, &code);
+    modules.emplace_back(
+        WorkloadModule{ModuleName(options, index), std::move(code)});
+  }
+  return modules;
+}
+
+absl::Status WriteWorkload(const std::vector<WorkloadModule>& modules,
+                           absl::string_view output_dir) {
+  const std_filesystem::path dir_path(std::string{output_dir});
+  std::error_code error;
+  std_filesystem::create_directories(dir_path, error);
+  if (error) {
+    return status::InternalErrorBuilder()
+           << "Cannot create workload directory: " << output_dir << ": "
+           << error.message();
+  }
+  for (const auto& module : modules) {
+    const std::string path =
+        (dir_path / absl::StrCat(module.name, kDefaultFileExtension)).string();
+    std::ofstream ofile(path, std::ios::out | std::ios::trunc);
+    if (!ofile.is_open()) {
+      return status::InternalErrorBuilder()
+             << "Cannot open workload module file: " << path;
+    }
+    ofile.write(module.code.data(), module.code.size());
+    ofile.close();
+    if (!ofile.good()) {
+      return status::InternalErrorBuilder()
+             << "Error writing workload module file: " << path;
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace analysis
+}  // namespace nudl
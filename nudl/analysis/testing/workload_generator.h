@@ -0,0 +1,75 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef NUDL_ANALYSIS_TESTING_WORKLOAD_GENERATOR_H__
+#define NUDL_ANALYSIS_TESTING_WORKLOAD_GENERATOR_H__
+
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace nudl {
+namespace analysis {
+
+// Generates synthetic nudl modules, for scale testing the analysis.
+// The generated modules form an import chain: each module imports
+// the previous one, and calls its functions. Each module contains:
+//  - a schema with schema_fields fields, and a function that reads
+//    all of them.
+//  - functions_per_module function groups, f_0 .. f_<n-1>, each with
+//    overloads_per_function overloads, that differ by arity. Each group
+//    calls the previous one.
+//  - a generic function chain, of generic_depth functions, bound
+//    for Int and Float64 arguments.
+//  - a function with a parameter type nested type_depth levels deep.
+//  - a function with lambda_nesting levels of nested lambdas.
+struct WorkloadOptions {
+  // Number of modules in the import chain. At least one.
+  size_t num_modules = 1;
+  // Number of function groups in each module.
+  size_t functions_per_module = 10;
+  // Number of overloads in each function group.
+  size_t overloads_per_function = 1;
+  // Number of fields in the schema of each module.
+  size_t schema_fields = 10;
+  // Nesting levels of the Array parameter type of `nested`.
+  size_t type_depth = 1;
+  // Number of functions in the generic call chain.
+  size_t generic_depth = 1;
+  // Nesting levels of lambdas. Zero for no lambda function.
+  size_t lambda_nesting = 1;
+  // Module names are <module_prefix>_<index>.
+  std::string module_prefix = "workload";
+};
+
+struct WorkloadModule {
+  std::string name;
+  std::string code;
+};
+
+// Returns the modules for the provided options, in import order (i.e.
+// the last module imports, directly or indirectly, all the others).
+std::vector<WorkloadModule> GenerateWorkload(const WorkloadOptions& options);
+
+// Writes the provided modules as .ndl files under output_dir.
+absl::Status WriteWorkload(const std::vector<WorkloadModule>& modules,
+                           absl::string_view output_dir);
+
+}  // namespace analysis
+}  // namespace nudl
+
+#endif  // NUDL_ANALYSIS_TESTING_WORKLOAD_GENERATOR_H__
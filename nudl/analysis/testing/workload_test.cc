@@ -0,0 +1,93 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "nudl/analysis/testing/analysis_test.h"
+#include "nudl/analysis/testing/workload_generator.h"
+#include "nudl/status/status.h"
+#include "nudl/status/testing.h"
+
+namespace nudl {
+namespace analysis {
+
+class WorkloadTest : public AnalysisTest {
+ protected:
+  // Imports the generated workload, returning the last module.
+  absl::StatusOr<Module*> ImportWorkload(const WorkloadOptions& options) {
+    RET_CHECK(options.num_modules >= 1) << "No workload module to import";
+    auto modules = GenerateWorkload(options);
+    EXPECT_EQ(modules.size(), options.num_modules);
+    for (const auto& module : modules) {
+      env()->module_store()->set_module_code(module.name, module.code);
+    }
+    return env()->module_store()->ImportModule(modules.back().name);
+  }
+};
+
+TEST_F(WorkloadTest, DefaultWorkload) {
+  WorkloadOptions options;
+  options.module_prefix = "default_workload";
+  ASSERT_OK_AND_ASSIGN(auto module, ImportWorkload(options));
+  EXPECT_EQ(module->module_name(), "default_workload_0");
+}
+
+TEST_F(WorkloadTest, ImportChainWorkload) {
+  WorkloadOptions options;
+  options.num_modules = 4;
+  options.functions_per_module = 5;
+  options.overloads_per_function = 3;
+  options.schema_fields = 20;
+  options.type_depth = 3;
+  options.generic_depth = 3;
+  options.module_prefix = "chain_workload";
+  ASSERT_OK(ImportWorkload(options).status());
+  for (size_t i = 0; i < options.num_modules; ++i) {
+    EXPECT_TRUE(
+        env()->module_store()->HasModule(absl::StrCat("chain_workload_", i)));
+  }
+}
+
+TEST_F(WorkloadTest, NestedLambdasWorkload) {
+  WorkloadOptions options;
+  options.num_modules = 2;
+  options.lambda_nesting = 4;
+  options.module_prefix = "lambda_workload";
+  const auto modules = GenerateWorkload(options);
+  ASSERT_EQ(modules.size(), options.num_modules);
+  EXPECT_THAT(modules.front().code,
+              testing::HasSubstr("s_3 => len(s_3)"));
+  ASSERT_OK(ImportWorkload(options).status());
+}
+
+TEST_F(WorkloadTest, EmptyWorkload) {
+  WorkloadOptions options;
+  options.num_modules = 2;
+  options.functions_per_module = 0;
+  options.schema_fields = 0;
+  options.type_depth = 0;
+  options.generic_depth = 0;
+  options.lambda_nesting = 0;
+  options.module_prefix = "empty_workload";
+  ASSERT_OK(ImportWorkload(options).status());
+}
+
+}  // namespace analysis
+}  // namespace nudl
+
+int main(int argc, char** argv) {
+  return nudl::analysis::AnalysisTest::Main(argc, argv);
+}
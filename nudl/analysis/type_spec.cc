@@ -16,17 +16,20 @@
 
 #include "nudl/analysis/type_spec.h"
 
+#include <atomic>
 #include <deque>
 #include <utility>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/flags/declare.h"
 #include "absl/flags/flag.h"
+#include "absl/hash/hash.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "glog/logging.h"
 #include "nudl/analysis/function.h"
 #include "nudl/analysis/names.h"
+#include "nudl/analysis/types.h"
 #include "nudl/proto/analysis.pb.h"
 #include "nudl/status/status.h"
 #include "nudl/testing/stacktrace.h"
@@ -137,11 +140,31 @@ std::vector<NameStore*> TypeMemberStore::FindBindingOrder() {
   return result;
 }
 
+namespace {
+absl::variant<int, uint64_t> BindingUid(const TypeBindingArg& binding) {
+  if (std::holds_alternative<const TypeSpec*>(binding)) {
+    return std::get<const TypeSpec*>(binding)->type_uid();
+  }
+  return std::get<int>(binding);
+}
+}  // namespace
+
 std::shared_ptr<TypeMemberStore> TypeMemberStore::AddBinding(
-    absl::string_view signature, const TypeSpec* type_spec) {
+    const std::vector<TypeBindingArg>& bindings, const TypeSpec* type_spec) {
   if (binding_parent_.has_value()) {
-    return binding_parent_.value()->AddBinding(std::move(signature), type_spec);
-  }
+    return binding_parent_.value()->AddBinding(bindings, type_spec);
+  }
+  // A fingerprint match is trusted only for the very same argument types.
+  // Otherwise the binding signature decides, e.g. for equal types built
+  // separately, or on fingerprint collisions.
+  const uint64_t fingerprint = TypeSpec::TypeBindingFingerprint(bindings);
+  auto it_fingerprint = children_by_fingerprint_.find(fingerprint);
+  if (it_fingerprint != children_by_fingerprint_.end() &&
+      it_fingerprint->second->HasBindingUids(bindings)) {
+    it_fingerprint->second->AddMemberType(type_spec);
+    return it_fingerprint->second;
+  }
+  std::string signature = TypeSpec::TypeBindingSignature(bindings);
   auto it = bound_children_.find(signature);
   if (it != bound_children_.end()) {
     it->second->AddMemberType(type_spec);
@@ -149,16 +172,42 @@ std::shared_ptr<TypeMemberStore> TypeMemberStore::AddBinding(
   }
   auto new_child = std::make_shared<TypeMemberStore>(type_spec, ancestor_);
   new_child->SetupBindingParent(signature, this);
-  bound_children_.emplace(signature, new_child);
+  new_child->binding_uids_.reserve(bindings.size());
+  for (const auto& binding : bindings) {
+    new_child->binding_uids_.emplace_back(BindingUid(binding));
+  }
+  bound_children_.emplace(std::move(signature), new_child);
+  children_by_fingerprint_.emplace(fingerprint, new_child);
   return new_child;
 }
 
+bool TypeMemberStore::HasBindingUids(
+    const std::vector<TypeBindingArg>& bindings) const {
+  if (bindings.size() != binding_uids_.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    if (binding_uids_[i] != BindingUid(bindings[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void TypeMemberStore::RemoveBinding(absl::string_view signature) {
   auto it = bound_children_.find(signature);
-  if (it != bound_children_.end()) {
-    it->second->RemoveBindingParent();
-    bound_children_.erase(it);
+  if (it == bound_children_.end()) {
+    return;
+  }
+  for (auto it_fingerprint = children_by_fingerprint_.begin();
+       it_fingerprint != children_by_fingerprint_.end(); ++it_fingerprint) {
+    if (it_fingerprint->second == it->second) {
+      children_by_fingerprint_.erase(it_fingerprint);
+      break;
+    }
   }
+  it->second->RemoveBindingParent();
+  bound_children_.erase(it);
 }
 
 void TypeMemberStore::SetupBindingParent(absl::string_view signature,
@@ -262,6 +311,32 @@ int TypeSpec::NextTypeId() {
   return next_id.fetch_add(1, std::memory_order_relaxed);
 }
 
+namespace {
+
+enum TypeRelation {
+  kRelationAncestor = 0,
+  kRelationEqual = 1,
+  kRelationConvertible = 2,
+};
+
+struct AtomicTypeRelationCacheStats {
+  std::atomic<size_t> hits{0};
+  std::atomic<size_t> misses{0};
+  std::atomic<size_t> dropped{0};
+};
+
+AtomicTypeRelationCacheStats& GlobalTypeRelationCacheStats() {
+  static auto* const stats = new AtomicTypeRelationCacheStats();
+  return *stats;
+}
+
+uint64_t NextTypeUid() {
+  static std::atomic<uint64_t> next_uid{1};
+  return next_uid.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace
+
 TypeSpec::TypeSpec(int type_id, absl::string_view name,
                    std::shared_ptr<TypeMemberStore> type_member_store,
                    bool is_bound_type, const TypeSpec* ancestor,
@@ -269,6 +344,7 @@ TypeSpec::TypeSpec(int type_id, absl::string_view name,
                    absl::optional<const TypeSpec*> original_bind)
     : NamedObject(name),
       type_id_(type_id),
+      type_uid_(NextTypeUid()),
       type_member_store_(std::move(type_member_store)),
       is_bound_type_(is_bound_type),
       ancestor_(ancestor),
@@ -282,10 +358,19 @@ TypeSpec::TypeSpec(int type_id, absl::string_view name,
   }
 }
 
-TypeSpec::~TypeSpec() { type_member_store_->RemoveMemberType(this); }
+void* TypeSpec::operator new(size_t size) { return AnalysisArena::New(size); }
+
+void TypeSpec::operator delete(void* ptr) { AnalysisArena::Delete(ptr); }
+
+TypeSpec::~TypeSpec() {
+  DropCachedRelations();
+  type_member_store_->RemoveMemberType(this);
+}
 
 int TypeSpec::type_id() const { return type_id_; }
 
+uint64_t TypeSpec::type_uid() const { return type_uid_; }
+
 bool TypeSpec::is_bound_type() const { return is_bound_type_; }
 
 const TypeSpec* TypeSpec::ancestor() const { return ancestor_; }
@@ -413,7 +498,85 @@ bool TypeSpec::IsBound() const {
   return true;
 }
 
+TypeRelationCacheStats TypeSpec::relation_cache_stats() {
+  const auto& stats = GlobalTypeRelationCacheStats();
+  TypeRelationCacheStats result;
+  result.hits = stats.hits.load(std::memory_order_relaxed);
+  result.misses = stats.misses.load(std::memory_order_relaxed);
+  result.dropped = stats.dropped.load(std::memory_order_relaxed);
+  return result;
+}
+
+bool TypeSpec::IsRelationCacheable(const TypeSpec& type_spec) const {
+  // The unknown type instance is shared by all environments, which
+  // may be analyzed on different threads, so it caches no relations.
+  if (this == TypeUnknown::Instance() ||
+      &type_spec == TypeUnknown::Instance()) {
+    return false;
+  }
+  // Relations between non-parameterized types are cheap to compute.
+  return !parameters_.empty() || !type_spec.parameters().empty();
+}
+
+bool TypeSpec::CachedRelation(
+    int relation, const TypeSpec& type_spec,
+    bool (TypeSpec::*compute)(const TypeSpec&) const) const {
+  if (!IsRelationCacheable(type_spec)) {
+    return (this->*compute)(type_spec);
+  }
+  auto& stats = GlobalTypeRelationCacheStats();
+  const auto key = std::make_pair(&type_spec, relation);
+  auto it = relations_.find(key);
+  if (it != relations_.end()) {
+    stats.hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second;
+  }
+  stats.misses.fetch_add(1, std::memory_order_relaxed);
+  const bool result = (this->*compute)(type_spec);
+  relations_.emplace(key, result);
+  type_spec.relation_holders_.emplace(this);
+  return result;
+}
+
+void TypeSpec::DropCachedRelations() {
+  size_t num_dropped = relations_.size();
+  for (const auto& it : relations_) {
+    if (it.first.first != this) {
+      it.first.first->relation_holders_.erase(this);
+    }
+  }
+  for (const TypeSpec* holder : relation_holders_) {
+    if (holder == this) {
+      continue;
+    }
+    for (int relation :
+         {kRelationAncestor, kRelationEqual, kRelationConvertible}) {
+      num_dropped += holder->relations_.erase(std::make_pair(this, relation));
+    }
+  }
+  relations_.clear();
+  relation_holders_.clear();
+  if (num_dropped) {
+    GlobalTypeRelationCacheStats().dropped.fetch_add(
+        num_dropped, std::memory_order_relaxed);
+  }
+}
+
 bool TypeSpec::IsAncestorOf(const TypeSpec& type_spec) const {
+  return CachedRelation(kRelationAncestor, type_spec,
+                        &TypeSpec::ComputeIsAncestorOf);
+}
+
+bool TypeSpec::IsEqual(const TypeSpec& type_spec) const {
+  return CachedRelation(kRelationEqual, type_spec, &TypeSpec::ComputeIsEqual);
+}
+
+bool TypeSpec::IsConvertibleFrom(const TypeSpec& type_spec) const {
+  return CachedRelation(kRelationConvertible, type_spec,
+                        &TypeSpec::ComputeIsConvertibleFrom);
+}
+
+bool TypeSpec::ComputeIsAncestorOf(const TypeSpec& type_spec) const {
   const TypeSpec* crt_type_spec = &type_spec;
   while (crt_type_spec) {
     if (type_id_ == crt_type_spec->type_id()) {
@@ -442,7 +605,7 @@ bool TypeSpec::HasAncestorParameters(const TypeSpec& type_spec) const {
   return true;
 }
 
-bool TypeSpec::IsEqual(const TypeSpec& type_spec) const {
+bool TypeSpec::ComputeIsEqual(const TypeSpec& type_spec) const {
   if (type_id_ != type_spec.type_id() ||
       parameters_.size() != type_spec.parameters().size()) {
     return false;
@@ -455,7 +618,7 @@ bool TypeSpec::IsEqual(const TypeSpec& type_spec) const {
   return true;
 }
 
-bool TypeSpec::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeSpec::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   const TypeSpec* crt_type_spec = &type_spec;
   while (crt_type_spec) {
     if (type_id_ == crt_type_spec->type_id()) {
@@ -542,8 +705,7 @@ absl::Status TypeSpec::UpdateBindingStore(
   if (!num_non_any) {
     return absl::OkStatus();
   }
-  std::string signature = TypeBindingSignature(bindings);
-  auto bound_store = type_member_store_->AddBinding(signature, this);
+  auto bound_store = type_member_store_->AddBinding(bindings, this);
   type_member_store_->RemoveMemberType(this);
   type_member_store_ = std::move(bound_store);
   return absl::OkStatus();
@@ -599,6 +761,67 @@ std::string TypeSpec::TypeBindingSignature(
   return TypeBindingSignatureJoin(components);
 }
 
+uint64_t TypeSpec::TypeFingerprint() const { return ComputeTypeFingerprint(); }
+
+uint64_t TypeSpec::ComputeTypeFingerprint() const {
+  // Follows TypeSignature: the name, and the parameters' fingerprints.
+  uint64_t fingerprint = absl::HashOf(name(), parameters_.size());
+  for (const auto param : parameters_) {
+    fingerprint = absl::HashOf(fingerprint, param->TypeFingerprint());
+  }
+  return fingerprint;
+}
+
+bool TypeSpec::HasSameSignature(const TypeSpec& type_spec) const {
+  if (this == &type_spec) {
+    return true;
+  }
+  // The types that specialize TypeSignature decide.
+  if (type_spec.type_id() == pb::TypeId::STRUCT_ID ||
+      type_spec.type_id() == pb::TypeId::NULLABLE_ID) {
+    return type_spec.ComputeHasSameSignature(*this);
+  }
+  return ComputeHasSameSignature(type_spec);
+}
+
+bool TypeSpec::ComputeHasSameSignature(const TypeSpec& type_spec) const {
+  // Follows TypeSignature: the name, and the parameters' signatures.
+  if (name() != type_spec.name() ||
+      parameters_.size() != type_spec.parameters().size()) {
+    return false;
+  }
+  for (size_t i = 0; i < parameters_.size(); ++i) {
+    if (!parameters_[i]->HasSameSignature(*type_spec.parameters()[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t TypeSpec::TypeBindingFingerprint(
+    const absl::Span<const TypeSpec* const> type_arguments) {
+  uint64_t fingerprint = absl::HashOf(type_arguments.size());
+  for (const auto& ta : type_arguments) {
+    fingerprint = absl::HashOf(fingerprint, ta->TypeFingerprint());
+  }
+  return fingerprint;
+}
+
+uint64_t TypeSpec::TypeBindingFingerprint(
+    const std::vector<TypeBindingArg>& type_arguments) {
+  uint64_t fingerprint = absl::HashOf(type_arguments.size());
+  for (const auto& ta : type_arguments) {
+    if (std::holds_alternative<const TypeSpec*>(ta)) {
+      fingerprint = absl::HashOf(
+          fingerprint, std::get<const TypeSpec*>(ta)->TypeFingerprint());
+    } else {
+      // Tagged, not to collide with the type fingerprints.
+      fingerprint = absl::HashOf(fingerprint, 'i', std::get<int>(ta));
+    }
+  }
+  return fingerprint;
+}
+
 absl::StatusOr<std::vector<const TypeSpec*>> TypeSpec::TypesFromBindings(
     const std::vector<TypeBindingArg>& bindings, bool check_params,
     absl::optional<size_t> minimum_parameters) const {
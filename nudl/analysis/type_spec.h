@@ -20,12 +20,14 @@
 #include <memory>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/status/statusor.h"
 #include "absl/types/variant.h"
+#include "nudl/analysis/arena.h"
 #include "nudl/analysis/named_object.h"
 
 namespace nudl {
@@ -34,6 +36,16 @@ namespace analysis {
 class TypeSpec;
 using TypeBindingArg = absl::variant<int, const TypeSpec*>;
 
+// Process-wide counters for the caches of type relations (ancestry,
+// equality, convertibility) between parameterized types.
+struct TypeRelationCacheStats {
+  // Relations found already computed / that needed to be computed.
+  size_t hits = 0;
+  size_t misses = 0;
+  // Cached relations dropped upon the destruction of one of their types.
+  size_t dropped = 0;
+};
+
 // The normal name store that can be used with types to hold
 // fields and member functions:
 class TypeMemberStore : public BaseNameStore {
@@ -75,15 +87,15 @@ class TypeMemberStore : public BaseNameStore {
   absl::optional<TypeMemberStore*> binding_parent() const;
   // The signature under which this type is bound to
   const std::string& binding_signature() const;
-  // The children bindings of this store. E.g. for Array<Any> this would contain
-  // the stores of Array<Int> etc.
+  // The children bindings of this store, by their binding signature.
+  // E.g. for Array<Any> this would contain the stores of Array<Int> etc.
   const absl::flat_hash_map<std::string, std::shared_ptr<TypeMemberStore>>&
   bound_children() const;
 
-  // Adds a child binding, under a type signature.
-  std::shared_ptr<TypeMemberStore> AddBinding(absl::string_view signature,
-                                              const TypeSpec* type_spec);
-  // Removes the child binding for the signature.
+  // Adds a child binding, for the provided binding arguments.
+  std::shared_ptr<TypeMemberStore> AddBinding(
+      const std::vector<TypeBindingArg>& bindings, const TypeSpec* type_spec);
+  // Removes the child binding with the provided binding signature.
   void RemoveBinding(absl::string_view signature);
   // Sets up the binding_parent, which we are register to under provided
   // signature.
@@ -105,10 +117,23 @@ class TypeMemberStore : public BaseNameStore {
 
   absl::optional<const TypeSpec*> type_spec_;
   std::shared_ptr<NameStore> const ancestor_;
+  // If the binding arguments are the very same types (or integers)
+  // that this child binding was created with.
+  bool HasBindingUids(const std::vector<TypeBindingArg>& bindings) const;
+
   absl::optional<TypeMemberStore*> binding_parent_;
   std::string binding_signature_;
+  // The binding arguments of this child binding, as the type_uid of the
+  // types, or the integer arguments. Unlike the types, the uids are never
+  // reused, so they can be compared after the types are destroyed.
+  std::vector<absl::variant<int, uint64_t>> binding_uids_;
   absl::flat_hash_map<std::string, std::shared_ptr<TypeMemberStore>>
       bound_children_;
+  // Index of bound_children_ by the fingerprint of their bindings, for
+  // looking up the binding of the same argument types without building
+  // their signature.
+  absl::flat_hash_map<uint64_t, std::shared_ptr<TypeMemberStore>>
+      children_by_fingerprint_;
   absl::flat_hash_set<const TypeSpec*> member_types_;
 };
 
@@ -131,8 +156,14 @@ class TypeSpec : public NamedObject {
            absl::optional<const TypeSpec*> original_bind = {});
   ~TypeSpec() override;
 
+  // Types are allocated in the active AnalysisArena, if any.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
   // The unique identifier of this type.
   int type_id() const;
+  // Identifies this type instance. Unlike the address, it is never reused.
+  uint64_t type_uid() const;
   // If the type in itself is bound.
   bool is_bound_type() const;
   // Base type(s) for this.
@@ -170,11 +201,16 @@ class TypeSpec : public NamedObject {
   // Full type specification.
   std::string full_name() const override;
   // If this type is an ancestor (maybe not direct) of type_spec.
-  virtual bool IsAncestorOf(const TypeSpec& type_spec) const;
+  bool IsAncestorOf(const TypeSpec& type_spec) const;
   // If the type_spec and this type are the same.
-  virtual bool IsEqual(const TypeSpec& type_spec) const;
+  bool IsEqual(const TypeSpec& type_spec) const;
   // If this type can be converted from type_spec
-  virtual bool IsConvertibleFrom(const TypeSpec& type_spec) const;
+  bool IsConvertibleFrom(const TypeSpec& type_spec) const;
+  // The relations above are memoized in this type when either of the
+  // types is parameterized, as the relevant type structure is immutable
+  // after construction. The memoized relations are dropped when either
+  // type is destroyed.
+  static TypeRelationCacheStats relation_cache_stats();
 
   // TODO(catalin): convert all these to optional<...>
 
@@ -221,6 +257,22 @@ class TypeSpec : public NamedObject {
   static std::string TypeBindingSignature(
       const absl::Span<const TypeSpec* const> type_arguments);
 
+  // Returns a structural hash that distinguishes types as TypeSignature
+  // does, without building the string. Computed on each call, as the
+  // names of the parameter types can still change after construction.
+  // Equal fingerprints do not guarantee equal signatures.
+  uint64_t TypeFingerprint() const;
+  // If this type has the same TypeSignature as type_spec. Compares the
+  // type structure, building the signatures only for the types that
+  // specialize TypeSignature.
+  bool HasSameSignature(const TypeSpec& type_spec) const;
+  // Returns the hash of a type binding, corresponding to
+  // TypeBindingSignature, for looking up existing bindings.
+  static uint64_t TypeBindingFingerprint(
+      const std::vector<TypeBindingArg>& type_arguments);
+  static uint64_t TypeBindingFingerprint(
+      const absl::Span<const TypeSpec* const> type_arguments);
+
   // Next functions are meant to be used internally:
 
   // Sets the name of a type - this can be done only once.
@@ -251,6 +303,18 @@ class TypeSpec : public NamedObject {
   // (i.e. origina_bind in the type_spec is this)
   bool IsGeneratedByThis(const TypeSpec& type_spec) const;
 
+  // Computations of the IsAncestorOf, IsEqual and IsConvertibleFrom
+  // relations, to be specialized by subclasses.
+  virtual bool ComputeIsAncestorOf(const TypeSpec& type_spec) const;
+  virtual bool ComputeIsEqual(const TypeSpec& type_spec) const;
+  virtual bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const;
+  // Computes the TypeFingerprint - to be specialized together with
+  // TypeSignature.
+  virtual uint64_t ComputeTypeFingerprint() const;
+  // Computes HasSameSignature - to be specialized together with
+  // TypeSignature.
+  virtual bool ComputeHasSameSignature(const TypeSpec& type_spec) const;
+
   // Checks parameters of this and type_spec for ancestry.
   bool HasAncestorParameters(const TypeSpec& type_spec) const;
   // Checks parameters of this and type_spec for convertible.
@@ -262,7 +326,19 @@ class TypeSpec : public NamedObject {
   std::string wrap_local_name(std::string s) const;
 
   static int NextTypeId();
+  // If the relation of this with type_spec is worth caching.
+  bool IsRelationCacheable(const TypeSpec& type_spec) const;
+  // Returns the cached relation of kind relation between this and
+  // type_spec, computing it with compute on a miss.
+  bool CachedRelation(int relation, const TypeSpec& type_spec,
+                      bool (TypeSpec::*compute)(const TypeSpec&) const) const;
+  // Drops the relations cached in this type, or in other types about
+  // this type.
+  void DropCachedRelations();
+
   const int type_id_;  // pb::TypeId values reserved for builtins.
+  // Identifies this type instance. Unlike the address, it is never reused.
+  const uint64_t type_uid_;
   std::shared_ptr<TypeMemberStore> type_member_store_;
   const bool is_bound_type_;
   bool is_name_set_ = false;
@@ -273,6 +349,12 @@ class TypeSpec : public NamedObject {
   std::vector<const TypeSpec*> parameters_;
   absl::optional<const TypeSpec*> original_bind_;
   absl::optional<ScopeName> scope_name_;
+  // Relations computed with other types: maps the other type and the
+  // relation kind to the relation value.
+  mutable absl::flat_hash_map<std::pair<const TypeSpec*, int>, bool>
+      relations_;
+  // Types that cached relations with this type in their relations_.
+  mutable absl::flat_hash_set<const TypeSpec*> relation_holders_;
 };
 
 // Class helper for rebinding types. The concept here is that one would
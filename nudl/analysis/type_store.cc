@@ -17,7 +17,10 @@
 #include "nudl/analysis/type_store.h"
 
 #include <utility>
+#include <vector>
 
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "glog/logging.h"
 #include "nudl/analysis/type_utils.h"
 #include "nudl/grammar/dsl.h"
@@ -26,6 +29,14 @@
 namespace nudl {
 namespace analysis {
 
+const TypeSpec* TypeStore::LookupTypeByName(absl::string_view name) const {
+  auto result = FindTypeByName(name);
+  return result.ok() ? result.value() : nullptr;
+}
+
+void TypeStore::ReleaseModuleTypes(
+    const absl::flat_hash_set<std::string>& module_names) {}
+
 GlobalTypeStore::GlobalTypeStore(std::unique_ptr<TypeStore> base_store)
     : TypeStore() {
   if (base_store) {
@@ -97,6 +108,112 @@ absl::StatusOr<const TypeSpec*> GlobalTypeStore::FindTypeByName(
   return base_store_->FindTypeByName(name);
 }
 
+const TypeSpec* GlobalTypeStore::LookupType(const ScopeName& lookup_scope,
+                                            const ScopedName& type_name) const {
+  // Same lookup order as FindType, for a type specification with no
+  // arguments, which is not a local type.
+  for (size_t i = lookup_scope.size() + 1; i > 0; --i) {
+    const ScopeName crt_name(
+        lookup_scope.PrefixScopeName(i - 1).Subscope(type_name.scope_name()));
+    auto store = FindStore(crt_name.name());
+    if (store.has_value()) {
+      if (const TypeSpec* spec =
+              store.value()->LookupTypeByName(type_name.name())) {
+        return spec;
+      }
+    }
+  }
+  if (type_name.scope_name().empty()) {
+    return base_store_->LookupTypeByName(type_name.name());
+  }
+  return nullptr;
+}
+
+namespace {
+// Collects the names referred in a type specification, returning true
+// if any local type is declared in it.
+bool CollectReferredNames(const pb::TypeSpec& type_spec,
+                          std::vector<std::string>* names) {
+  bool has_local_types = type_spec.is_local_type();
+  if (!type_spec.identifier().name().empty()) {
+    names->emplace_back(*type_spec.identifier().name().rbegin());
+  }
+  for (const auto& argument : type_spec.argument()) {
+    if (argument.has_type_spec()) {
+      has_local_types |= CollectReferredNames(argument.type_spec(), names);
+    }
+  }
+  return has_local_types;
+}
+}  // namespace
+
+absl::StatusOr<const TypeSpec*> GlobalTypeStore::FindTypeFromString(
+    const ScopeName& lookup_scope, absl::string_view type_name) {
+  auto scope_it = found_names_.find(lookup_scope.name());
+  if (scope_it != found_names_.end()) {
+    auto found_it = scope_it->second.find(type_name);
+    if (found_it != scope_it->second.end()) {
+      ++name_cache_stats_.find_hits;
+      return found_it->second;
+    }
+  }
+  ++name_cache_stats_.find_misses;
+  auto parsed_it = parsed_names_.find(type_name);
+  if (parsed_it != parsed_names_.end()) {
+    ++name_cache_stats_.parse_hits;
+  } else {
+    ++name_cache_stats_.parse_misses;
+    ASSIGN_OR_RETURN(auto type_spec, grammar::ParseTypeSpec(type_name),
+                     _ << "For type_name: `" << type_name << "`");
+    ParsedTypeName parsed_name;
+    parsed_name.has_local_types =
+        CollectReferredNames(*type_spec, &parsed_name.referred_names);
+    parsed_name.type_spec = std::move(type_spec);
+    parsed_it =
+        parsed_names_.emplace(std::string(type_name), std::move(parsed_name))
+            .first;
+  }
+  // Note: FindType may declare types, so don't keep references to
+  // the found_names_ iterators across this call.
+  ASSIGN_OR_RETURN(auto result,
+                   FindType(lookup_scope, *parsed_it->second.type_spec));
+  if (!parsed_it->second.has_local_types) {
+    found_names_[lookup_scope.name()].emplace(std::string(type_name), result);
+    for (const auto& name : parsed_it->second.referred_names) {
+      found_names_index_[name].emplace_back(lookup_scope.name(),
+                                            std::string(type_name));
+    }
+  }
+  return result;
+}
+
+void GlobalTypeStore::InvalidateNameCache(absl::string_view name) {
+  auto it = found_names_index_.find(name);
+  if (it == found_names_index_.end()) {
+    return;
+  }
+  for (const auto& key : it->second) {
+    auto scope_it = found_names_.find(key.first);
+    if (scope_it != found_names_.end()) {
+      name_cache_stats_.invalidations += scope_it->second.erase(key.second);
+    }
+  }
+  found_names_index_.erase(it);
+}
+
+const TypeNameCacheStats& GlobalTypeStore::name_cache_stats() const {
+  return name_cache_stats_;
+}
+
+BoundTypeStats GlobalTypeStore::bound_type_stats() const {
+  BoundTypeStats stats;
+  for (const auto& store : scopes_store_) {
+    stats.hits += store->bound_type_stats().hits;
+    stats.misses += store->bound_type_stats().misses;
+  }
+  return stats;
+}
+
 absl::Status GlobalTypeStore::AddScope(std::shared_ptr<ScopeName> scope_name) {
   if (scopes_.contains(scope_name->name())) {
     return status::AlreadyExistsErrorBuilder()
@@ -122,9 +239,64 @@ absl::Status GlobalTypeStore::AddAlias(const ScopeName& scope_name,
            << " for adding an alias to it";
   }
   scopes_.emplace(alias_name.name(), it->second);
+  // An alias may shadow types found under shorter scope prefixes.
+  found_names_.clear();
+  found_names_index_.clear();
   return absl::OkStatus();
 }
 
+void GlobalTypeStore::RemoveModuleScopes(absl::string_view module_name) {
+  const std::string function_prefix(absl::StrCat(module_name, "::"));
+  const std::string module_prefix(absl::StrCat(module_name, "."));
+  auto is_module_scope = [module_name,
+                          &function_prefix](absl::string_view name) {
+    return name == module_name || absl::StartsWith(name, function_prefix);
+  };
+  std::vector<std::string> removed;
+  for (const auto& it : scopes_) {
+    const std::string& store_name = it.second->scope_name().name();
+    if (is_module_scope(it.first) || is_module_scope(store_name) ||
+        (it.first != store_name && absl::StartsWith(it.first, module_prefix))) {
+      removed.emplace_back(it.first);
+    }
+  }
+  for (const auto& name : removed) {
+    scopes_.erase(name);
+  }
+  found_names_.clear();
+  found_names_index_.clear();
+}
+
+void GlobalTypeStore::ReleaseModuleTypes(
+    const absl::flat_hash_set<std::string>& module_names) {
+  absl::flat_hash_set<const ScopeTypeStore*> registered;
+  for (const auto& it : scopes_) {
+    registered.emplace(it.second);
+  }
+  std::vector<std::unique_ptr<ScopeTypeStore>> released;
+  std::vector<std::unique_ptr<ScopeTypeStore>> kept;
+  for (auto& store : scopes_store_) {
+    const ScopeName& store_scope = store->scope_name();
+    if (!registered.contains(store.get()) && !store_scope.empty() &&
+        module_names.contains(store_scope.module_name())) {
+      released.emplace_back(std::move(store));
+    } else {
+      kept.emplace_back(std::move(store));
+    }
+  }
+  scopes_store_ = std::move(kept);
+  // The released stores are destroyed last, as the bound types
+  // are checked against their types.
+  for (const auto& store : scopes_store_) {
+    store->ReleaseModuleTypes(module_names);
+  }
+  if (base_store_) {
+    base_store_->ReleaseModuleTypes(module_names);
+  }
+  found_names_.clear();
+  found_names_index_.clear();
+}
+
 absl::StatusOr<const TypeSpec*> GlobalTypeStore::DeclareType(
     const ScopeName& scope_name, absl::string_view name,
     std::unique_ptr<TypeSpec> type_spec) {
@@ -172,6 +344,34 @@ const ScopeName& ScopeTypeStore::scope_name() const { return *scope_name_; }
 
 TypeStore* ScopeTypeStore::GlobalStore() { return global_store_; }
 
+const BoundTypeStats& ScopeTypeStore::bound_type_stats() const {
+  return bound_type_stats_;
+}
+
+void ScopeTypeStore::ReleaseModuleTypes(
+    const absl::flat_hash_set<std::string>& module_names) {
+  absl::flat_hash_set<const TypeSpec*> released;
+  std::vector<std::unique_ptr<TypeSpec>> kept;
+  for (auto& bound_type : bound_types_) {
+    if (TypeUtils::UsesModuleTypes(bound_type.get(), module_names)) {
+      released.emplace(bound_type.get());
+    } else {
+      kept.emplace_back(std::move(bound_type));
+    }
+  }
+  if (released.empty()) {
+    return;
+  }
+  for (auto it = canonical_types_.begin(); it != canonical_types_.end();) {
+    if (released.contains(it->second)) {
+      canonical_types_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  bound_types_ = std::move(kept);
+}
+
 bool ScopeTypeStore::HasType(absl::string_view type_name) const {
   return types_.contains(type_name);
 }
@@ -203,29 +403,47 @@ absl::StatusOr<const TypeSpec*> ScopeTypeStore::FindType(
     return spec;
   }
   std::vector<TypeBindingArg> bind_arguments;
-  for (auto argument : type_spec.argument()) {
+  // Bound types are identified by their base type, lookup scope (which
+  // is set in the built type), and argument values. As the argument types
+  // are canonical themselves, their addresses identify them.
+  BoundTypeKey key(spec, lookup_scope.id(), {});
+  auto& key_arguments = std::get<2>(key);
+  for (const auto& argument : type_spec.argument()) {
     if (argument.has_int_value()) {
       bind_arguments.emplace_back(
           TypeBindingArg(static_cast<int>(argument.int_value())));
+      key_arguments.emplace_back(nullptr, argument.int_value());
     } else if (argument.has_type_spec()) {
       ASSIGN_OR_RETURN(
           auto subtype,
           global_store_->FindType(lookup_scope, argument.type_spec()),
           _ << "Finding subtype `" << grammar::ToDsl(argument.type_spec()));
-      bind_arguments.emplace_back(TypeBindingArg(std::move(subtype)));
+      bind_arguments.emplace_back(TypeBindingArg(subtype));
+      key_arguments.emplace_back(subtype, 0);
     }
   }
+  auto canonical_it = canonical_types_.find(key);
+  if (canonical_it != canonical_types_.end()) {
+    ++bound_type_stats_.hits;
+    return canonical_it->second;
+  }
+  ++bound_type_stats_.misses;
+  // The canonical types are shared by all modules, so they are allocated
+  // on the heap, not to keep the arena of the requesting module alive.
+  AnalysisArena::Activation heap_activation(nullptr);
   ASSIGN_OR_RETURN(auto bound_type, spec->Build(bind_arguments),
                    _ << "Binding type: " << spec->name());
   bound_type->set_scope_name(lookup_scope);
   bound_types_.emplace_back(std::move(bound_type));
-  return bound_types_.back().get();
+  const TypeSpec* result = bound_types_.back().get();
+  canonical_types_.emplace(std::move(key), result);
+  return result;
 }
 
 absl::StatusOr<const TypeSpec*> ScopeTypeStore::FindTypeLocal(
     const ScopeName& lookup_scope, const pb::TypeSpec& type_spec) {
   RET_CHECK(type_spec.is_local_type());
-  RET_CHECK(lookup_scope.name() == scope_name_->name())
+  RET_CHECK(lookup_scope == *scope_name_)
       << "Declaring local type in a wrong scope: " << lookup_scope.name()
       << " vs. " << scope_name_->name();
   ASSIGN_OR_RETURN(const std::string module_name,
@@ -292,6 +510,15 @@ absl::StatusOr<const TypeSpec*> ScopeTypeStore::FindTypeByName(
   return type_it->second.get();
 }
 
+const TypeSpec* ScopeTypeStore::LookupTypeByName(
+    absl::string_view name) const {
+  auto type_it = types_.find(name);
+  if (type_it == types_.end()) {
+    return nullptr;
+  }
+  return type_it->second.get();
+}
+
 absl::StatusOr<const TypeSpec*> ScopeTypeStore::DeclareType(
     const ScopeName& scope_name, absl::string_view name,
     std::unique_ptr<TypeSpec> type_spec) {
@@ -309,6 +536,7 @@ absl::StatusOr<const TypeSpec*> ScopeTypeStore::DeclareType(
   TypeSpec* added_type = types_.emplace(std::string(name), std::move(type_spec))
                              .first->second.get();
   if (global_store_) {
+    global_store_->InvalidateNameCache(name);
     RETURN_IF_ERROR(
         global_store_->CallRegistrationCallback(*scope_name_, added_type));
   }
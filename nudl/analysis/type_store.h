@@ -19,9 +19,13 @@
 
 #include <memory>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/inlined_vector.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
@@ -46,6 +50,10 @@ class TypeStore {
   virtual absl::StatusOr<const TypeSpec*> FindTypeByName(
       absl::string_view name) const = 0;
 
+  // Same as FindTypeByName, but returns null when the type is not found,
+  // without building an error.
+  virtual const TypeSpec* LookupTypeByName(absl::string_view name) const;
+
   // Adds a new type to the store in provided scope.
   virtual absl::StatusOr<const TypeSpec*> DeclareType(
       const ScopeName& scope_name, absl::string_view name,
@@ -59,10 +67,35 @@ class TypeStore {
 
   // Return the top global store.
   virtual TypeStore* GlobalStore() = 0;
+
+  // Destroys the types defined in, or bound in the provided modules,
+  // which are released. By default there is nothing to release.
+  virtual void ReleaseModuleTypes(
+      const absl::flat_hash_set<std::string>& module_names);
 };
 
 class ScopeTypeStore;
 
+// Counters for the type name cache maintained by GlobalTypeStore.
+struct TypeNameCacheStats {
+  // Type names found already parsed / that needed to be parsed.
+  size_t parse_hits = 0;
+  size_t parse_misses = 0;
+  // Types found already resolved in the lookup scope / that needed
+  // to be looked up in the store.
+  size_t find_hits = 0;
+  size_t find_misses = 0;
+  // Number of resolved types dropped upon type declarations.
+  size_t invalidations = 0;
+};
+
+// Counters for the canonical bound types kept by the scope type stores.
+struct BoundTypeStats {
+  // Bound types found already built / that needed to be built.
+  size_t hits = 0;
+  size_t misses = 0;
+};
+
 class GlobalTypeStore : public TypeStore {
  public:
   explicit GlobalTypeStore(std::unique_ptr<TypeStore> base_store = nullptr);
@@ -75,15 +108,41 @@ class GlobalTypeStore : public TypeStore {
       const ScopeName& scope_name, absl::string_view name,
       std::unique_ptr<TypeSpec> type_spec) override;
 
+  // Probes for the plain (unbound) type named type_name, as looked up
+  // from lookup_scope. Returns null if not found, without building
+  // an error, for name lookups that fall back to types.
+  const TypeSpec* LookupType(const ScopeName& lookup_scope,
+                             const ScopedName& type_name) const;
+
   absl::Status AddScope(std::shared_ptr<ScopeName> scope_name);
   absl::Status AddAlias(const ScopeName& scope_name,
                         const ScopeName& alias_name);
+  // Unregisters the type scopes of the module named module_name: the
+  // module scope, its function scopes, the aliases to these, and the
+  // aliases defined in the module. The types are kept alive, until
+  // ReleaseModuleTypes, as they may still be referred by the module.
+  void RemoveModuleScopes(absl::string_view module_name);
+  // Destroys the type scopes of the provided modules, which were removed
+  // with RemoveModuleScopes, and the bound types that refer them.
+  void ReleaseModuleTypes(
+      const absl::flat_hash_set<std::string>& module_names) override;
   absl::optional<ScopeTypeStore*> FindStore(absl::string_view name) const;
   TypeStore* GlobalStore() override;
 
   const TypeStore& base_store() const;
   TypeStore* mutable_base_store();
 
+  // Parses the provided type name and finds the corresponding type, as
+  // looked up from lookup_scope. The parsed specification and the found
+  // type are cached, until a type referenced in type_name is declared.
+  absl::StatusOr<const TypeSpec*> FindTypeFromString(
+      const ScopeName& lookup_scope, absl::string_view type_name);
+  // Drops the cached types which refer the provided type name.
+  void InvalidateNameCache(absl::string_view name);
+  const TypeNameCacheStats& name_cache_stats() const;
+  // Aggregates the bound type counters of all scope stores.
+  BoundTypeStats bound_type_stats() const;
+
   std::string DebugNames() const override;
   const ScopeName& scope_name() const override;
 
@@ -99,6 +158,27 @@ class GlobalTypeStore : public TypeStore {
   std::vector<std::unique_ptr<ScopeTypeStore>> scopes_store_;
   absl::flat_hash_map<std::string, ScopeTypeStore*> scopes_;
   absl::flat_hash_map<std::string, RegistrationCallback> callbacks_;
+
+  // Type names parsed by FindTypeFromString.
+  struct ParsedTypeName {
+    std::unique_ptr<pb::TypeSpec> type_spec;
+    // All the type names referred in type_spec.
+    std::vector<std::string> referred_names;
+    // Types with local names declare types when found, so we don't
+    // cache the found result for them.
+    bool has_local_types = false;
+  };
+  absl::flat_hash_map<std::string, ParsedTypeName> parsed_names_;
+  // Maps from lookup scope name to type name to found type.
+  absl::flat_hash_map<std::string,
+                      absl::flat_hash_map<std::string, const TypeSpec*>>
+      found_names_;
+  // Maps from referred type name to the keys in found_names_
+  // which need to be dropped when a type with that name is declared.
+  absl::flat_hash_map<std::string,
+                      std::vector<std::pair<std::string, std::string>>>
+      found_names_index_;
+  TypeNameCacheStats name_cache_stats_;
 };
 
 class ScopeTypeStore : public TypeStore {
@@ -110,15 +190,20 @@ class ScopeTypeStore : public TypeStore {
       const ScopeName& lookup_scope, const pb::TypeSpec& type_spec) override;
   absl::StatusOr<const TypeSpec*> FindTypeByName(
       absl::string_view name) const override;
+  const TypeSpec* LookupTypeByName(absl::string_view name) const override;
   absl::StatusOr<const TypeSpec*> DeclareType(
       const ScopeName& scope_name, absl::string_view name,
       std::unique_ptr<TypeSpec> type_spec) override;
   TypeStore* GlobalStore() override;
+  // Destroys the bound types that refer the provided modules.
+  void ReleaseModuleTypes(
+      const absl::flat_hash_set<std::string>& module_names) override;
 
   bool HasType(absl::string_view type_name) const;
   const ScopeName& scope_name() const override;
 
   std::string DebugNames() const override;
+  const BoundTypeStats& bound_type_stats() const;
 
  protected:
   // Used by FindTypeByName to lookup local types / defines.
@@ -132,6 +217,16 @@ class ScopeTypeStore : public TypeStore {
 
   absl::flat_hash_map<std::string, std::unique_ptr<TypeSpec>> types_;
   std::vector<std::unique_ptr<TypeSpec>> bound_types_;
+  // Key of canonical_types_: the base type, the id of the lookup scope,
+  // and for each binding argument, its type, or null and its int value.
+  using BoundTypeKey = std::tuple<
+      const TypeSpec*, size_t,
+      absl::InlinedVector<std::pair<const TypeSpec*, int64_t>, 4>>;
+  // Canonical instances in bound_types_, keyed by the base type, lookup
+  // scope and binding arguments. Argument types are themselves canonical,
+  // so structurally equal bindings (e.g. Array<Int>) are built only once.
+  absl::flat_hash_map<BoundTypeKey, const TypeSpec*> canonical_types_;
+  BoundTypeStats bound_type_stats_;
 };
 
 }  // namespace analysis
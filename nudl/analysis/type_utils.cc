@@ -21,6 +21,7 @@
 #include "absl/flags/declare.h"
 #include "absl/flags/flag.h"
 #include "absl/strings/str_join.h"
+#include "nudl/analysis/function.h"
 #include "nudl/analysis/types.h"
 #include "nudl/status/status.h"
 #include "nudl/testing/stacktrace.h"
@@ -424,5 +425,34 @@ void BaseTypesStore::CreateBaseTypes() {
                .status());
 }
 
+namespace {
+bool IsModuleScopeName(const ScopeName& scope_name,
+                       const absl::flat_hash_set<std::string>& module_names) {
+  return !scope_name.empty() && module_names.contains(scope_name.module_name());
+}
+}  // namespace
+
+bool TypeUtils::UsesModuleTypes(
+    const TypeSpec* type_spec,
+    const absl::flat_hash_set<std::string>& module_names) {
+  if (IsModuleScopeName(type_spec->scope_name(), module_names)) {
+    return true;
+  }
+  if (type_spec->type_id() == pb::TypeId::FUNCTION_ID) {
+    for (const Function* instance :
+         static_cast<const TypeFunction*>(type_spec)->function_instances()) {
+      if (IsModuleScopeName(instance->scope_name(), module_names)) {
+        return true;
+      }
+    }
+  }
+  for (const TypeSpec* parameter : type_spec->parameters()) {
+    if (UsesModuleTypes(CHECK_NOTNULL(parameter), module_names)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace analysis
 }  // namespace nudl
@@ -139,6 +139,12 @@ class TypeUtils {
                                                 const TypeSpec* type_spec);
   // Checks if the provided type is a function, or it is bound.
   static absl::Status CheckFunctionTypeIsBound(const TypeSpec* type_spec);
+
+  // If the type, or any of its parameters, is defined or bound in one of
+  // the provided modules, or is a function type of functions defined there.
+  static bool UsesModuleTypes(
+      const TypeSpec* type_spec,
+      const absl::flat_hash_set<std::string>& module_names);
 };
 
 }  // namespace analysis
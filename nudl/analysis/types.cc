@@ -25,6 +25,7 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/flags/declare.h"
 #include "absl/flags/flag.h"
+#include "absl/hash/hash.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "glog/logging.h"
@@ -157,7 +158,7 @@ TypeInt::TypeInt(TypeStore* type_store,
 std::unique_ptr<TypeSpec> TypeInt::Clone() const {
   return CloneType<TypeInt>();
 }
-bool TypeInt::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeInt::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return TypeUtils::IsIntType(type_spec);
 }
 absl::StatusOr<pb::Expression> TypeInt::DefaultValueExpression(
@@ -175,7 +176,7 @@ TypeInt8::TypeInt8(TypeStore* type_store,
 std::unique_ptr<TypeSpec> TypeInt8::Clone() const {
   return CloneType<TypeInt8>();
 }
-bool TypeInt8::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeInt8::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return TypeUtils::IsIntType(type_spec);
 }
 
@@ -187,7 +188,7 @@ TypeInt16::TypeInt16(TypeStore* type_store,
 std::unique_ptr<TypeSpec> TypeInt16::Clone() const {
   return CloneType<TypeInt16>();
 }
-bool TypeInt16::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeInt16::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return TypeUtils::IsIntType(type_spec);
 }
 
@@ -199,7 +200,7 @@ TypeInt32::TypeInt32(TypeStore* type_store,
 std::unique_ptr<TypeSpec> TypeInt32::Clone() const {
   return CloneType<TypeInt32>();
 }
-bool TypeInt32::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeInt32::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return TypeUtils::IsIntType(type_spec);
 }
 
@@ -211,7 +212,7 @@ TypeUInt::TypeUInt(TypeStore* type_store,
 std::unique_ptr<TypeSpec> TypeUInt::Clone() const {
   return CloneType<TypeUInt>();
 }
-bool TypeUInt::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeUInt::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return TypeUtils::IsUIntType(type_spec);
 }
 absl::StatusOr<pb::Expression> TypeUInt::DefaultValueExpression(
@@ -229,7 +230,7 @@ TypeUInt8::TypeUInt8(TypeStore* type_store,
 std::unique_ptr<TypeSpec> TypeUInt8::Clone() const {
   return CloneType<TypeUInt8>();
 }
-bool TypeUInt8::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeUInt8::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return TypeUtils::IsUIntType(type_spec);
 }
 
@@ -241,7 +242,7 @@ TypeUInt16::TypeUInt16(TypeStore* type_store,
 std::unique_ptr<TypeSpec> TypeUInt16::Clone() const {
   return CloneType<TypeUInt16>();
 }
-bool TypeUInt16::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeUInt16::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return TypeUtils::IsUIntType(type_spec);
 }
 
@@ -253,7 +254,7 @@ TypeUInt32::TypeUInt32(TypeStore* type_store,
 std::unique_ptr<TypeSpec> TypeUInt32::Clone() const {
   return CloneType<TypeUInt32>();
 }
-bool TypeUInt32::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeUInt32::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return TypeUtils::IsUIntType(type_spec);
 }
 
@@ -265,7 +266,7 @@ TypeFloat64::TypeFloat64(TypeStore* type_store,
 std::unique_ptr<TypeSpec> TypeFloat64::Clone() const {
   return CloneType<TypeFloat64>();
 }
-bool TypeFloat64::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeFloat64::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return (TypeUtils::IsFloatType(type_spec) ||
           TypeUtils::IsIntType(type_spec) || TypeUtils::IsUIntType(type_spec));
 }
@@ -284,7 +285,7 @@ TypeFloat32::TypeFloat32(TypeStore* type_store,
 std::unique_ptr<TypeSpec> TypeFloat32::Clone() const {
   return CloneType<TypeFloat32>();
 }
-bool TypeFloat32::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeFloat32::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return (TypeUtils::IsFloatType(type_spec) ||
           TypeUtils::IsIntType(type_spec) || TypeUtils::IsUIntType(type_spec));
 }
@@ -635,7 +636,7 @@ pb::TypeSpec TypeStruct::ToTypeSpecProto(
     const ScopeName& call_scope_name) const {
   pb::TypeSpec type_spec;
   auto identifier = type_spec.mutable_identifier();
-  if (call_scope_name.name() != scope_name().name()) {
+  if (call_scope_name != scope_name()) {
     *identifier = scope_name().ToIdentifier();
   }
   if (local_name().empty()) {
@@ -660,10 +661,10 @@ pb::ExpressionTypeSpec TypeStruct::ToProto() const {
 std::string TypeStruct::TypeSignature() const {
   std::vector<std::string> comp;
   if (!scope_name().empty()) {
-    if (!scope_name().module_names().empty()) {
+    if (scope_name().num_module_names() > 0) {
       comp.emplace_back(absl::StrJoin(scope_name().module_names(), "_d_"));
     }
-    if (!scope_name().function_names().empty()) {
+    if (scope_name().num_function_names() > 0) {
       comp.emplace_back(absl::StrJoin(scope_name().module_names(), "_f_"));
     }
   }
@@ -675,6 +676,15 @@ std::string TypeStruct::TypeSignature() const {
   return absl::StrCat("S_", absl::StrJoin(comp, "_x_"));
 }
 
+uint64_t TypeStruct::ComputeTypeFingerprint() const {
+  // Structures are identified by their (short) signature.
+  return absl::HashOf(TypeSignature());
+}
+
+bool TypeStruct::ComputeHasSameSignature(const TypeSpec& type_spec) const {
+  return TypeSignature() == type_spec.TypeSignature();
+}
+
 std::string TypeStruct::full_name() const {
   if (name() == kTypeNameStruct) {
     return TypeSpec::full_name();
@@ -746,7 +756,7 @@ bool TypeStruct::CheckStruct(
   return true;
 }
 
-bool TypeStruct::IsAncestorOf(const TypeSpec& type_spec) const {
+bool TypeStruct::ComputeIsAncestorOf(const TypeSpec& type_spec) const {
   if (fields_.empty()) {
     return type_spec.type_id() == type_id();
   }
@@ -756,14 +766,14 @@ bool TypeStruct::IsAncestorOf(const TypeSpec& type_spec) const {
                      });
 }
 
-bool TypeStruct::IsEqual(const TypeSpec& type_spec) const {
+bool TypeStruct::ComputeIsEqual(const TypeSpec& type_spec) const {
   return CheckStruct(type_spec,
                      [](const TypeSpec* self, const TypeSpec* other) {
                        return self->IsEqual(*other);
                      });
 }
 
-bool TypeStruct::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeStruct::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   if (fields_.empty()) {
     return type_spec.type_id() == type_id();
   }
@@ -977,18 +987,18 @@ std::unique_ptr<TypeSpec> TypeTuple::Clone() const {
                                      parameters_, names_, original_bind_);
 }
 
-bool TypeTuple::IsAncestorOf(const TypeSpec& type_spec) const {
+bool TypeTuple::ComputeIsAncestorOf(const TypeSpec& type_spec) const {
   if (type_spec.type_id() == pb::TypeId::TUPLE_ID && parameters_.empty()) {
     return true;
   }
-  return TypeSpec::IsAncestorOf(type_spec);
+  return TypeSpec::ComputeIsAncestorOf(type_spec);
 }
 
-bool TypeTuple::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeTuple::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   if (type_spec.type_id() == pb::TypeId::TUPLE_ID && parameters_.empty()) {
     return true;
   }
-  return TypeSpec::IsConvertibleFrom(type_spec);
+  return TypeSpec::ComputeIsConvertibleFrom(type_spec);
 }
 
 absl::StatusOr<std::unique_ptr<TypeSpec>> TypeTuple::Bind(
@@ -1039,13 +1049,14 @@ std::unique_ptr<TypeSpec> TypeTupleJoin::Clone() const {
                                          parameters_);
 }
 
-bool TypeTupleJoin::IsAncestorOf(const TypeSpec& type_spec) const {
-  return (IsGeneratedByThis(type_spec) || TypeTuple::IsAncestorOf(type_spec));
+bool TypeTupleJoin::ComputeIsAncestorOf(const TypeSpec& type_spec) const {
+  return (IsGeneratedByThis(type_spec) ||
+          TypeTuple::ComputeIsAncestorOf(type_spec));
 }
 
-bool TypeTupleJoin::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeTupleJoin::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return (IsGeneratedByThis(type_spec) ||
-          TypeTuple::IsConvertibleFrom(type_spec));
+          TypeTuple::ComputeIsConvertibleFrom(type_spec));
 }
 
 absl::StatusOr<std::unique_ptr<TypeSpec>> TypeTupleJoin::Build(
@@ -1420,9 +1431,9 @@ absl::StatusOr<std::unique_ptr<TypeSpec>> TypeUnion::Bind(
   return {std::move(new_union)};
 }
 
-bool TypeUnion::IsAncestorOf(const TypeSpec& type_spec) const {
+bool TypeUnion::ComputeIsAncestorOf(const TypeSpec& type_spec) const {
   if (type_spec.type_id() == pb::TypeId::UNION_ID) {
-    return StoredTypeSpec::IsAncestorOf(type_spec);
+    return StoredTypeSpec::ComputeIsAncestorOf(type_spec);
   }
   for (auto parameter : parameters_) {
     if (parameter->IsAncestorOf(type_spec)) {
@@ -1432,9 +1443,9 @@ bool TypeUnion::IsAncestorOf(const TypeSpec& type_spec) const {
   return false;
 }
 
-bool TypeUnion::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeUnion::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   if (type_spec.type_id() == pb::TypeId::UNION_ID) {
-    return StoredTypeSpec::IsAncestorOf(type_spec);
+    return StoredTypeSpec::ComputeIsAncestorOf(type_spec);
   }
   for (auto parameter : parameters_) {
     if (parameter->IsConvertibleFrom(type_spec)) {
@@ -1470,6 +1481,21 @@ std::string TypeNullable::TypeSignature() const {
   return absl::StrCat("N_", parameters_.back()->TypeSignature());
 }
 
+uint64_t TypeNullable::ComputeTypeFingerprint() const {
+  if (parameters_.empty()) {
+    return TypeSpec::ComputeTypeFingerprint();
+  }
+  return absl::HashOf('N', parameters_.back()->TypeFingerprint());
+}
+
+bool TypeNullable::ComputeHasSameSignature(const TypeSpec& type_spec) const {
+  if (!parameters_.empty() && type_spec.type_id() == pb::TypeId::NULLABLE_ID &&
+      !type_spec.parameters().empty()) {
+    return parameters_.back()->HasSameSignature(*type_spec.parameters().back());
+  }
+  return TypeSignature() == type_spec.TypeSignature();
+}
+
 absl::StatusOr<std::unique_ptr<TypeSpec>> TypeNullable::Bind(
     const std::vector<TypeBindingArg>& bindings) const {
   ASSIGN_OR_RETURN(auto types, TypesFromBindings(bindings, false),
@@ -1540,9 +1566,9 @@ absl::StatusOr<pb::Expression> TypeNullable::DefaultValueExpression(
   return expression;
 }
 
-bool TypeNullable::IsAncestorOf(const TypeSpec& type_spec) const {
+bool TypeNullable::ComputeIsAncestorOf(const TypeSpec& type_spec) const {
   if (type_spec.type_id() == pb::TypeId::NULLABLE_ID) {
-    return StoredTypeSpec::IsAncestorOf(type_spec);
+    return StoredTypeSpec::ComputeIsAncestorOf(type_spec);
   }
   if (parameters_.empty()) {
     return false;
@@ -1551,9 +1577,9 @@ bool TypeNullable::IsAncestorOf(const TypeSpec& type_spec) const {
           parameters_.back()->IsAncestorOf(type_spec));
 }
 
-bool TypeNullable::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool TypeNullable::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   if (type_spec.type_id() == pb::TypeId::NULLABLE_ID) {
-    return StoredTypeSpec::IsConvertibleFrom(type_spec);
+    return StoredTypeSpec::ComputeIsConvertibleFrom(type_spec);
   }
   if (parameters_.empty()) {
     return false;
@@ -1609,14 +1635,14 @@ absl::StatusOr<std::unique_ptr<TypeSpec>> TypeDataset::Bind(
 }
 
 namespace {
+// Per thread, as modules of different environments may be analyzed
+// on different threads.
 std::vector<TypeStore*>* DatasetRegistrationStack() {
-  static const auto kStack = new std::vector<TypeStore*>();
-  return kStack;
+  static thread_local std::vector<TypeStore*> stack;
+  return &stack;
 }
 }  // namespace
 
-// Note we operate single thread, so we are fine with this.
-
 void TypeDataset::PushRegistrationStore(TypeStore* type_store) {
   DatasetRegistrationStack()->push_back(type_store);
 }
@@ -1643,13 +1669,15 @@ DatasetAggregate::DatasetAggregate(
   parameters_ = std::move(parameters);
 }
 
-bool DatasetAggregate::IsAncestorOf(const TypeSpec& type_spec) const {
-  return (IsGeneratedByThis(type_spec) || TypeDataset::IsAncestorOf(type_spec));
+bool DatasetAggregate::ComputeIsAncestorOf(const TypeSpec& type_spec) const {
+  return (IsGeneratedByThis(type_spec) ||
+          TypeDataset::ComputeIsAncestorOf(type_spec));
 }
 
-bool DatasetAggregate::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool DatasetAggregate::ComputeIsConvertibleFrom(
+    const TypeSpec& type_spec) const {
   return (IsGeneratedByThis(type_spec) ||
-          TypeDataset::IsConvertibleFrom(type_spec));
+          TypeDataset::ComputeIsConvertibleFrom(type_spec));
 }
 
 std::unique_ptr<TypeSpec> DatasetAggregate::Clone() const {
@@ -1810,13 +1838,14 @@ DatasetJoin::DatasetJoin(TypeStore* type_store,
   parameters_ = std::move(parameters);
 }
 
-bool DatasetJoin::IsAncestorOf(const TypeSpec& type_spec) const {
-  return (IsGeneratedByThis(type_spec) || TypeDataset::IsAncestorOf(type_spec));
+bool DatasetJoin::ComputeIsAncestorOf(const TypeSpec& type_spec) const {
+  return (IsGeneratedByThis(type_spec) ||
+          TypeDataset::ComputeIsAncestorOf(type_spec));
 }
 
-bool DatasetJoin::IsConvertibleFrom(const TypeSpec& type_spec) const {
+bool DatasetJoin::ComputeIsConvertibleFrom(const TypeSpec& type_spec) const {
   return (IsGeneratedByThis(type_spec) ||
-          TypeDataset::IsConvertibleFrom(type_spec));
+          TypeDataset::ComputeIsConvertibleFrom(type_spec));
 }
 
 std::unique_ptr<TypeSpec> DatasetJoin::Clone() const {
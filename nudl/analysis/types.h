@@ -111,9 +111,11 @@ class TypeInt : public StoredTypeSpec {
   TypeInt(TypeStore* type_store,
           std::shared_ptr<TypeMemberStore> type_member_store);
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
   absl::StatusOr<pb::Expression> DefaultValueExpression(
       const ScopeName& call_scope_name) const override;
+
+ protected:
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeInt8 : public StoredTypeSpec {
@@ -121,7 +123,9 @@ class TypeInt8 : public StoredTypeSpec {
   TypeInt8(TypeStore* type_store,
            std::shared_ptr<TypeMemberStore> type_member_store);
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
+
+ protected:
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeInt16 : public StoredTypeSpec {
@@ -129,7 +133,9 @@ class TypeInt16 : public StoredTypeSpec {
   TypeInt16(TypeStore* type_store,
             std::shared_ptr<TypeMemberStore> type_member_store);
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
+
+ protected:
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeInt32 : public StoredTypeSpec {
@@ -137,7 +143,9 @@ class TypeInt32 : public StoredTypeSpec {
   TypeInt32(TypeStore* type_store,
             std::shared_ptr<TypeMemberStore> type_member_store);
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
+
+ protected:
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeUInt : public StoredTypeSpec {
@@ -145,9 +153,11 @@ class TypeUInt : public StoredTypeSpec {
   TypeUInt(TypeStore* type_store,
            std::shared_ptr<TypeMemberStore> type_member_store);
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
   absl::StatusOr<pb::Expression> DefaultValueExpression(
       const ScopeName& call_scope_name) const override;
+
+ protected:
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeUInt8 : public StoredTypeSpec {
@@ -155,7 +165,9 @@ class TypeUInt8 : public StoredTypeSpec {
   TypeUInt8(TypeStore* type_store,
             std::shared_ptr<TypeMemberStore> type_member_store);
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
+
+ protected:
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeUInt16 : public StoredTypeSpec {
@@ -163,7 +175,9 @@ class TypeUInt16 : public StoredTypeSpec {
   TypeUInt16(TypeStore* type_store,
              std::shared_ptr<TypeMemberStore> type_member_store);
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
+
+ protected:
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeUInt32 : public StoredTypeSpec {
@@ -171,7 +185,9 @@ class TypeUInt32 : public StoredTypeSpec {
   TypeUInt32(TypeStore* type_store,
              std::shared_ptr<TypeMemberStore> type_member_store);
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
+
+ protected:
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeFloat64 : public StoredTypeSpec {
@@ -179,9 +195,11 @@ class TypeFloat64 : public StoredTypeSpec {
   TypeFloat64(TypeStore* type_store,
               std::shared_ptr<TypeMemberStore> type_member_store);
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
   absl::StatusOr<pb::Expression> DefaultValueExpression(
       const ScopeName& call_scope_name) const override;
+
+ protected:
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeFloat32 : public StoredTypeSpec {
@@ -189,9 +207,11 @@ class TypeFloat32 : public StoredTypeSpec {
   TypeFloat32(TypeStore* type_store,
               std::shared_ptr<TypeMemberStore> type_member_store);
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
   absl::StatusOr<pb::Expression> DefaultValueExpression(
       const ScopeName& call_scope_name) const override;
+
+ protected:
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeString : public StoredTypeSpec {
@@ -346,14 +366,16 @@ class TypeTuple : public StoredTypeSpec {
   const TypeSpec* IndexType() const override;
   std::string full_name() const override;
   bool IsBound() const override;
-  bool IsAncestorOf(const TypeSpec& type_spec) const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
 
   const std::vector<std::string>& names() const;
   bool is_named() const;
 
   void UpdateNames(const TypeSpec* type_spec);
 
+ protected:
+  bool ComputeIsAncestorOf(const TypeSpec& type_spec) const override;
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
+
  private:
   bool ComputeIsNamed() const;
 
@@ -375,9 +397,11 @@ class TypeTupleJoin : public TypeTuple {
       const std::vector<TypeBindingArg>& bindings) const override;
   absl::StatusOr<std::unique_ptr<TypeSpec>> Bind(
       const std::vector<TypeBindingArg>& bindings) const override;
-  bool IsAncestorOf(const TypeSpec& type_spec) const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
   std::unique_ptr<TypeSpec> Clone() const override;
+
+ protected:
+  bool ComputeIsAncestorOf(const TypeSpec& type_spec) const override;
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class StructMemberStore;
@@ -407,9 +431,6 @@ class TypeStruct : public StoredTypeSpec {
   std::string full_name() const override;
   bool IsBound() const override;
   std::unique_ptr<TypeSpec> Clone() const override;
-  bool IsAncestorOf(const TypeSpec& type_spec) const override;
-  bool IsEqual(const TypeSpec& type_spec) const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
   absl::StatusOr<std::unique_ptr<TypeSpec>> Bind(
       const std::vector<TypeBindingArg>& bindings) const override;
   pb::ExpressionTypeSpec ToProto() const override;
@@ -423,6 +444,12 @@ class TypeStruct : public StoredTypeSpec {
   bool is_abstract_struct() const;
 
  protected:
+  bool ComputeIsAncestorOf(const TypeSpec& type_spec) const override;
+  bool ComputeIsEqual(const TypeSpec& type_spec) const override;
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
+  uint64_t ComputeTypeFingerprint() const override;
+  bool ComputeHasSameSignature(const TypeSpec& type_spec) const override;
+
   bool CheckStruct(const TypeSpec& type_spec,
                    const std::function<bool(const TypeSpec*, const TypeSpec*)>&
                        checker) const;
@@ -529,8 +556,10 @@ class TypeUnion : public StoredTypeSpec {
   std::unique_ptr<TypeSpec> Clone() const override;
   absl::StatusOr<std::unique_ptr<TypeSpec>> Bind(
       const std::vector<TypeBindingArg>& bindings) const override;
-  bool IsAncestorOf(const TypeSpec& type_spec) const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
+
+ protected:
+  bool ComputeIsAncestorOf(const TypeSpec& type_spec) const override;
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
 };
 
 class TypeNullable : public StoredTypeSpec {
@@ -542,11 +571,15 @@ class TypeNullable : public StoredTypeSpec {
   std::unique_ptr<TypeSpec> Clone() const override;
   absl::StatusOr<std::unique_ptr<TypeSpec>> Bind(
       const std::vector<TypeBindingArg>& bindings) const override;
-  bool IsAncestorOf(const TypeSpec& type_spec) const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
   absl::StatusOr<pb::Expression> DefaultValueExpression(
       const ScopeName& call_scope_name) const override;
   std::string TypeSignature() const override;
+
+ protected:
+  bool ComputeIsAncestorOf(const TypeSpec& type_spec) const override;
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
+  uint64_t ComputeTypeFingerprint() const override;
+  bool ComputeHasSameSignature(const TypeSpec& type_spec) const override;
 };
 
 class TypeDataset : public StoredTypeSpec {
@@ -579,11 +612,12 @@ class DatasetAggregate : public TypeDataset {
       const std::vector<TypeBindingArg>& bindings) const override;
   absl::StatusOr<std::unique_ptr<TypeSpec>> Bind(
       const std::vector<TypeBindingArg>& bindings) const override;
-  bool IsAncestorOf(const TypeSpec& type_spec) const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
   std::unique_ptr<TypeSpec> Clone() const override;
 
  protected:
+  bool ComputeIsAncestorOf(const TypeSpec& type_spec) const override;
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
+
   absl::StatusOr<const TypeSpec*> AggregateFieldType(
       absl::string_view aggregate_type, const TypeSpec* type_spec) const;
   mutable std::vector<std::unique_ptr<TypeSpec>> allocated_types_;
@@ -598,10 +632,12 @@ class DatasetJoin : public TypeDataset {
       const std::vector<TypeBindingArg>& bindings) const override;
   absl::StatusOr<std::unique_ptr<TypeSpec>> Bind(
       const std::vector<TypeBindingArg>& bindings) const override;
-  bool IsAncestorOf(const TypeSpec& type_spec) const override;
-  bool IsConvertibleFrom(const TypeSpec& type_spec) const override;
   std::unique_ptr<TypeSpec> Clone() const override;
 
+ protected:
+  bool ComputeIsAncestorOf(const TypeSpec& type_spec) const override;
+  bool ComputeIsConvertibleFrom(const TypeSpec& type_spec) const override;
+
  private:
   mutable std::vector<std::unique_ptr<TypeSpec>> allocated_types_;
 };
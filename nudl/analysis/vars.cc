@@ -38,6 +38,10 @@ VarBase::VarBase(absl::string_view name, const TypeSpec* type_spec,
   }
 }
 
+void* VarBase::operator new(size_t size) { return AnalysisArena::New(size); }
+
+void VarBase::operator delete(void* ptr) { AnalysisArena::Delete(ptr); }
+
 VarBase::~VarBase() {
   while (!local_fields_.empty()) {
     local_fields_.pop_back();
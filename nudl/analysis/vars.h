@@ -39,6 +39,10 @@ class VarBase : public WrappedNameStore {
           absl::optional<NameStore*> parent_store = {});
   ~VarBase() override;
 
+  // Variables are allocated in the active AnalysisArena, if any.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
   const TypeSpec* type_spec() const override;
   absl::optional<NameStore*> parent_store() const override;
   const std::vector<Expression*> assignments() const;
@@ -14,6 +14,7 @@
 # limitations under the License.
 #
 
+from libcpp.memory cimport unique_ptr
 from libcpp.string cimport string
 from libcpp.vector cimport vector
 
@@ -27,6 +28,13 @@ cdef extern from "nudl/conversion/convert_tool.h" namespace 'nudl':
         const vector[string]& search_paths,
         vector[string]* errors);
 
+    cdef cppclass ConvertSession:
+        ConvertSession(const string& builtin_path,
+                       const vector[string]& search_paths)
+        string ConvertPythonSource(const string& module_name,
+                                   const string& code,
+                                   vector[string]* errors)
+
 
 def Convert(module_name: str,
             code: str,
@@ -41,3 +49,22 @@ def Convert(module_name: str,
                                  &errors)
     return (result.decode('utf-8'),
             [error.decode('utf-8') for error in errors])
+
+
+cdef class Session:
+    """Keeps the builtin and imported library modules analyzed between
+    conversions, so each conversion analyzes just the provided code."""
+    cdef unique_ptr[ConvertSession] session
+
+    def __cinit__(self, builtin_path: str, search_paths: typing.List[str]):
+        self.session.reset(new ConvertSession(
+            builtin_path.encode('utf-8'),
+            [path.encode('utf-8') for path in search_paths]))
+
+    def Convert(self, module_name: str,
+                code: str) -> typing.Tuple[str, typing.List[str]]:
+        cdef vector[string] errors
+        result = self.session.get().ConvertPythonSource(
+            module_name.encode('utf-8'), code.encode('utf-8'), &errors)
+        return (result.decode('utf-8'),
+                [error.decode('utf-8') for error in errors])
@@ -25,6 +25,7 @@
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "nudl/conversion/convert_flags.h"
+#include "nudl/conversion/convert_server.h"
 #include "nudl/conversion/convert_tool.h"
 #include "nudl/status/status.h"
 
@@ -32,20 +33,26 @@ ABSL_DECLARE_FLAG(std::string, status_annotate_joiner);
 DECLARE_bool(alsologtostderr);
 
 int main(int argc, char* argv[]) {
-  std::cout << "Running Nudl Converter under: "
-            << std_filesystem::current_path().native()
-            << " with command line:" << std::endl;
-  for (int i = 0; i < argc; ++i) {
-    std::cout << argv[i] << " ";
-  }
-  std::cout << std::endl;
   google::InitGoogleLogging(argv[0]);
   absl::InitializeSymbolizer(argv[0]);
   absl::InstallFailureSignalHandler(absl::FailureSignalHandlerOptions());
   absl::ParseCommandLine(argc, argv);
   absl::SetFlag(&FLAGS_status_annotate_joiner, ";\n    ");
   FLAGS_alsologtostderr = true;
-  return nudl::LogErrorLines(
-      "Running nudl conversion",
-      nudl::RunConvertTool(nudl::ConvertOptionsFromFlags()));
+  const auto options = nudl::ConvertOptionsFromFlags();
+  // The standard output of a server may be used for its responses.
+  std::ostream& out = options.server_address.empty() ? std::cout : std::cerr;
+  out << "Running Nudl Converter under: "
+      << std_filesystem::current_path().native()
+      << " with command line:" << std::endl;
+  for (int i = 0; i < argc; ++i) {
+    out << argv[i] << " ";
+  }
+  out << std::endl;
+  if (!options.server_address.empty()) {
+    return nudl::LogErrorLines("Running nudl conversion server",
+                               nudl::RunConvertServer(options));
+  }
+  return nudl::LogErrorLines("Running nudl conversion",
+                             nudl::RunConvertTool(options));
 }
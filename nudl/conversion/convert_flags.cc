@@ -16,6 +16,7 @@
 
 #include "nudl/conversion/convert_flags.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -52,6 +53,40 @@ ABSL_FLAG(bool, direct_output, false,
           "If true, we output the files to --output_dir without "
           "maintaining directory structure.");
 ABSL_FLAG(std::string, lang, "python", "Language to convert to");
+ABSL_FLAG(std::string, parse_cache_dir, "",
+          "If not empty, parsed modules are cached in this directory, "
+          "and reused between runs for unchanged module files.");
+ABSL_FLAG(int, num_parse_threads, 1,
+          "Number of threads for reading and parsing the modules to convert, "
+          "and their imports, before analysis. With 1, modules are parsed "
+          "at import time.");
+ABSL_FLAG(bool, lazy_function_bodies, false,
+          "If true, the bodies of fully typed functions are analyzed only "
+          "when called, or when their module is converted.");
+ABSL_FLAG(std::string, interface_dir, "",
+          "If not empty, the interfaces of the analyzed modules are written "
+          "to this directory, as .ndli files, and the imported modules are "
+          "analyzed from these, without the bodies of their fully typed "
+          "functions, while their sources do not change. Requires "
+          "--bindings_on_use, and --write_only_input or --server.");
+ABSL_FLAG(std::string, builtin_snapshot, "",
+          "If not empty, a snapshot of the builtin module, as written with "
+          "--write_builtin_snapshot. If created from the same --builtin_path, "
+          "it is used instead of parsing the builtin module, and the builtin "
+          "function bodies verified in it are analyzed only when used.");
+ABSL_FLAG(std::string, write_builtin_snapshot, "",
+          "If not empty, analyzes the --builtin_path module, writes its "
+          "snapshot to this file, and exits.");
+ABSL_FLAG(int, num_analysis_threads, 1,
+          "If more than 1, the input modules and the modules they import are "
+          "analyzed and converted on this many threads, each in an "
+          "environment of its own, level by level in the import graph. "
+          "Requires --interface_dir and --output_dir. Best used with "
+          "--builtin_snapshot, as each module analysis loads the builtins.");
+ABSL_FLAG(std::string, server, "",
+          "If not empty, runs as a conversion server, that keeps the analyzed "
+          "modules between requests. Either `stdio`, for requests on the "
+          "standard input, or `unix:<path>`, for a Unix socket at <path>.");
 
 namespace nudl {
 
@@ -88,6 +123,15 @@ ConvertToolOptions ConvertOptionsFromFlags() {
       absl::GetFlag(FLAGS_bindings_on_use),
       absl::GetFlag(FLAGS_direct_output),
       lang_result.value(),
+      absl::GetFlag(FLAGS_parse_cache_dir),
+      static_cast<size_t>(std::max(absl::GetFlag(FLAGS_num_parse_threads), 1)),
+      absl::GetFlag(FLAGS_lazy_function_bodies),
+      absl::GetFlag(FLAGS_interface_dir),
+      absl::GetFlag(FLAGS_server),
+      absl::GetFlag(FLAGS_builtin_snapshot),
+      absl::GetFlag(FLAGS_write_builtin_snapshot),
+      static_cast<size_t>(
+          std::max(absl::GetFlag(FLAGS_num_analysis_threads), 1)),
   };
 }
 
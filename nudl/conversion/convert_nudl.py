@@ -18,6 +18,7 @@ import typing
 import _convert_nudl
 
 _NEXT_MODULE_ID = 0
+_SESSIONS = {}
 
 
 def _NextModuleName():
@@ -37,6 +38,16 @@ def DefaultSearchPath():
     return os.path.join(_BASE_DIR, "pylib")
 
 
+def GetSession(builtin_path: str,
+               search_paths: typing.List[str]) -> _convert_nudl.Session:
+    """Returns a conversion session that is reused between calls with
+    the same builtin and search paths."""
+    key = (builtin_path, tuple(search_paths))
+    if key not in _SESSIONS:
+        _SESSIONS[key] = _convert_nudl.Session(builtin_path, search_paths)
+    return _SESSIONS[key]
+
+
 def ConvertWithDefaults(
     code: str,
     extra_search_paths: typing.Optional[typing.List[str]] = None
@@ -44,5 +55,5 @@ def ConvertWithDefaults(
     search_paths = [DefaultSearchPath()]
     if extra_search_paths:
         search_paths.extend(extra_search_paths)
-    return _convert_nudl.Convert(_NextModuleName(), code, DefaultBuiltinPath(),
-                                 search_paths)
+    return GetSession(DefaultBuiltinPath(),
+                      search_paths).Convert(_NextModuleName(), code)
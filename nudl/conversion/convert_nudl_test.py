@@ -31,6 +31,18 @@ r = print(x)
         self.assertGreater(result.find("x = 20\nr = (print(x))"), 0)
         self.assertFalse(errors)
 
+    def test_convert_reuses_session(self):
+        (result, errors) = convert_nudl.ConvertWithDefaults("y = 30")
+        self.assertGreater(result.find("y = 30"), 0)
+        self.assertFalse(errors)
+        (result, errors) = convert_nudl.ConvertWithDefaults("y = ")
+        self.assertFalse(result)
+        self.assertTrue(errors)
+        (result, errors) = convert_nudl.ConvertWithDefaults("z = 40")
+        self.assertGreater(result.find("z = 40"), 0)
+        self.assertFalse(errors)
+        self.assertEqual(len(convert_nudl._SESSIONS), 1)
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,366 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "nudl/conversion/convert_server.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "absl/time/time.h"
+#include "glog/logging.h"
+#include "nudl/analysis/errors.h"
+#include "nudl/grammar/dsl.h"
+#include "nudl/status/status.h"
+
+namespace nudl {
+
+namespace {
+// Maximum number of digits in the length line of a frame.
+constexpr size_t kMaxFrameLengthDigits = 20;
+
+absl::Status ReadAll(int fd, char* buffer, size_t size) {
+  while (size > 0) {
+    const ssize_t num_read = ::read(fd, buffer, size);
+    if (num_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_read < 0) {
+      return status::InternalErrorBuilder()
+             << "Error reading frame: " << strerror(errno);
+    }
+    if (num_read == 0) {
+      return status::DataLossErrorBuilder()
+             << "Input closed in the middle of a frame";
+    }
+    buffer += num_read;
+    size -= num_read;
+  }
+  return absl::OkStatus();
+}
+
+// Writes to a socket with send, which does not raise SIGPIPE when the
+// peer closed the connection, and to any other file with write.
+ssize_t WriteSome(int fd, absl::string_view data) {
+  const ssize_t num_sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+  if (num_sent >= 0 || errno != ENOTSOCK) {
+    return num_sent;
+  }
+  return ::write(fd, data.data(), data.size());
+}
+
+absl::Status WriteAll(int fd, absl::string_view data) {
+  while (!data.empty()) {
+    const ssize_t num_written = WriteSome(fd, data);
+    if (num_written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_written < 0) {
+      return status::InternalErrorBuilder()
+             << "Error writing frame: " << strerror(errno);
+    }
+    data.remove_prefix(num_written);
+  }
+  return absl::OkStatus();
+}
+
+std::string ErrorResponse(const absl::Status& err_status) {
+  std::vector<std::string> lines{"error", std::string(err_status.message())};
+  for (const auto& err : analysis::ExtractErrorLines(err_status)) {
+    lines.emplace_back(err);
+  }
+  return absl::StrJoin(lines, "\n");
+}
+}  // namespace
+
+absl::StatusOr<ConvertRequest> ParseConvertRequest(absl::string_view payload) {
+  ConvertRequest request;
+  bool has_module = false;
+  while (!payload.empty()) {
+    const size_t pos = payload.find('\n');
+    absl::string_view line = payload.substr(0, pos);
+    payload = pos == absl::string_view::npos ? absl::string_view()
+                                             : payload.substr(pos + 1);
+    if (line.empty()) {
+      break;
+    }
+    std::pair<absl::string_view, absl::string_view> header =
+        absl::StrSplit(line, absl::MaxSplits(':', 1));
+    const absl::string_view key = absl::StripAsciiWhitespace(header.first);
+    const absl::string_view value = absl::StripAsciiWhitespace(header.second);
+    if (key == "module" || key == "source") {
+      if (has_module) {
+        return status::InvalidArgumentErrorBuilder()
+               << "Request specifies more than one module";
+      }
+      has_module = true;
+      request.module_name = std::string(value);
+      request.from_source = key == "source";
+    } else if (key == "output_dir") {
+      request.output_dir = std::string(value);
+    } else if (key == "command") {
+      if (value == "shutdown") {
+        request.command = ConvertRequest::Command::SHUTDOWN;
+      } else if (value != "convert") {
+        return status::InvalidArgumentErrorBuilder()
+               << "Unknown request command: " << value;
+      }
+    } else {
+      return status::InvalidArgumentErrorBuilder()
+             << "Unknown request header: `" << line << "`";
+    }
+  }
+  if (request.command == ConvertRequest::Command::SHUTDOWN) {
+    return request;
+  }
+  if (request.module_name.empty()) {
+    return status::InvalidArgumentErrorBuilder()
+           << "Request specifies no module to convert";
+  }
+  if (request.from_source) {
+    request.code = std::string(payload);
+  }
+  return request;
+}
+
+absl::StatusOr<bool> ReadFrame(int fd, std::string* payload) {
+  std::string length_line;
+  while (true) {
+    char c;
+    const ssize_t num_read = ::read(fd, &c, 1);
+    if (num_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_read < 0) {
+      return status::InternalErrorBuilder()
+             << "Error reading frame: " << strerror(errno);
+    }
+    if (num_read == 0) {
+      if (length_line.empty()) {
+        return false;
+      }
+      return status::DataLossErrorBuilder()
+             << "Input closed in the middle of a frame";
+    }
+    if (c == '\n') {
+      break;
+    }
+    if (length_line.size() >= kMaxFrameLengthDigits) {
+      return status::InvalidArgumentErrorBuilder()
+             << "Frame length line too long: " << length_line;
+    }
+    length_line.push_back(c);
+  }
+  size_t length;
+  if (!absl::SimpleAtoi(absl::StripAsciiWhitespace(length_line), &length)) {
+    return status::InvalidArgumentErrorBuilder()
+           << "Invalid frame length: `" << length_line << "`";
+  }
+  if (length > kMaxFrameSize) {
+    return status::InvalidArgumentErrorBuilder()
+           << "Frame length: " << length
+           << " is over the maximum frame size: " << kMaxFrameSize;
+  }
+  payload->resize(length);
+  RETURN_IF_ERROR(ReadAll(fd, payload->data(), length));
+  return true;
+}
+
+absl::Status WriteFrame(int fd, absl::string_view payload) {
+  RETURN_IF_ERROR(WriteAll(fd, absl::StrCat(payload.size(), "\n")));
+  return WriteAll(fd, payload);
+}
+
+ConvertServer::ConvertServer(const ConvertToolOptions& options)
+    : options_(options), tool_(BuildConvertTool(options, true)) {}
+
+absl::Status ConvertServer::Prepare() {
+  RETURN_IF_ERROR(tool_->Prepare()) << "Preparing environment";
+  // A failure is logged, and only leaves the first parses slower.
+  grammar::WarmUpParser().IgnoreError();
+  return absl::OkStatus();
+}
+
+bool ConvertServer::is_shutdown() const { return is_shutdown_; }
+
+size_t ConvertServer::num_requests() const { return num_requests_; }
+
+absl::StatusOr<std::string> ConvertServer::Convert(
+    const ConvertRequest& request) {
+  // Errors in the changed modules that are not needed by this request
+  // are not reported here, but by the requests that import them.
+  auto reload_result = tool_->ReloadChangedModules();
+  if (!reload_result.ok()) {
+    LOG(WARNING) << "Reloading changed modules: " << reload_result.status();
+  } else if (!reload_result.value().empty()) {
+    LOG(INFO) << "Reloaded changed modules: "
+              << absl::StrJoin(reload_result.value(), ", ");
+  }
+  if (request.from_source) {
+    tool_->UnloadModule(request.module_name);
+    RETURN_IF_ERROR(
+        tool_->LoadModuleFromString(request.module_name, request.code))
+        << "Loading module: " << request.module_name;
+  } else {
+    RETURN_IF_ERROR(tool_->LoadModule(request.module_name))
+        << "Loading module: " << request.module_name;
+  }
+  if (request.output_dir.empty()) {
+    return tool_->ConvertToString();
+  }
+  RETURN_IF_ERROR(tool_->WritePythonOutput(request.output_dir,
+                                           options_.py_path,
+                                           options_.direct_output, {}));
+  return std::string();
+}
+
+std::string ConvertServer::ProcessRequest(absl::string_view payload) {
+  ++num_requests_;
+  auto request = ParseConvertRequest(payload);
+  if (!request.ok()) {
+    return ErrorResponse(request.status());
+  }
+  if (request.value().command == ConvertRequest::Command::SHUTDOWN) {
+    is_shutdown_ = true;
+    return "ok\n";
+  }
+  const absl::Time start_time = absl::Now();
+  auto result = Convert(request.value());
+  if (!result.ok()) {
+    LOG(WARNING) << "Failed to convert: " << request.value().module_name
+                 << " in " << (absl::Now() - start_time) << ": "
+                 << result.status();
+    return ErrorResponse(result.status());
+  }
+  LOG(INFO) << "Converted: " << request.value().module_name << " in "
+            << (absl::Now() - start_time);
+  return absl::StrCat("ok\n", result.value());
+}
+
+absl::Status ConvertServer::Serve(int input_fd, int output_fd) {
+  std::string payload;
+  while (!is_shutdown_) {
+    ASSIGN_OR_RETURN(bool has_frame, ReadFrame(input_fd, &payload));
+    if (!has_frame) {
+      break;
+    }
+    RETURN_IF_ERROR(WriteFrame(output_fd, ProcessRequest(payload)));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ConvertServer::ServeUnixSocket(absl::string_view socket_path) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+    return status::InvalidArgumentErrorBuilder()
+           << "Invalid Unix socket path: `" << socket_path << "`";
+  }
+  memcpy(address.sun_path, socket_path.data(), socket_path.size());
+  const int socket_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_fd < 0) {
+    return status::InternalErrorBuilder()
+           << "Cannot create socket: " << strerror(errno);
+  }
+  // Replaces the socket left by a previous server, but no other file.
+  struct stat path_stat;
+  if (::stat(address.sun_path, &path_stat) == 0) {
+    if (!S_ISSOCK(path_stat.st_mode)) {
+      ::close(socket_fd);
+      return status::FailedPreconditionErrorBuilder()
+             << "Path: " << socket_path << " exists and is not a socket";
+    }
+    ::unlink(address.sun_path);
+  }
+  if (::bind(socket_fd, reinterpret_cast<struct sockaddr*>(&address),
+             sizeof(address)) < 0 ||
+      ::listen(socket_fd, SOMAXCONN) < 0) {
+    const int bind_errno = errno;
+    ::close(socket_fd);
+    return status::InternalErrorBuilder()
+           << "Cannot listen on: " << socket_path << ": "
+           << strerror(bind_errno);
+  }
+  LOG(INFO) << "Conversion server listening on: " << socket_path;
+  absl::Status error;
+  while (!is_shutdown_) {
+    const int connection_fd = ::accept(socket_fd, nullptr, nullptr);
+    if (connection_fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error = status::InternalErrorBuilder()
+              << "Error accepting connection: " << strerror(errno);
+      break;
+    }
+    // Errors are specific to a connection, so we continue serving.
+    auto serve_status = Serve(connection_fd, connection_fd);
+    if (!serve_status.ok()) {
+      LOG(WARNING) << "Serving connection: " << serve_status;
+    }
+    ::close(connection_fd);
+  }
+  ::close(socket_fd);
+  ::unlink(address.sun_path);
+  return error;
+}
+
+absl::Status RunConvertServer(const ConvertToolOptions& options) {
+  RETURN_IF_ERROR(ValidateConvertToolOptions(options));
+  // A client that disconnects before reading its response fails the write
+  // of that response, instead of killing the server.
+  ::signal(SIGPIPE, SIG_IGN);
+  ConvertServer server(options);
+  if (options.server_address == "stdio") {
+    // The standard output is kept for responses, so all other output
+    // goes to the standard error.
+    std::cout.flush();
+    const int output_fd = ::dup(STDOUT_FILENO);
+    if (output_fd < 0 || ::dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+      return status::InternalErrorBuilder()
+             << "Cannot redirect standard output: " << strerror(errno);
+    }
+    RETURN_IF_ERROR(server.Prepare());
+    auto serve_status = server.Serve(STDIN_FILENO, output_fd);
+    ::close(output_fd);
+    return serve_status;
+  }
+  absl::string_view socket_path(options.server_address);
+  if (!absl::ConsumePrefix(&socket_path, "unix:")) {
+    return status::InvalidArgumentErrorBuilder()
+           << "Invalid server address: `" << options.server_address
+           << "`. Expecting `stdio` or `unix:<path>`";
+  }
+  RETURN_IF_ERROR(server.Prepare());
+  return server.ServeUnixSocket(socket_path);
+}
+
+}  // namespace nudl
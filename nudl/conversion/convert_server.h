@@ -0,0 +1,114 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef NUDL_CONVERSION_CONVERT_SERVER_H__
+#define NUDL_CONVERSION_CONVERT_SERVER_H__
+
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "nudl/conversion/convert_tool.h"
+
+namespace nudl {
+
+// A conversion server keeps the environment of a ConvertTool prepared
+// between conversion requests, so the builtin module and the imported
+// modules are parsed and analyzed once, and only the modules whose
+// source changed since are analyzed again.
+//
+// Requests and responses are exchanged as frames: the decimal length
+// of the payload, a newline, then the payload bytes. Frames longer than
+// kMaxFrameSize are rejected.
+//
+// A request payload is a set of `key: value` header lines, an empty
+// line, then the module code, for source requests. Header keys:
+//   - `module: <name>` - converts the module <name>, read from the
+//      search paths of the server.
+//   - `source: <name>` - converts the code after the headers, as
+//      the module <name>. This replaces any module previously
+//      converted under the same name.
+//   - `output_dir: <path>` - writes the converted files under <path>,
+//      instead of returning the converted code.
+//   - `command: shutdown` - stops the server.
+// The response payload starts with a line containing `ok` or `error`,
+// followed by the converted code, or by the error lines.
+struct ConvertRequest {
+  enum class Command { CONVERT, SHUTDOWN };
+  Command command = Command::CONVERT;
+  std::string module_name;
+  // If true, the module is converted from `code`.
+  bool from_source = false;
+  std::string code;
+  std::string output_dir;
+};
+
+// Maximum size of a frame payload.
+inline constexpr size_t kMaxFrameSize = 1 << 28;
+
+// Parses the payload of a request frame.
+absl::StatusOr<ConvertRequest> ParseConvertRequest(absl::string_view payload);
+
+// Reads a frame payload from the file descriptor. Returns false if
+// the input is closed before the frame starts.
+absl::StatusOr<bool> ReadFrame(int fd, std::string* payload);
+// Writes a frame with the provided payload to the file descriptor.
+// Returns an error, without raising SIGPIPE on sockets, if the reader
+// closed its end.
+absl::Status WriteFrame(int fd, absl::string_view payload);
+
+class ConvertServer {
+ public:
+  // The input module and paths in options are ignored: the modules
+  // to convert come with the requests.
+  explicit ConvertServer(const ConvertToolOptions& options);
+
+  absl::Status Prepare();
+
+  // Serves the requests read from input_fd, writing the responses to
+  // output_fd, until the input is closed, or a shutdown request.
+  absl::Status Serve(int input_fd, int output_fd);
+
+  // Listens on a Unix domain socket at socket_path, and serves the
+  // requests of each connection, until a shutdown request.
+  absl::Status ServeUnixSocket(absl::string_view socket_path);
+
+  // Processes a request payload, and returns the response payload.
+  std::string ProcessRequest(absl::string_view payload);
+
+  bool is_shutdown() const;
+  size_t num_requests() const;
+
+ private:
+  absl::StatusOr<std::string> Convert(const ConvertRequest& request);
+
+  const ConvertToolOptions options_;
+  std::unique_ptr<ConvertTool> tool_;
+  bool is_shutdown_ = false;
+  size_t num_requests_ = 0;
+};
+
+// Runs a conversion server on options.server_address, which is
+// either `stdio`, for serving the standard input and output, or
+// `unix:<path>`, for serving a Unix domain socket at <path>.
+// In stdio mode, anything else written to standard output by the
+// conversion is redirected to standard error.
+absl::Status RunConvertServer(const ConvertToolOptions& options);
+
+}  // namespace nudl
+
+#endif  // NUDL_CONVERSION_CONVERT_SERVER_H__
@@ -0,0 +1,184 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "nudl/conversion/convert_server.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "glog/logging.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "nudl/status/testing.h"
+
+namespace nudl {
+
+TEST(ConvertServer, ParseRequest) {
+  ASSERT_OK_AND_ASSIGN(auto request,
+                       ParseConvertRequest("module: a.b\noutput_dir: /tmp/x"));
+  EXPECT_EQ(request.command, ConvertRequest::Command::CONVERT);
+  EXPECT_EQ(request.module_name, "a.b");
+  EXPECT_FALSE(request.from_source);
+  EXPECT_EQ(request.output_dir, "/tmp/x");
+  EXPECT_TRUE(request.code.empty());
+
+  ASSERT_OK_AND_ASSIGN(request,
+                       ParseConvertRequest("source: foo\n\nx = 1\ny = 2\n"));
+  EXPECT_EQ(request.module_name, "foo");
+  EXPECT_TRUE(request.from_source);
+  EXPECT_EQ(request.code, "x = 1\ny = 2\n");
+
+  ASSERT_OK_AND_ASSIGN(request, ParseConvertRequest("command: shutdown\n"));
+  EXPECT_EQ(request.command, ConvertRequest::Command::SHUTDOWN);
+
+  EXPECT_THAT(ParseConvertRequest("module: a\nsource: b\n").status().message(),
+              testing::HasSubstr("more than one module"));
+  EXPECT_THAT(ParseConvertRequest("foo: bar\n").status().message(),
+              testing::HasSubstr("Unknown request header"));
+  EXPECT_THAT(ParseConvertRequest("command: restart\n").status().message(),
+              testing::HasSubstr("Unknown request command"));
+  EXPECT_THAT(ParseConvertRequest("output_dir: x\n").status().message(),
+              testing::HasSubstr("no module"));
+}
+
+class FramePipe {
+ public:
+  FramePipe() { CHECK_EQ(::pipe(fds_), 0); }
+  ~FramePipe() {
+    CloseWrite();
+    ::close(fds_[0]);
+  }
+  int read_fd() const { return fds_[0]; }
+  int write_fd() const { return fds_[1]; }
+  void Write(absl::string_view data) {
+    CHECK_EQ(::write(fds_[1], data.data(), data.size()),
+             static_cast<ssize_t>(data.size()));
+  }
+  void CloseWrite() {
+    if (fds_[1] >= 0) {
+      ::close(fds_[1]);
+      fds_[1] = -1;
+    }
+  }
+
+ private:
+  int fds_[2];
+};
+
+TEST(ConvertServer, Frames) {
+  FramePipe frame_pipe;
+  ASSERT_OK(WriteFrame(frame_pipe.write_fd(), "module: foo\n"));
+  ASSERT_OK(WriteFrame(frame_pipe.write_fd(), ""));
+  frame_pipe.CloseWrite();
+  std::string payload;
+  ASSERT_OK_AND_ASSIGN(bool has_frame,
+                       ReadFrame(frame_pipe.read_fd(), &payload));
+  EXPECT_TRUE(has_frame);
+  EXPECT_EQ(payload, "module: foo\n");
+  ASSERT_OK_AND_ASSIGN(has_frame, ReadFrame(frame_pipe.read_fd(), &payload));
+  EXPECT_TRUE(has_frame);
+  EXPECT_TRUE(payload.empty());
+  // The input is closed between frames:
+  ASSERT_OK_AND_ASSIGN(has_frame, ReadFrame(frame_pipe.read_fd(), &payload));
+  EXPECT_FALSE(has_frame);
+}
+
+TEST(ConvertServer, FrameErrors) {
+  std::string payload;
+  {
+    FramePipe frame_pipe;
+    frame_pipe.Write(absl::StrCat(kMaxFrameSize + 1, "\n"));
+    auto result = ReadFrame(frame_pipe.read_fd(), &payload);
+    EXPECT_TRUE(absl::IsInvalidArgument(result.status()));
+    EXPECT_THAT(result.status().message(),
+                testing::HasSubstr("maximum frame size"));
+  }
+  {
+    FramePipe frame_pipe;
+    frame_pipe.Write("12345678901234567890123\n");
+    EXPECT_TRUE(absl::IsInvalidArgument(
+        ReadFrame(frame_pipe.read_fd(), &payload).status()));
+  }
+  {
+    FramePipe frame_pipe;
+    frame_pipe.Write("abc\n");
+    EXPECT_THAT(ReadFrame(frame_pipe.read_fd(), &payload).status().message(),
+                testing::HasSubstr("Invalid frame length"));
+  }
+  {
+    FramePipe frame_pipe;
+    frame_pipe.Write("10\nabc");
+    frame_pipe.CloseWrite();
+    EXPECT_TRUE(
+        absl::IsDataLoss(ReadFrame(frame_pipe.read_fd(), &payload).status()));
+  }
+}
+
+TEST(ConvertServer, ClientDisconnected) {
+  int fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  ASSERT_OK(WriteFrame(fds[1], "foo: bar\n"));
+  // The client closes the connection before reading its response,
+  // which would raise SIGPIPE on a plain write of the response.
+  ::close(fds[1]);
+  ConvertToolOptions options;
+  options.builtin_path = "nudl/analysis/testing/testdata/nudl_builtins.ndl";
+  options.server_address = "stdio";
+  ConvertServer server(options);
+  const absl::Status serve_status = server.Serve(fds[0], fds[0]);
+  EXPECT_TRUE(absl::IsInternal(serve_status)) << serve_status;
+  EXPECT_THAT(serve_status.message(), testing::HasSubstr("Error writing"));
+  EXPECT_EQ(server.num_requests(), 1);
+  ::close(fds[0]);
+}
+
+TEST(ConvertServer, ProcessRequest) {
+  ConvertToolOptions options;
+  options.builtin_path = "nudl/analysis/testing/testdata/nudl_builtins.ndl";
+  options.server_address = "stdio";
+  ConvertServer server(options);
+  ASSERT_OK(server.Prepare());
+
+  std::string response = server.ProcessRequest(
+      "source: server_test\n\ndef twice(x: Int) : Int => x * 2\n");
+  EXPECT_TRUE(absl::StartsWith(response, "ok\n")) << response;
+  EXPECT_THAT(response, testing::HasSubstr("twice"));
+
+  // The module is replaced by the next source request under its name.
+  response = server.ProcessRequest(
+      "source: server_test\n\ndef thrice(x: Int) : Int => x * 3\n");
+  EXPECT_TRUE(absl::StartsWith(response, "ok\n")) << response;
+  EXPECT_THAT(response, testing::HasSubstr("thrice"));
+  EXPECT_THAT(response, testing::Not(testing::HasSubstr("twice")));
+
+  response = server.ProcessRequest(
+      "source: server_test\n\ndef bad(x: Int) : Int => nope\n");
+  EXPECT_TRUE(absl::StartsWith(response, "error\n")) << response;
+  response = server.ProcessRequest("foo: bar\n");
+  EXPECT_TRUE(absl::StartsWith(response, "error\n")) << response;
+  EXPECT_FALSE(server.is_shutdown());
+
+  EXPECT_EQ(server.ProcessRequest("command: shutdown\n"), "ok\n");
+  EXPECT_TRUE(server.is_shutdown());
+  EXPECT_EQ(server.num_requests(), 5);
+}
+
+}  // namespace nudl
@@ -20,12 +20,15 @@
 #include <iostream>
 #include <utility>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "absl/time/time.h"
 #include "glog/logging.h"
+#include "nudl/analysis/function.h"
 #include "nudl/conversion/pseudo_converter.h"
 #include "nudl/conversion/python_converter.h"
+#include "nudl/grammar/dsl.h"
 #include "nudl/status/status.h"
 
 namespace nudl {
@@ -103,16 +106,19 @@ void IteratePythonFiles(
 ConvertTool::ConvertTool(absl::string_view builtin_path,
                          std::vector<std::string> search_paths,
                          ConvertLang lang, absl::string_view run_yapf,
-                         bool write_only_input, bool bindings_on_use)
+                         bool write_only_input, bool bindings_on_use,
+                         analysis::EnvironmentOptions env_options)
     : builtin_path_(builtin_path),
       search_paths_(std::move(search_paths)),
       converter_(CHECK_NOTNULL(BuildConverter(lang, bindings_on_use))),
       run_yapf_(run_yapf),
-      write_only_input_(write_only_input) {}
+      write_only_input_(write_only_input),
+      env_options_(std::move(env_options)) {}
 
 absl::Status ConvertTool::Prepare() {
   ASSIGN_OR_RETURN(
-      env_, nudl::analysis::Environment::Build(builtin_path_, search_paths_),
+      env_, nudl::analysis::Environment::Build(builtin_path_, search_paths_,
+                                               env_options_),
       _ << "Building environment");
   store_ = env_->module_store();
   return absl::OkStatus();
@@ -123,8 +129,40 @@ void ConvertTool::AddBuiltinModule() {
   modules_.insert(env_->builtin_module());
 }
 
+void ConvertTool::RequireSourceModules(
+    const std::vector<std::string>& module_names) {
+  CHECK(store_ != nullptr) << "Tool not properly prepared.";
+  for (const auto& module_name : module_names) {
+    store_->AddSourceModule(module_name);
+    auto existing = store_->GetModule(module_name);
+    if (!existing.has_value() || !existing.value()->is_interface()) {
+      continue;
+    }
+    // Imported before from its interface, so it needs to be analyzed
+    // again, with the modules that import it.
+    modules_.erase(existing.value());
+    for (const auto& importer : store_->TransitiveImporters(module_name)) {
+      auto importer_module = store_->GetModule(importer);
+      if (importer_module.has_value()) {
+        modules_.erase(importer_module.value());
+      }
+    }
+    store_->InvalidateModule(module_name);
+  }
+}
+
+void ConvertTool::PreparseModules(const std::vector<std::string>& module_names,
+                                  size_t num_threads) {
+  CHECK(store_ != nullptr) << "Tool not properly prepared.";
+  const absl::Time start_time = absl::Now();
+  store_->PreparseModules(module_names, num_threads);
+  std::cout << "Parsed modules on " << num_threads
+            << " threads in: " << (absl::Now() - start_time) << std::endl;
+}
+
 absl::Status ConvertTool::LoadModule(absl::string_view module_name) {
   RET_CHECK(store_ != nullptr) << "Tool not properly prepared.";
+  RequireSourceModules({std::string(module_name)});
   ASSIGN_OR_RETURN(auto module, store_->ImportModule(module_name));
   LOG(INFO) << "Module: " << module->module_name() << " loaded OK" << std::endl;
   modules_.insert(module);
@@ -140,6 +178,22 @@ absl::Status ConvertTool::LoadModuleFromString(
   return absl::OkStatus();
 }
 
+void ConvertTool::ClearLoadedModules() { modules_.clear(); }
+
+absl::StatusOr<std::vector<std::string>> ConvertTool::ReloadChangedModules() {
+  RET_CHECK(store_ != nullptr) << "Tool not properly prepared.";
+  modules_.clear();
+  return store_->ReimportChangedModules();
+}
+
+void ConvertTool::UnloadModule(absl::string_view module_name) {
+  CHECK(store_ != nullptr) << "Tool not properly prepared.";
+  modules_.clear();
+  store_->InvalidateModule(module_name);
+}
+
+analysis::ModuleStore* ConvertTool::module_store() const { return store_; }
+
 absl::Status ConvertTool::WritePythonOutput(
     absl::string_view output_path, absl::string_view py_path,
     bool direct_output,
@@ -148,6 +202,7 @@ absl::Status ConvertTool::WritePythonOutput(
     std::cout << "Skipping file output.";
     return absl::OkStatus();
   }
+  RETURN_IF_ERROR(BuildDeferredBodies());
   std_filesystem::path dest_path(output_path);
   std_filesystem::create_directories(dest_path);
   absl::Status error;
@@ -188,6 +243,7 @@ absl::Status ConvertTool::WritePythonOutput(
 }
 
 absl::Status ConvertTool::WriteConversionToStdout() {
+  RETURN_IF_ERROR(BuildDeferredBodies());
   absl::Status error;
   IterateModules([this, &error](analysis::Module* module) {
     auto convert_result = converter_->ConvertModule(module);
@@ -207,6 +263,7 @@ absl::Status ConvertTool::WriteConversionToStdout() {
 
 absl::StatusOr<std::string> ConvertTool::ConvertToString() {
   RET_CHECK(write_only_input_);
+  RETURN_IF_ERROR(BuildDeferredBodies());
   absl::Status error;
   std::string result;
   IterateModules([this, &result, &error](analysis::Module* module) {
@@ -233,6 +290,37 @@ void ConvertTool::WriteTimingInfoToStdout() {
               << "`:  parse: " << module->parse_duration()
               << ", analysis: " << module->analysis_duration() << std::endl;
   });
+  const auto& stats = env_->builtin_module()->type_store()->name_cache_stats();
+  std::cout << "Type name cache:" << std::endl
+            << "  parse: " << stats.parse_hits << " hits / "
+            << stats.parse_misses << " misses" << std::endl
+            << "  find: " << stats.find_hits << " hits / " << stats.find_misses
+            << " misses, invalidations: " << stats.invalidations
+            << std::endl;
+  const auto signature_stats = analysis::FunctionGroup::signature_cache_stats();
+  std::cout << "Function signature cache: " << signature_stats.hits
+            << " hits / " << signature_stats.misses << " misses, "
+            << signature_stats.uncacheable << " uncacheable, invalidations: "
+            << signature_stats.invalidations << std::endl;
+  const auto bound_stats =
+      env_->builtin_module()->type_store()->bound_type_stats();
+  std::cout << "Bound types: " << bound_stats.hits << " reused / "
+            << bound_stats.misses << " built" << std::endl;
+  const auto relation_stats = analysis::TypeSpec::relation_cache_stats();
+  std::cout << "Type relation cache: " << relation_stats.hits << " hits / "
+            << relation_stats.misses << " misses, dropped: "
+            << relation_stats.dropped << std::endl;
+  if (env_->module_store()->use_arena()) {
+    const auto arena_stats = analysis::AnalysisArena::stats();
+    std::cout << "Analysis arenas: " << arena_stats.num_arenas << " with "
+              << arena_stats.allocated_bytes << " bytes in "
+              << arena_stats.num_blocks << " blocks" << std::endl;
+  }
+  const auto parse_cache = env_->module_store()->parse_cache();
+  if (parse_cache) {
+    std::cout << "Parse cache: " << parse_cache->hits() << " hits / "
+              << parse_cache->misses() << " misses" << std::endl;
+  }
 }
 
 void ConvertTool::PythonPreparePath(const std_filesystem::path& file_path,
@@ -289,24 +377,158 @@ void ConvertTool::IterateModules(
   }
 }
 
-absl::Status RunConvertTool(const ConvertToolOptions& options) {
-  RET_CHECK(!options.builtin_path.empty()) << "Please specify builtin_path";
+absl::Status ConvertTool::BuildDeferredBodies() {
+  absl::Status error;
+  IterateModules([&error](analysis::Module* module) {
+    status::UpdateOrAnnotate(error, module->BuildDeferredBodies());
+  });
+  return error;
+}
+
+std::unique_ptr<ConvertTool> BuildConvertTool(const ConvertToolOptions& options,
+                                              bool write_only_input) {
   std::vector<std::string> search_paths = options.imports;
-  std::vector<std::string> base_dirs = options.imports;
   std::copy(options.search_paths.begin(), options.search_paths.end(),
             std::back_inserter(search_paths));
-  ConvertTool tool(options.builtin_path, std::move(search_paths), options.lang,
-                   options.run_yapf, options.write_only_input,
-                   options.bindings_on_use);
+  return std::make_unique<ConvertTool>(
+      options.builtin_path, std::move(search_paths), options.lang,
+      options.run_yapf, write_only_input, options.bindings_on_use,
+      analysis::EnvironmentOptions{
+          options.parse_cache_dir, options.lazy_function_bodies,
+          options.interface_dir, true, options.builtin_snapshot});
+}
+
+absl::Status ValidateConvertToolOptions(const ConvertToolOptions& options) {
+  RET_CHECK(!options.builtin_path.empty()) << "Please specify builtin_path";
+  // The imported modules are not converted from their interfaces, so
+  // the new bindings of their generic functions need to be converted
+  // in the importing modules, from the bodies kept in the interfaces.
+  if (!options.interface_dir.empty() && !options.bindings_on_use) {
+    return status::InvalidArgumentErrorBuilder()
+           << "Module interfaces can be used only with bindings_on_use, "
+              "as the imported modules are not converted again";
+  }
+  // Without write_only_input, all imported modules are converted,
+  // so they cannot come from their interfaces.
+  if (!options.interface_dir.empty() && !options.write_only_input &&
+      options.server_address.empty()) {
+    return status::InvalidArgumentErrorBuilder()
+           << "Module interfaces can be used only with write_only_input, "
+              "or in server mode, as otherwise all the imported modules "
+              "are converted";
+  }
+  // Each module is analyzed in an environment of its own, which imports
+  // the modules analyzed before it from their interfaces.
+  if (options.num_analysis_threads > 1 && options.interface_dir.empty()) {
+    return status::InvalidArgumentErrorBuilder()
+           << "Parallel analysis requires an interface_dir, for importing "
+              "the modules analyzed in other environments";
+  }
+  if (options.num_analysis_threads > 1 &&
+      (options.output_dir.empty() || options.lang != ConvertLang::PYTHON)) {
+    return status::InvalidArgumentErrorBuilder()
+           << "Parallel analysis requires python output to an output_dir, "
+              "as each module is converted in its own environment";
+  }
+  return absl::OkStatus();
+}
+
+namespace {
+// Analyzes a module in an environment of its own, in which the modules
+// it imports come from their interfaces, and converts it if it is one
+// of the input modules. The other modules are analyzed just for their
+// interfaces, as needed by the modules importing them.
+absl::Status ConvertInOwnEnvironment(
+    const ConvertToolOptions& options, const std::string& module_name,
+    bool is_input,
+    std::unique_ptr<analysis::ModuleStore::PreparsedModule> preparsed,
+    const absl::flat_hash_map<std::string, std::string>& output_dirs) {
+  auto tool = BuildConvertTool(options, true);
+  RETURN_IF_ERROR(tool->Prepare())
+      << "Preparing environment for module: " << module_name;
+  if (preparsed) {
+    tool->module_store()->AddPreparsedModule(module_name, std::move(preparsed));
+  }
+  if (!is_input) {
+    return tool->module_store()->ImportModuleInterface(module_name).status();
+  }
+  RETURN_IF_ERROR(tool->LoadModule(module_name))
+      << "Loading module: " << module_name;
+  return tool->WritePythonOutput(options.output_dir, "", options.direct_output,
+                                 output_dirs);
+}
+
+// Analyzes and converts the input modules on options.num_analysis_threads
+// threads. The input modules and the modules they import are processed
+// by levels of their import graph, each level after the interfaces of
+// the previous ones were written, and each module in an environment of
+// its own. So the analysis of a module does not depend on the other
+// modules analyzed at the same time, or on the thread that runs it.
+absl::Status ConvertInParallel(
+    const ConvertToolOptions& options,
+    const std::vector<std::string>& module_names,
+    const absl::flat_hash_map<std::string, std::string>& output_dirs,
+    ConvertTool* tool) {
+  tool->PreparseModules(module_names, std::max(options.num_parse_threads,
+                                               options.num_analysis_threads));
+  analysis::ModuleStore* store = tool->module_store();
+  ASSIGN_OR_RETURN(auto levels, store->PreparsedImportLevels(module_names));
+  const absl::flat_hash_set<std::string> input_modules(module_names.begin(),
+                                                       module_names.end());
+  for (size_t level_index = 0; level_index < levels.size(); ++level_index) {
+    const std::vector<std::string>& level = levels[level_index];
+    const absl::Time start_time = absl::Now();
+    std::vector<std::unique_ptr<analysis::ModuleStore::PreparsedModule>>
+        preparsed;
+    for (const auto& module_name : level) {
+      preparsed.emplace_back(store->ReleasePreparsedModule(module_name));
+    }
+    std::vector<absl::Status> statuses(level.size());
+    analysis::ParallelFor(
+        level.size(), options.num_analysis_threads,
+        [&options, &level, &input_modules, &preparsed, &output_dirs,
+         &statuses](size_t index) {
+          statuses[index] = ConvertInOwnEnvironment(
+              options, level[index], input_modules.contains(level[index]),
+              std::move(preparsed[index]), output_dirs);
+        });
+    absl::Status error;
+    for (const auto& module_status : statuses) {
+      status::UpdateOrAnnotate(error, module_status);
+    }
+    RETURN_IF_ERROR(error);
+    std::cout << "Analyzed import level " << level_index << " with "
+              << level.size() << " modules on "
+              << std::min(options.num_analysis_threads, level.size())
+              << " threads in: " << (absl::Now() - start_time) << std::endl;
+  }
+  return absl::OkStatus();
+}
+}  // namespace
+
+absl::Status RunConvertTool(const ConvertToolOptions& options) {
+  RETURN_IF_ERROR(ValidateConvertToolOptions(options));
+  if (!options.write_builtin_snapshot.empty()) {
+    RETURN_IF_ERROR(analysis::Environment::WriteBuiltinSnapshot(
+        options.builtin_path, options.write_builtin_snapshot))
+        << "Writing builtin snapshot";
+    std::cout << "Written builtin snapshot: " << options.write_builtin_snapshot
+              << std::endl;
+    return absl::OkStatus();
+  }
+  const std::vector<std::string>& base_dirs = options.imports;
+  auto tool_ptr = BuildConvertTool(options, options.write_only_input);
+  ConvertTool& tool = *tool_ptr;
   RETURN_IF_ERROR(tool.Prepare()) << "Preparing environment";
+  std::vector<std::string> module_names;
   if (!options.input_module.empty()) {
-    RETURN_IF_ERROR(tool.LoadModule(options.input_module))
-        << "Loading module: " << options.input_module;
+    module_names.emplace_back(options.input_module);
   }
   absl::flat_hash_map<std::string, std::string> output_dirs;
+  bool add_builtin_module = false;
   for (const auto& input_file : options.input_paths) {
     if (input_file == options.builtin_path) {
-      tool.AddBuiltinModule();
+      add_builtin_module = true;
       continue;
     }
     std::string ifile = input_file;
@@ -331,6 +553,25 @@ absl::Status RunConvertTool(const ConvertToolOptions& options) {
     }
     std::cout << "Loading: `" << module_name << "` from: `" << input_file << "`"
               << std::endl;
+    module_names.emplace_back(std::move(module_name));
+  }
+  if (add_builtin_module) {
+    tool.AddBuiltinModule();
+  }
+  if (options.num_analysis_threads > 1) {
+    RETURN_IF_ERROR(
+        ConvertInParallel(options, module_names, output_dirs, &tool));
+    // Writes the builtin module, if requested, and the python library.
+    RETURN_IF_ERROR(tool.WritePythonOutput(options.output_dir, options.py_path,
+                                           options.direct_output, output_dirs));
+    tool.WriteTimingInfoToStdout();
+    return absl::OkStatus();
+  }
+  tool.RequireSourceModules(module_names);
+  if (options.num_parse_threads > 1) {
+    tool.PreparseModules(module_names, options.num_parse_threads);
+  }
+  for (const auto& module_name : module_names) {
     RETURN_IF_ERROR(tool.LoadModule(module_name))
         << "Loading module: " << module_name;
   }
@@ -344,30 +585,59 @@ absl::Status RunConvertTool(const ConvertToolOptions& options) {
   return absl::OkStatus();
 }
 
-std::string ConvertPythonSource(
-    const std::string& module_name,
-    const std::string& code,
-    const std::string& builtin_path,
-    const std::vector<std::string>& search_paths,
+ConvertSession::ConvertSession(const std::string& builtin_path,
+                               const std::vector<std::string>& search_paths)
+    : tool_(builtin_path, search_paths, ConvertLang::PYTHON, "", true, true),
+      prepare_status_(tool_.Prepare()) {
+  // A failure is logged, and only leaves the first parses slower.
+  grammar::WarmUpParser().IgnoreError();
+}
+
+std::string ConvertSession::ConvertPythonSource(
+    const std::string& module_name, const std::string& code,
     std::vector<std::string>* errors) {
-  ConvertTool tool(builtin_path, search_paths, ConvertLang::PYTHON,
-                   "", true, true);
-  auto prepare_status = tool.Prepare();
-  if (!prepare_status.ok()) {
-    errors->emplace_back(prepare_status.message());
-    ErrorLines(prepare_status, errors);
+  if (!prepare_status_.ok()) {
+    errors->emplace_back(prepare_status_.message());
+    ErrorLines(prepare_status_, errors);
     return "";
   }
-  auto status = tool.LoadModuleFromString(module_name, code);
+  // Errors in the changed modules are reported by the snippets that
+  // import them.
+  auto reload_result = tool_.ReloadChangedModules();
+  if (!reload_result.ok()) {
+    LOG(WARNING) << "Reloading changed modules: " << reload_result.status();
+  }
+  tool_.UnloadModule(module_name);
+  std::string result;
+  auto status = tool_.LoadModuleFromString(module_name, code);
   if (!status.ok()) {
     ErrorLines(status, errors);
-    return "";
-  }
-  auto convert_result = tool.ConvertToString();
-  if (!convert_result.ok()) {
-    errors->emplace_back(convert_result.status().message());
+  } else {
+    auto convert_result = tool_.ConvertToString();
+    if (convert_result.ok()) {
+      result = std::move(convert_result).value();
+    } else {
+      errors->emplace_back(convert_result.status().message());
+    }
   }
-  return std::move(convert_result).value();
+  // Drops the snippet module, with the bindings on its types.
+  tool_.UnloadModule(module_name);
+  return result;
+}
+
+size_t ConvertSession::num_modules() const {
+  const analysis::ModuleStore* store = tool_.module_store();
+  return store ? store->modules().size() : 0;
+}
+
+std::string ConvertPythonSource(
+    const std::string& module_name,
+    const std::string& code,
+    const std::string& builtin_path,
+    const std::vector<std::string>& search_paths,
+    std::vector<std::string>* errors) {
+  return ConvertSession(builtin_path, search_paths)
+      .ConvertPythonSource(module_name, code, errors);
 }
 
 
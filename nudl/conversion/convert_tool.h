@@ -47,9 +47,17 @@ class ConvertTool {
   ConvertTool(absl::string_view builtin_path,
               std::vector<std::string> search_paths, ConvertLang lang,
               absl::string_view run_yapf, bool write_only_input,
-              bool bindings_on_use);
+              bool bindings_on_use,
+              analysis::EnvironmentOptions env_options = {});
   absl::Status Prepare();
   void AddBuiltinModule();
+  // Makes sure that the provided modules are analyzed from source, and
+  // not from their interfaces, as these need to be converted.
+  void RequireSourceModules(const std::vector<std::string>& module_names);
+  // Reads and parses the provided modules and their imports on
+  // num_threads threads, ahead of loading them with LoadModule.
+  void PreparseModules(const std::vector<std::string>& module_names,
+                       size_t num_threads);
   absl::Status LoadModule(absl::string_view module_name);
   absl::Status LoadModuleFromString(absl::string_view module_name,
                                     absl::string_view code);
@@ -60,6 +68,17 @@ class ConvertTool {
   absl::Status WriteConversionToStdout();
   void WriteTimingInfoToStdout();
   absl::StatusOr<std::string> ConvertToString();
+  // Clears the set of modules to be converted. The modules remain
+  // loaded and analyzed in the environment, for future imports.
+  void ClearLoadedModules();
+  // Re-analyzes the loaded modules whose source changed, together with
+  // the modules that import them. Returns the re-analyzed module names.
+  absl::StatusOr<std::vector<std::string>> ReloadChangedModules();
+  // Drops a module and its importers from the environment, if loaded,
+  // so they are analyzed again on their next load.
+  void UnloadModule(absl::string_view module_name);
+  // The store of the modules analyzed in the environment.
+  analysis::ModuleStore* module_store() const;
 
  private:
   static void PythonPreparePath(const std_filesystem::path& file_path,
@@ -68,6 +87,10 @@ class ConvertTool {
                                 const std::string& content);
   absl::Status RunYapf(const std_filesystem::path& file_path) const;
   void IterateModules(std::function<void(analysis::Module*)> runner);
+  // Builds the deferred function bodies of the modules to convert, as
+  // these may bind new instances of functions in any module. Needs to
+  // run before any module is converted.
+  absl::Status BuildDeferredBodies();
 
   const std::string builtin_path_;
   const std::vector<std::string> search_paths_;
@@ -77,6 +100,7 @@ class ConvertTool {
   analysis::ModuleStore* store_ = nullptr;
   absl::flat_hash_set<analysis::Module*> modules_;
   const bool write_only_input_;
+  const analysis::EnvironmentOptions env_options_;
 };
 
 struct ConvertToolOptions {
@@ -112,12 +136,78 @@ struct ConvertToolOptions {
   bool direct_output = false;
   // Language to convert to:
   ConvertLang lang = ConvertLang::PYTHON;
+  // If not empty, cache the parsed modules in this directory.
+  std::string parse_cache_dir;
+  // Number of threads for reading and parsing the modules to convert
+  // and their imports, before analysis. If 1, modules are parsed
+  // on demand, at import time.
+  size_t num_parse_threads = 1;
+  // If true, analyze the bodies of fully typed functions only when
+  // called, or when converting their module.
+  bool lazy_function_bodies = false;
+  // If not empty, write the module interfaces (.ndli files) to this
+  // directory, and import the unchanged modules from these. Requires
+  // bindings_on_use, and write_only_input or a server_address.
+  std::string interface_dir;
+  // If not empty, run as a conversion server on this address, instead
+  // of converting the input modules. See convert_server.h.
+  std::string server_address;
+  // If not empty, use this snapshot of the builtin module, as written
+  // with write_builtin_snapshot.
+  std::string builtin_snapshot;
+  // If not empty, just write the snapshot of the analyzed builtin module
+  // to this path, with no other conversion.
+  std::string write_builtin_snapshot;
+  // If more than 1, the input modules and the modules they import are
+  // analyzed on this many threads, level by level in their import graph.
+  // Each module is analyzed and converted in an environment of its own,
+  // which imports the other modules from their interfaces, so the output
+  // does not depend on the scheduling. Requires interface_dir and
+  // output_dir.
+  size_t num_analysis_threads = 1;
 };
 
+// Builds the conversion tool for the provided options. Still needs
+// to be Prepare()-d.
+std::unique_ptr<ConvertTool> BuildConvertTool(const ConvertToolOptions& options,
+                                              bool write_only_input);
+
+// Checks the options for settings that cannot be used together.
+absl::Status ValidateConvertToolOptions(const ConvertToolOptions& options);
+
 absl::Status RunConvertTool(const ConvertToolOptions& options);
 
+// Keeps a prepared environment between conversions of Nudl snippets
+// to python, so the builtin module and the imported library modules
+// are parsed and analyzed only once, and each conversion analyzes
+// just the snippet module. The library modules whose source changed
+// are analyzed again before each conversion, and the snippet module
+// is dropped after it, so the session does not grow with the number
+// of converted snippets. This is to be wrapped in Cython.
+class ConvertSession {
+ public:
+  ConvertSession(const std::string& builtin_path,
+                 const std::vector<std::string>& search_paths);
+
+  // Converts the code of a module named module_name to python.
+  // If errors occur, we place them in errors, and return an empty
+  // string.
+  std::string ConvertPythonSource(const std::string& module_name,
+                                  const std::string& code,
+                                  std::vector<std::string>* errors);
+
+  // Number of modules kept analyzed in the session, besides the
+  // builtin module.
+  size_t num_modules() const;
+
+ private:
+  ConvertTool tool_;
+  absl::Status prepare_status_;
+};
+
 // This conversion function is to be wrapped in Cython for ad-hoc
-// conversion of Nudl snippets.
+// conversion of Nudl snippets. Prefer ConvertSession for converting
+// more than one snippet.
 // If errors occur, we place them in errors, and return an empty
 // string.
 std::string ConvertPythonSource(
@@ -0,0 +1,205 @@
+//
+// Copyright 2022 Nuna inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "nudl/conversion/convert_tool.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "nudl/status/testing.h"
+
+namespace nudl {
+
+namespace {
+void WriteModule(const std_filesystem::path& path, const std::string& code) {
+  std::ofstream(path, std::ios::out | std::ios::trunc) << code;
+}
+}  // namespace
+
+TEST(ConvertSession, SnippetsAreUnloaded) {
+  const std_filesystem::path lib_dir =
+      std_filesystem::path(testing::TempDir()) / "convert_session";
+  std_filesystem::remove_all(lib_dir);
+  std_filesystem::create_directories(lib_dir);
+  WriteModule(lib_dir / "session_lib.ndl",
+              "def lib_value(x: Int) : Int => x + 1\n");
+  ConvertSession session("nudl/analysis/testing/testdata/nudl_builtins.ndl",
+                         {lib_dir.native()});
+  std::vector<std::string> errors;
+  std::string result = session.ConvertPythonSource(
+      "snippet_0", "import session_lib\nx = session_lib.lib_value(1)\n",
+      &errors);
+  ASSERT_TRUE(errors.empty()) << errors.front();
+  EXPECT_THAT(result, testing::HasSubstr("lib_value"));
+  // Only the library module is kept.
+  const size_t num_modules = session.num_modules();
+  EXPECT_EQ(num_modules, 1);
+  for (size_t i = 1; i < 10; ++i) {
+    result = session.ConvertPythonSource(
+        absl::StrCat("snippet_", i),
+        absl::StrCat("import session_lib\ny = session_lib.lib_value(", i,
+                     ")\n"),
+        &errors);
+    ASSERT_TRUE(errors.empty()) << errors.front();
+    EXPECT_THAT(result, testing::HasSubstr("lib_value"));
+    EXPECT_EQ(session.num_modules(), num_modules);
+  }
+  // Failed snippets are dropped as well, and names can be reused.
+  result = session.ConvertPythonSource("snippet_0", "x = nope\n", &errors);
+  EXPECT_TRUE(result.empty());
+  EXPECT_FALSE(errors.empty());
+  EXPECT_EQ(session.num_modules(), num_modules);
+
+  // Edits to the library are picked up by the next conversion.
+  WriteModule(lib_dir / "session_lib.ndl",
+              "def lib_value(x: Int) : Int => x + 1\n"
+              "def lib_other(x: Int) : Int => x + 2\n");
+  errors.clear();
+  result = session.ConvertPythonSource(
+      "snippet_0", "import session_lib\nz = session_lib.lib_other(1)\n",
+      &errors);
+  ASSERT_TRUE(errors.empty()) << errors.front();
+  EXPECT_THAT(result, testing::HasSubstr("lib_other"));
+  EXPECT_EQ(session.num_modules(), num_modules);
+}
+
+TEST(ConvertTool, GenericCallThroughInterface) {
+  const std_filesystem::path base_dir =
+      std_filesystem::path(testing::TempDir()) / "convert_interface";
+  std_filesystem::remove_all(base_dir);
+  const std_filesystem::path src_dir = base_dir / "src";
+  const std_filesystem::path interface_dir = base_dir / "interfaces";
+  std_filesystem::create_directories(src_dir);
+  WriteModule(src_dir / "iface_conv_lib.ndl",
+              "def typed(x: Int) : Int => x * 2\n"
+              "def generic(x: {T: Numeric}) => x + x\n");
+  WriteModule(src_dir / "iface_conv_main.ndl",
+              "import iface_conv_lib\n"
+              "y = iface_conv_lib.typed(2) + iface_conv_lib.generic(3)\n");
+  ConvertToolOptions options;
+  options.builtin_path = "nudl/analysis/testing/testdata/nudl_builtins.ndl";
+  options.search_paths = {src_dir.native()};
+  options.write_only_input = true;
+  options.bindings_on_use = true;
+  options.interface_dir = interface_dir.native();
+  ASSERT_OK(ValidateConvertToolOptions(options));
+
+  // Converting the library from source writes its interface.
+  auto lib_tool = BuildConvertTool(options, true);
+  ASSERT_OK(lib_tool->Prepare());
+  ASSERT_OK(lib_tool->LoadModule("iface_conv_lib"));
+  ASSERT_OK_AND_ASSIGN(std::string lib_code, lib_tool->ConvertToString());
+  EXPECT_THAT(lib_code, testing::HasSubstr("def typed("));
+  EXPECT_TRUE(std_filesystem::exists(interface_dir / "iface_conv_lib.ndli"));
+
+  // The importer analyzes the library from its interface, converts the
+  // new binding of the generic function, and calls the typed function
+  // in the library module.
+  auto main_tool = BuildConvertTool(options, true);
+  ASSERT_OK(main_tool->Prepare());
+  ASSERT_OK(main_tool->LoadModule("iface_conv_main"));
+  EXPECT_TRUE(main_tool->module_store()
+                  ->GetModule("iface_conv_lib")
+                  .value()
+                  ->is_interface());
+  ASSERT_OK_AND_ASSIGN(std::string main_code, main_tool->ConvertToString());
+  EXPECT_THAT(main_code, testing::HasSubstr("def iface_conv_lib__generic"));
+  EXPECT_THAT(main_code, testing::HasSubstr("iface_conv_lib.typed("));
+  EXPECT_THAT(main_code, testing::HasSubstr("import iface_conv_lib"));
+
+  // Interfaces need the bindings to be converted on use.
+  options.bindings_on_use = false;
+  EXPECT_THAT(ValidateConvertToolOptions(options).message(),
+              testing::HasSubstr("bindings_on_use"));
+}
+
+TEST(ConvertTool, ParallelAnalysis) {
+  const std_filesystem::path base_dir =
+      std_filesystem::path(testing::TempDir()) / "convert_parallel";
+  std_filesystem::remove_all(base_dir);
+  const std_filesystem::path src_dir = base_dir / "src";
+  std_filesystem::create_directories(src_dir);
+  WriteModule(src_dir / "par_lib.ndl",
+              "def twice(x: {T: Numeric}) => x + x\n"
+              "def typed(x: Int) : Int => twice(x)\n");
+  WriteModule(src_dir / "par_left.ndl",
+              "import par_lib\n"
+              "def left(x: Int) : Int => par_lib.twice(x)\n");
+  WriteModule(src_dir / "par_right.ndl",
+              "import par_lib\n"
+              "def right(x: Float64) : Float64 => par_lib.twice(x)\n");
+  WriteModule(src_dir / "par_main.ndl",
+              "import par_lib\n"
+              "import par_left\n"
+              "import par_right\n"
+              "y = par_left.left(2) + par_lib.typed(3)\n"
+              "z = par_right.right(1.5)\n");
+  ConvertToolOptions options;
+  options.builtin_path = "nudl/analysis/testing/testdata/nudl_builtins.ndl";
+  options.search_paths = {src_dir.native()};
+  options.imports = {src_dir.native()};
+  // par_lib is not an input, so it is analyzed just for its interface.
+  for (const char* name : {"par_main", "par_left", "par_right"}) {
+    options.input_paths.emplace_back(
+        (src_dir / absl::StrCat(name, ".ndl")).native());
+  }
+  options.write_only_input = true;
+  options.bindings_on_use = true;
+  options.direct_output = true;
+  auto convert = [&options, &base_dir](size_t num_threads)
+      -> absl::StatusOr<std::vector<std::string>> {
+    const std::string run_name = absl::StrCat("run_", num_threads);
+    options.num_analysis_threads = num_threads;
+    options.interface_dir = (base_dir / run_name / "interfaces").native();
+    options.output_dir = (base_dir / run_name / "output").native();
+    auto run_status = RunConvertTool(options);
+    if (!run_status.ok()) {
+      return run_status;
+    }
+    std::vector<std::string> outputs;
+    for (const char* name : {"par_main", "par_left", "par_right"}) {
+      std::ifstream infile(std_filesystem::path(options.output_dir) /
+                           absl::StrCat(name, ".py"));
+      outputs.emplace_back(std::istreambuf_iterator<char>(infile),
+                           std::istreambuf_iterator<char>());
+    }
+    return outputs;
+  };
+  ASSERT_OK_AND_ASSIGN(auto outputs, convert(4));
+  EXPECT_THAT(outputs[0], testing::HasSubstr("par_left.left("));
+  EXPECT_THAT(outputs[1], testing::HasSubstr("def left("));
+  EXPECT_THAT(outputs[2], testing::HasSubstr("def right("));
+  // The library module gets an interface, but is not converted.
+  EXPECT_TRUE(std_filesystem::exists(base_dir / "run_4" / "interfaces" /
+                                     "par_lib.ndli"));
+  EXPECT_FALSE(
+      std_filesystem::exists(base_dir / "run_4" / "output" / "par_lib.py"));
+  // The output does not depend on the number of threads.
+  ASSERT_OK_AND_ASSIGN(auto outputs_2, convert(2));
+  EXPECT_EQ(outputs, outputs_2);
+
+  // Each module is analyzed with the others from their interfaces.
+  options.interface_dir.clear();
+  EXPECT_THAT(ValidateConvertToolOptions(options).message(),
+              testing::HasSubstr("interface_dir"));
+}
+
+}  // namespace nudl
@@ -257,12 +257,11 @@ std::string scope_name(const analysis::ScopeName& name,
   if (name.empty()) {
     return "";
   }
-  std::vector<std::string> names;
+  std::vector<std::string> names(name.module_names());
   names.reserve(name.size() + 1);
-  std::copy(name.module_names().begin(), name.module_names().end(),
-            std::back_inserter(names));
-  std::copy(name.function_names().begin(), name.function_names().end(),
-            std::back_inserter(names));
+  for (auto& function_name : name.function_names()) {
+    names.emplace_back(std::move(function_name));
+  }
   return absl::StrCat(absl::StrJoin(names, "."), (with_final_dot ? "." : ""));
 }
 
@@ -452,7 +451,7 @@ std::string PythonConverter::GetStructTypeName(
         || !type_spec->local_name().empty()) {
       return "typing.Any";
     }
-    if (!type_spec->scope_name().module_names().empty()) {
+    if (type_spec->scope_name().num_module_names() > 0) {
       state->add_import(absl::StrCat(
           "import ", PythonSafeName(type_spec->scope_name().module_name(),
                                     type_spec->definition_scope())));
@@ -1575,6 +1574,14 @@ absl::StatusOr<bool> PythonConverter::ConvertFunction(
     analysis::Function* fun, bool is_on_use, ConvertState* state) const {
   const bool is_lambda = fun->kind() == pb::ObjectKind::OBJ_LAMBDA;
   auto bstate = static_cast<PythonConvertState*>(state);
+  if (fun->body_elided()) {
+    if (bindings_on_use_ && is_on_use) {
+      return true;  // Called from its module, see LocalFunctionName.
+    }
+    return status::FailedPreconditionErrorBuilder()
+           << "Cannot convert function: " << fun->full_name()
+           << ", imported from its module interface, without its body";
+  }
   if (!fun->is_native() && fun->expressions().empty()) {
     if (bindings_on_use_) {
       RET_CHECK(!is_on_use) << stacktrace::ToString();
@@ -1688,6 +1695,19 @@ absl::StatusOr<std::string> PythonConverter::LocalFunctionName(
     return status::InvalidArgumentErrorBuilder()
            << "Cannot call abstract function: " << fun->name();
   }
+  if (fun->body_elided()) {
+    // Imported from a module interface, so it cannot be converted here,
+    // but it has a complete signature, so it is converted in its module,
+    // which is converted from source on its own.
+    analysis::Function* module_fun = fun->binding_parent().value_or(fun);
+    analysis::Scope* module = module_fun->module_scope();
+    const std::string module_name(
+        PythonSafeName(scope_name(module->scope_name()), module));
+    static_cast<PythonConvertState*>(state)->add_import(
+        absl::StrCat("import ", module_name));
+    return absl::StrCat(module_name, ".",
+                        PythonSafeName(module_fun->call_name(), module_fun));
+  }
   if (is_on_use) {
     RETURN_IF_ERROR(ConvertFunction(fun, true, state).status());
   }
@@ -72,12 +72,36 @@ absl::Status ParseDataBase::ParseInternal(absl::string_view code_arg,
       parser->setTrace(true);
     }
     parser->removeErrorListeners();
+    bool parsed = false;
+    if (!options.full_ll_prediction) {
+      // The SLL prediction is faster, and enough for most inputs. On the
+      // first syntax error we bail out, and parse again with full LL
+      // prediction, which also properly reports the errors.
+      parser->getInterpreter<antlr4::atn::ParserATNSimulator>()
+          ->setPredictionMode(antlr4::atn::PredictionMode::SLL);
+      parser->setErrorHandler(std::make_shared<antlr4::BailErrorStrategy>());
+      try {
+        tree = CreateTree();
+        parsed = true;
+      } catch (const antlr4::ParseCancellationException& e) {
+        parser->reset();
+        parser->setErrorHandler(
+            std::make_shared<antlr4::DefaultErrorStrategy>());
+        parser->getInterpreter<antlr4::atn::ParserATNSimulator>()
+            ->setPredictionMode(antlr4::atn::PredictionMode::LL);
+        if (options.debug_trace) {
+          parser->setTrace(true);
+        }
+      }
+    }
     VectorSaveErrorListener listener(&errors, code);
     parser->addErrorListener(&listener);
-    try {
-      tree = CreateTree();
-    } catch (const antlr4::RecognitionException& e) {
-      errors.emplace_back(ErrorInfo::FromException(e, code));
+    if (!parsed) {
+      try {
+        tree = CreateTree();
+      } catch (const antlr4::RecognitionException& e) {
+        errors.emplace_back(ErrorInfo::FromException(e, code));
+      }
     }
     lexer->removeErrorListeners();
     parser->removeErrorListeners();
@@ -89,10 +113,11 @@ absl::Status ParseDataBase::ParseInternal(absl::string_view code_arg,
       if (!options.no_intervals) {
         visitor_code = code;
       }
-      auto visitor = BuildVisitor(
+      auto builder = CreateTreeBuilder(
           parser.get(), code,
-          VisitorOptions{options.no_intervals, options.no_interval_positions});
-      Visit(visitor.get());
+          VisitorOptions{options.no_intervals, options.no_interval_positions,
+                         options.no_code_snippets});
+      Build(builder.get());
     }
   } catch (const antlr4::ParseCancellationException& e) {
     return absl::InternalError(absl::StrCat("ANTLR4 ParseCancel: ", e.what()));
@@ -147,6 +172,56 @@ absl::StatusOr<std::unique_ptr<pb::TypeSpec>> ParseTypeSpec(
   return ParseProto<TypeSpecParseData, pb::TypeSpec>(code, options, errors);
 }
 
+absl::Status WarmUpParser() {
+  static constexpr absl::string_view kWarmUpCode = R"(
+import foo.bar
+import baz = qux.quux
+param x: Int = 20
+typedef IntArray = Array<Int>
+schema Coding = {
+  system: Nullable<String> [ name = "system" ];
+  values: Array<Map<String, Tuple<Int, Float>>>;
+}
+def method sum_lens(l: Iterable<Container<{X}>>) : Int =>
+  l.map(len).sum()
+def compute(a: Int, b = 3, c: Float = 1.5) => {
+  pragma log_expression { a }
+  y = a * b + c / 2 - a % 3 + -a;
+  z = [1, 2u, 0x3, 0x4u, 5.0, 6.0f];
+  e = [];
+  m = ["a": b"b", "c": null];
+  t = {w = true, v: Bool = false and not x or y xor z};
+  if (a < b and a in z and a between (b, c)) {
+    return a << 2 >> 1 & 3 | 4 ^ 5
+  } elif (a >= b or a != c) {
+    yield a[0].foo(b=a, c)
+  } else {
+    pass
+  }
+  with (Coding()) { (x, y: Int) : Int => x + y }
+  return (a > b) ? (a, b);
+}
+def native_example(x: Int) : Int =>
+[[pyinline]]${x} + 1[[end]]
+)";
+  // A failing snippet warms up only the error paths, so this is reported
+  // to the callers, and fails the debug builds.
+  static const absl::Status* const kWarmUpStatus = [] {
+    ParseOptions options;
+    options.no_code_snippets = true;
+    auto result = ModuleParseData::Parse(kWarmUpCode, options);
+    absl::Status status = result.status();
+    if (status.ok() && !(*result)->errors.empty()) {
+      status = absl::InternalError(
+          absl::StrCat("Parser warm up code has errors: ",
+                       (*result)->errors.front().ToString()));
+    }
+    LOG_IF(DFATAL, !status.ok()) << "Parser warm up failed: " << status;
+    return new absl::Status(std::move(status));
+  }();
+  return *kWarmUpStatus;
+}
+
 }  // namespace grammar
 
 absl::Status& MergeErrorStatus(const absl::Status& src,
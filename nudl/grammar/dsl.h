@@ -24,9 +24,9 @@
 
 #include "NudlDslLexer.h"
 #include "NudlDslParser.h"
-#include "NudlDslParserVisitor.h"
 #include "absl/status/statusor.h"
 #include "antlr4-runtime.h"  // NOLINT
+#include "nudl/grammar/tree_builder.h"
 #include "nudl/grammar/tree_util.h"
 #include "nudl/status/status.h"
 
@@ -42,6 +42,14 @@ struct ParseOptions {
   bool debug_tokens = false;
   // Trace the antlr parse process.
   bool debug_trace = false;
+  // Keep just the code intervals, without copying the code of each
+  // element and expression in the parsed proto. The code can be
+  // obtained from the source, with TreeUtil::CodeSnippet, as needed.
+  bool no_code_snippets = false;
+  // Parse directly with the full LL prediction of antlr. By default we
+  // first try the faster SLL prediction, and parse again with full LL
+  // only if the first attempt fails.
+  bool full_ll_prediction = false;
 };
 
 struct ParseDataBase {
@@ -68,7 +76,7 @@ struct ParseDataBase {
   absl::Status ParseInternal(absl::string_view code_arg, ParseOptions options);
 
   virtual antlr4::tree::ParseTree* CreateTree() = 0;
-  virtual void Visit(NudlDslParserVisitor* visitor) = 0;
+  virtual void Build(TreeBuilder* builder) = 0;
 };
 
 template <class Proto, antlr4::tree::ParseTree* (*TreeSelector)(NudlDslParser*)>
@@ -88,8 +96,9 @@ struct ConfigurableParseData : public ParseDataBase {
   antlr4::tree::ParseTree* CreateTree() override {
     return TreeSelector(parser.get());
   }
-  void Visit(NudlDslParserVisitor* visitor) override {
-    proto = std::make_unique<Proto>(std::any_cast<Proto>(visitor->visit(tree)));
+  void Build(TreeBuilder* builder) override {
+    proto = std::make_unique<Proto>();
+    builder->Build(tree, proto.get());
   }
 };
 
@@ -104,6 +113,19 @@ inline antlr4::tree::ParseTree* ExtractTypeExpression(NudlDslParser* parser) {
 using TypeSpecParseData =
     ConfigurableParseData<pb::TypeSpec, ExtractTypeExpression>;
 
+// Parses a snippet of code that exercises most of the grammar, to populate
+// the antlr prediction (DFA) caches. These caches are shared by all parsers
+// in the process, so this speeds up the first parses in long running
+// processes. Only the first call does any work. Returns the status of
+// parsing the snippet, which is an error if it does not parse cleanly.
+absl::Status WarmUpParser();
+
+// Version of the parsed proto structures produced from the grammar.
+// Needs to be incremented when the grammar files or the tree builder
+// change in a way that affects the parsed protos, as it is used
+// for invalidating the parsed modules cached on disk.
+inline constexpr absl::string_view kGrammarVersion = "2";
+
 inline constexpr absl::string_view kParseErrorUrl = "nudl.nuna.com/ParseError";
 inline constexpr absl::string_view kParseCodeUrl = "nudl.nuna.com/ParseCode";
 inline constexpr absl::string_view kParseFileUrl = "nudl.nuna.com/ParseFile";
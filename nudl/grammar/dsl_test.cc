@@ -3066,6 +3066,22 @@ TEST(Parser, CodeSnippets) {
       }
       code: "def f(a) => {\n   a\n   + 1\n};"
     })pb"));
+  ParseOptions no_snippets;
+  no_snippets.no_code_snippets = true;
+  ASSERT_OK_AND_ASSIGN(auto full_module, ParseModule(code));
+  ASSERT_OK_AND_ASSIGN(module, ParseModule(code, no_snippets));
+  ASSERT_EQ(module->element_size(), full_module->element_size());
+  for (int i = 0; i < module->element_size(); ++i) {
+    const auto& element = module->element(i);
+    EXPECT_FALSE(element.has_code());
+    EXPECT_THAT(element.code_interval(),
+                EqualsProto(full_module->element(i).code_interval()));
+    EXPECT_EQ(TreeUtil::CodeSnippet(code, element.code_interval().begin(),
+                                    element.code_interval().end()),
+              full_module->element(i).code());
+  }
+  EXPECT_FALSE(module->element(0).assignment().value().has_code());
+  EXPECT_TRUE(module->element(0).assignment().value().has_code_interval());
 }
 
 TEST(Parser, Pragmas) {
@@ -3397,6 +3413,36 @@ element {
 )");
 }
 
+TEST(Parser, PredictionModes) {
+  ASSERT_OK(WarmUpParser());
+  ParseOptions full_ll;
+  full_ll.full_ll_prediction = true;
+  const std::string code = R"(
+import foo.bar
+def f(a: Int, b = 2) => {
+  x = [a, b].map((y: Int) => y * 2);
+  if (a > b) { return x[0] } else { return (a, b) }
+}
+z = f(1, b=3).foo
+)";
+  ASSERT_OK_AND_ASSIGN(auto sll_module, ParseModule(code));
+  ASSERT_OK_AND_ASSIGN(auto ll_module, ParseModule(code, full_ll));
+  EXPECT_THAT(*sll_module, EqualsProto(*ll_module));
+  // Syntax errors make the fast path fail, and are reported by the
+  // full LL parse that follows.
+  std::vector<ErrorInfo> sll_errors;
+  std::vector<ErrorInfo> ll_errors;
+  EXPECT_RAISES(ParseModule("x = * 2", {}, &sll_errors).status(),
+                InvalidArgument);
+  EXPECT_RAISES(ParseModule("x = * 2", full_ll, &ll_errors).status(),
+                InvalidArgument);
+  EXPECT_FALSE(sll_errors.empty());
+  ASSERT_EQ(sll_errors.size(), ll_errors.size());
+  for (size_t i = 0; i < sll_errors.size(); ++i) {
+    EXPECT_EQ(sll_errors[i].ToString(), ll_errors[i].ToString());
+  }
+}
+
 }  // namespace grammar
 }  // namespace nudl
 
@@ -38,11 +38,15 @@ namespace nudl {
 namespace grammar {
 
 namespace {
-class DslVisitor : public NudlDslParserBaseVisitor {
+class DslVisitor : public NudlDslParserBaseVisitor, public TreeBuilder {
  private:
   const antlr4::Parser* parser_ = nullptr;
   absl::string_view code_;
   VisitorOptions options_;
+  // Where the expression currently visited is built. Expressions need
+  // the dispatch of the parse tree visitor, so they are built in this
+  // destination by the visit* methods below, instead of being returned.
+  pb::Expression* expression_dest_ = nullptr;
 
  public:
   DslVisitor(const antlr4::Parser* parser, absl::string_view code,
@@ -52,53 +56,56 @@ class DslVisitor : public NudlDslParserBaseVisitor {
         code_(code),
         options_(std::move(options)) {}
 
-  std::string FillInterval(const antlr4::tree::ParseTree& pt,
-                           pb::CodeInterval* interval) const {
+  void Build(antlr4::tree::ParseTree* tree, pb::Module* module) override {
+    auto context = dynamic_cast<NudlDslParser::ModuleContext*>(tree);
+    buildModule(CHECK_NOTNULL(context), module);
+  }
+
+  void Build(antlr4::tree::ParseTree* tree, pb::TypeSpec* type_spec) override {
+    auto context = dynamic_cast<NudlDslParser::TypeExpressionContext*>(tree);
+    buildTypeSpec(CHECK_NOTNULL(context), type_spec);
+  }
+
+  template <class Proto>
+  void FillInterval(const antlr4::tree::ParseTree& pt, Proto* proto) const {
+    pb::CodeInterval* interval = proto->mutable_code_interval();
     *interval = TreeUtil::GetInterval(pt);
     if (options_.no_interval_positions) {
       interval->mutable_begin()->clear_position();
       interval->mutable_end()->clear_position();
     }
-    return std::string(
-        TreeUtil::CodeSnippet(code_, interval->begin(), interval->end()));
+    if (!options_.no_code_snippets) {
+      proto->set_code(std::string(
+          TreeUtil::CodeSnippet(code_, interval->begin(), interval->end())));
+    }
   }
 
-  pb::Expression emptyExpression(const antlr4::tree::ParseTree& pt) const {
-    pb::Expression expression;
+  // Returns the destination of the expression built for `pt`, after
+  // setting its code interval.
+  pb::Expression* startExpression(const antlr4::tree::ParseTree& pt) {
+    pb::Expression* expression = CHECK_NOTNULL(expression_dest_);
     if (!code_.empty() && !options_.no_intervals) {
-      expression.set_code(FillInterval(pt, expression.mutable_code_interval()));
+      FillInterval(pt, expression);
     }
     return expression;
   }
-  std::any setError(pb::Expression* expression, antlr4::tree::ParseTree* pt,
-                    absl::string_view message) const {
+  void setError(pb::Expression* expression, antlr4::tree::ParseTree* pt,
+                absl::string_view message) const {
     auto error = expression->mutable_error();
     error->set_description(std::string(message));
-    return std::make_any<pb::Expression>(std::move(*expression));
   }
-  template <class Context>
-  pb::Expression computeExpression(Context* context) {
-    return std::any_cast<pb::Expression>(visit(context));
-  }
-  pb::ExpressionBlock expressionBlock(
-      NudlDslParser::ExpressionBlockContext* context) {
-    return std::any_cast<pb::ExpressionBlock>(visit(context));
-  }
-  pb::Identifier identifier(NudlDslParser::ComposedIdentifierContext* context) {
-    return std::any_cast<pb::Identifier>(visit(context));
-  }
-  pb::FunctionParameter paramDefinition(
-      NudlDslParser::ParamDefinitionContext* context) {
-    return std::any_cast<pb::FunctionParameter>(visit(context));
-  }
-  template <class Context>
-  pb::TypeSpec typeSpec(Context* context) {
-    return std::any_cast<pb::TypeSpec>(visit(context));
+  // Builds the expression under `context` in `expression`.
+  void computeExpression(antlr4::tree::ParseTree* context,
+                         pb::Expression* expression) {
+    pb::Expression* const last_dest =
+        std::exchange(expression_dest_, expression);
+    visit(CHECK_NOTNULL(context));
+    expression_dest_ = last_dest;
   }
 
   std::any visitLiteral(NudlDslParser::LiteralContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    auto literal = expression.mutable_literal();
+    pb::Expression* expression = startExpression(*context);
+    auto literal = expression->mutable_literal();
     literal->set_original(TreeUtil::Recompose(context));
     if (context->KW_NULL()) {
       literal->set_null_value(pb::NullType::NULL_VALUE);
@@ -109,7 +116,8 @@ class DslVisitor : public NudlDslParserBaseVisitor {
     } else if (context->LITERAL_DECIMAL()) {
       uint64_t value;
       if (!absl::SimpleAtoi(literal->original(), &value)) {
-        return setError(&expression, context, "Invalid decimal literal");
+        setError(expression, context, "Invalid decimal literal");
+        return {};
       }
       literal->set_int_value(value);
     } else if (context->LITERAL_UNSIGNED_DECIMAL()) {
@@ -118,7 +126,8 @@ class DslVisitor : public NudlDslParserBaseVisitor {
               absl::StripSuffix(absl::StripSuffix(literal->original(), "u"),
                                 "U"),
               &value)) {
-        return setError(&expression, context, "Invalid decimal literal");
+        setError(expression, context, "Invalid decimal literal");
+        return {};
       }
       literal->set_uint_value(value);
     } else if (context->LITERAL_HEXADECIMAL()) {
@@ -126,7 +135,8 @@ class DslVisitor : public NudlDslParserBaseVisitor {
           absl::StripPrefix(absl::StripPrefix(literal->original(), "0x"), "0X");
       uint64_t value;
       if (!absl::SimpleHexAtoi(value_str, &value)) {
-        return setError(&expression, context, "Invalid hexadecimal literal");
+        setError(expression, context, "Invalid hexadecimal literal");
+        return {};
       }
       literal->set_int_value(value);
     } else if (context->LITERAL_UNSIGNED_HEXADECIMAL()) {
@@ -138,20 +148,23 @@ class DslVisitor : public NudlDslParserBaseVisitor {
           "U");
       uint64_t value;
       if (!absl::SimpleHexAtoi(value_str, &value)) {
-        return setError(&expression, context, "Invalid hexadecimal literal");
+        setError(expression, context, "Invalid hexadecimal literal");
+        return {};
       }
       literal->set_uint_value(value);
     } else if (context->LITERAL_FLOAT()) {
       float value;
       if (!absl::SimpleAtof(absl::StripSuffix(literal->original(), "f"),
                             &value)) {
-        return setError(&expression, context, "Invalid float literal");
+        setError(expression, context, "Invalid float literal");
+        return {};
       }
       literal->set_float_value(value);
     } else if (context->LITERAL_DOUBLE()) {
       double value;
       if (!absl::SimpleAtod(literal->original(), &value)) {
-        return setError(&expression, context, "Invalid double literal");
+        setError(expression, context, "Invalid double literal");
+        return {};
       }
       literal->set_double_value(value);
     } else if (context->LITERAL_STRING()) {
@@ -159,16 +172,18 @@ class DslVisitor : public NudlDslParserBaseVisitor {
           absl::StripSuffix(absl::StripPrefix(literal->original(), "\""), "\"");
       std::string error;
       if (!absl::CUnescape(value_str, literal->mutable_str_value(), &error)) {
-        return setError(&expression, context,
-                        absl::StrCat("Invalid string literal: ", error));
+        setError(expression, context,
+                 absl::StrCat("Invalid string literal: ", error));
+        return {};
       }
     } else if (context->LITERAL_BYTES()) {
       absl::string_view value_str = absl::StripSuffix(
           absl::StripPrefix(literal->original(), "b\""), "\"");
       std::string error;
       if (!absl::CUnescape(value_str, literal->mutable_bytes_value(), &error)) {
-        return setError(&expression, context,
-                        absl::StrCat("Invalid bytes literal: ", error));
+        setError(expression, context,
+                 absl::StrCat("Invalid bytes literal: ", error));
+        return {};
       }
     } else if (!context->LITERAL_TIMERANGE().empty()) {
       absl::Duration duration;
@@ -178,7 +193,8 @@ class DslVisitor : public NudlDslParserBaseVisitor {
         std::string unit;
         re2::StringPiece input(text);
         if (!RE2::Consume(&input, "(\\d+)(\\w+)", &value, &unit)) {
-          return setError(&expression, context, "invalid timerange format");
+          setError(expression, context, "invalid timerange format");
+          return {};
         }
         if (unit == "seconds") {
           duration += absl::Seconds(value);
@@ -191,216 +207,198 @@ class DslVisitor : public NudlDslParserBaseVisitor {
         } else if (unit == "weeks") {
           duration += absl::Hours(value * 24 * 7);
         } else {
-          return setError(&expression, context,
-                          absl::StrCat("Unknown unit: ", unit));
+          setError(expression, context, absl::StrCat("Unknown unit: ", unit));
+          return {};
         }
       }
       literal->mutable_time_range()->set_seconds(
           absl::ToInt64Seconds(duration));
     }
-    return std::make_any<pb::Expression>(std::move(expression));
+    return {};
   }
 
   std::any visitEmptyStruct(
       NudlDslParser::EmptyStructContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    expression.set_empty_struct(pb::NullType::NULL_VALUE);
-    return std::make_any<pb::Expression>(std::move(expression));
+    startExpression(*context)->set_empty_struct(pb::NullType::NULL_VALUE);
+    return {};
   }
 
   std::any visitArrayDefinition(
       NudlDslParser::ArrayDefinitionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
+    auto array_def = startExpression(*context)->mutable_array_def();
     CHECK_NOTNULL(context->computeExpressions());
-    auto array_def = expression.mutable_array_def();
     for (auto expression : context->computeExpressions()->computeExpression()) {
-      *array_def->add_element() = computeExpression(expression);
+      computeExpression(expression, array_def->add_element());
     }
-    return std::make_any<pb::Expression>(std::move(expression));
+    return {};
   }
 
   std::any visitMapDefinition(
       NudlDslParser::MapDefinitionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
+    auto map_def = startExpression(*context)->mutable_map_def();
     CHECK_NOTNULL(context->mapElements());
-    auto map_def = expression.mutable_map_def();
     for (auto element : context->mapElements()->mapElement()) {
       auto keyval = element->computeExpression();
       CHECK_EQ(keyval.size(), 2ul);
       auto elem = map_def->add_element();
-      *elem->mutable_key() = computeExpression(keyval[0]);
-      *elem->mutable_value() = computeExpression(keyval[1]);
+      computeExpression(keyval[0], elem->mutable_key());
+      computeExpression(keyval[1], elem->mutable_value());
     }
-    return std::make_any<pb::Expression>(std::move(expression));
+    return {};
   }
 
   std::any visitNamedTupleDefinition(
       NudlDslParser::NamedTupleDefinitionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
+    auto tuple_def = startExpression(*context)->mutable_tuple_def();
     CHECK_NOTNULL(context->namedTupleElements());
-    auto tuple_def = expression.mutable_tuple_def();
     for (auto element : context->namedTupleElements()->namedTupleElement()) {
       auto elem = tuple_def->add_element();
       elem->set_name(TreeUtil::Recompose(CHECK_NOTNULL(element->IDENTIFIER())));
-      *elem->mutable_value() =
-          computeExpression(CHECK_NOTNULL(element->computeExpression()));
+      computeExpression(element->computeExpression(), elem->mutable_value());
       if (element->typeAssignment()) {
-        *elem->mutable_type_spec() = typeSpec(
-            CHECK_NOTNULL(element->typeAssignment()->typeExpression()));
+        buildTypeSpec(
+            CHECK_NOTNULL(element->typeAssignment()->typeExpression()),
+            elem->mutable_type_spec());
       }
     }
-    return std::make_any<pb::Expression>(std::move(expression));
+    return {};
   }
 
-  std::any visitComposedIdentifier(
-      NudlDslParser::ComposedIdentifierContext* context) override {
-    pb::Identifier identifier;
-    identifier.add_name(
+  void buildIdentifier(NudlDslParser::ComposedIdentifierContext* context,
+                       pb::Identifier* identifier) {
+    identifier->add_name(
         TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
     for (auto dot : context->dotIdentifier()) {
-      identifier.add_name(
+      identifier->add_name(
           TreeUtil::Recompose(CHECK_NOTNULL(dot->IDENTIFIER())));
     }
-    return std::make_any<pb::Identifier>(std::move(identifier));
   }
 
   std::any visitIfExpression(
       NudlDslParser::IfExpressionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    auto if_expr = expression.mutable_if_expr();
-    *if_expr->add_condition() =
-        computeExpression(CHECK_NOTNULL(context->computeExpression()));
-    *if_expr->add_expression_block() =
-        expressionBlock(CHECK_NOTNULL(context->expressionBlock()));
+    auto if_expr = startExpression(*context)->mutable_if_expr();
+    computeExpression(context->computeExpression(), if_expr->add_condition());
+    buildExpressionBlock(CHECK_NOTNULL(context->expressionBlock()),
+                         if_expr->add_expression_block());
     if (context->elseExpression()) {
-      *if_expr->add_expression_block() = expressionBlock(
-          CHECK_NOTNULL(context->elseExpression()->expressionBlock()));
+      buildExpressionBlock(
+          CHECK_NOTNULL(context->elseExpression()->expressionBlock()),
+          if_expr->add_expression_block());
     } else {
       auto crt_elif = context->elifExpression();
       while (crt_elif) {
-        *if_expr->add_condition() =
-            computeExpression(CHECK_NOTNULL(crt_elif->computeExpression()));
-        *if_expr->add_expression_block() =
-            expressionBlock(CHECK_NOTNULL(crt_elif->expressionBlock()));
+        computeExpression(crt_elif->computeExpression(),
+                          if_expr->add_condition());
+        buildExpressionBlock(CHECK_NOTNULL(crt_elif->expressionBlock()),
+                             if_expr->add_expression_block());
         if (crt_elif->elseExpression()) {
-          *if_expr->add_expression_block() = expressionBlock(
-              CHECK_NOTNULL(crt_elif->elseExpression()->expressionBlock()));
+          buildExpressionBlock(
+              CHECK_NOTNULL(crt_elif->elseExpression()->expressionBlock()),
+              if_expr->add_expression_block());
           break;
         }
         crt_elif = crt_elif->elifExpression();
       }
     }
-    return std::make_any<pb::Expression>(std::move(expression));
+    return {};
   }
 
   std::any visitWithExpression(
       NudlDslParser::WithExpressionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    auto with_expr = expression.mutable_with_expr();
-
-    *with_expr->mutable_with() =
-        computeExpression(CHECK_NOTNULL(context->computeExpression()));
-    *with_expr->mutable_expression_block() = std::any_cast<pb::ExpressionBlock>(
-        visit(CHECK_NOTNULL(context->expressionBlock())));
-    return std::make_any<pb::Expression>(std::move(expression));
+    auto with_expr = startExpression(*context)->mutable_with_expr();
+    computeExpression(context->computeExpression(), with_expr->mutable_with());
+    buildExpressionBlock(CHECK_NOTNULL(context->expressionBlock()),
+                         with_expr->mutable_expression_block());
+    return {};
   }
 
   std::any visitReturnExpression(
       NudlDslParser::ReturnExpressionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    *expression.mutable_return_expr() =
-        computeExpression(CHECK_NOTNULL(context->computeExpression()));
-    return std::make_any<pb::Expression>(std::move(expression));
+    pb::Expression* expression = startExpression(*context);
+    computeExpression(context->computeExpression(),
+                      expression->mutable_return_expr());
+    return {};
   }
 
   std::any visitYieldExpression(
       NudlDslParser::YieldExpressionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    *expression.mutable_yield_expr() =
-        computeExpression(CHECK_NOTNULL(context->computeExpression()));
-    return std::make_any<pb::Expression>(std::move(expression));
+    pb::Expression* expression = startExpression(*context);
+    computeExpression(context->computeExpression(),
+                      expression->mutable_yield_expr());
+    return {};
   }
 
   std::any visitPassExpression(
       NudlDslParser::PassExpressionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    expression.set_pass_expr(pb::NullType::NULL_VALUE);
-    return std::make_any<pb::Expression>(std::move(expression));
+    startExpression(*context)->set_pass_expr(pb::NullType::NULL_VALUE);
+    return {};
   }
 
-  std::any visitTypeAssignment(
-      NudlDslParser::TypeAssignmentContext* context) override {
-    return visitTypeExpression(CHECK_NOTNULL(context->typeExpression()));
+  void buildTypeSpec(NudlDslParser::TypeAssignmentContext* context,
+                     pb::TypeSpec* type_spec) {
+    buildTypeSpec(CHECK_NOTNULL(context->typeExpression()), type_spec);
   }
 
-  std::any visitTypeExpression(
-      NudlDslParser::TypeExpressionContext* context) override {
-    pb::TypeSpec type_spec;
+  void buildTypeSpec(NudlDslParser::TypeExpressionContext* context,
+                     pb::TypeSpec* type_spec) {
     if (context->typeNamedArgument()) {
-      type_spec.set_is_local_type(true);
-      type_spec.mutable_identifier()->add_name(TreeUtil::Recompose(
+      type_spec->set_is_local_type(true);
+      type_spec->mutable_identifier()->add_name(TreeUtil::Recompose(
           CHECK_NOTNULL(context->typeNamedArgument()->IDENTIFIER())));
       if (context->typeNamedArgument()->typeAssignment()) {
-        *type_spec.add_argument()->mutable_type_spec() =
-            typeSpec(context->typeNamedArgument()->typeAssignment());
+        buildTypeSpec(context->typeNamedArgument()->typeAssignment(),
+                      type_spec->add_argument()->mutable_type_spec());
       }
-      return std::make_any<pb::TypeSpec>(std::move(type_spec));
+      return;
     }
-    *type_spec.mutable_identifier() =
-        identifier(CHECK_NOTNULL(context->composedIdentifier()));
+    buildIdentifier(CHECK_NOTNULL(context->composedIdentifier()),
+                    type_spec->mutable_identifier());
     if (context->typeTemplate()) {
       for (auto arg : context->typeTemplate()->typeTemplateArgument()) {
         if (arg->typeExpression()) {
-          *type_spec.add_argument()->mutable_type_spec() =
-              typeSpec(arg->typeExpression());
+          buildTypeSpec(arg->typeExpression(),
+                        type_spec->add_argument()->mutable_type_spec());
         } else if (arg->LITERAL_DECIMAL()) {
           uint64_t value;
           if (absl::SimpleAtoi(TreeUtil::Recompose(arg->LITERAL_DECIMAL()),
                                &value)) {
-            type_spec.add_argument()->set_int_value(value);
+            type_spec->add_argument()->set_int_value(value);
           }
         }
       }
     }
-    return std::make_any<pb::TypeSpec>(std::move(type_spec));
   }
 
-  pb::Assignment buildAssignment(
-      NudlDslParser::AssignExpressionContext* context) {
-    pb::Assignment assign;
-    *assign.mutable_identifier() =
-        identifier(CHECK_NOTNULL(context->composedIdentifier()));
+  void buildAssignment(NudlDslParser::AssignExpressionContext* context,
+                       pb::Assignment* assign) {
+    buildIdentifier(CHECK_NOTNULL(context->composedIdentifier()),
+                    assign->mutable_identifier());
     if (context->typeAssignment()) {
-      *assign.mutable_type_spec() = typeSpec(context->typeAssignment());
+      buildTypeSpec(context->typeAssignment(), assign->mutable_type_spec());
     }
-    *assign.mutable_value() =
-        computeExpression(CHECK_NOTNULL(context->computeExpression()));
-    return assign;
+    computeExpression(context->computeExpression(), assign->mutable_value());
   }
 
   std::any visitAssignExpression(
       NudlDslParser::AssignExpressionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    *expression.mutable_assignment() = buildAssignment(context);
-    return std::make_any<pb::Expression>(std::move(expression));
+    buildAssignment(context, startExpression(*context)->mutable_assignment());
+    return {};
   }
 
-  std::any visitParamDefinition(
-      NudlDslParser::ParamDefinitionContext* context) override {
-    pb::FunctionParameter param;
-    param.set_name(TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
+  void buildParamDefinition(NudlDslParser::ParamDefinitionContext* context,
+                            pb::FunctionParameter* param) {
+    param->set_name(TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
     if (context->typeAssignment()) {
-      *param.mutable_type_spec() = typeSpec(context->typeAssignment());
+      buildTypeSpec(context->typeAssignment(), param->mutable_type_spec());
     }
     if (context->computeExpression()) {
-      *param.mutable_default_value() =
-          computeExpression(context->computeExpression());
+      computeExpression(context->computeExpression(),
+                        param->mutable_default_value());
     }
-    return std::make_any<pb::FunctionParameter>(std::move(param));
   }
 
-  std::any visitInlineBody(NudlDslParser::InlineBodyContext* context) override {
-    pb::NativeSnippet snippet;
+  void buildInlineBody(NudlDslParser::InlineBodyContext* context,
+                       pb::NativeSnippet* snippet) {
     std::string body_str(absl::StripPrefix(
         absl::StripSuffix(CHECK_NOTNULL(context->INLINE_BODY())->toString(),
                           "[[end]]"),
@@ -409,46 +407,44 @@ class DslVisitor : public NudlDslParserBaseVisitor {
     std::string inline_name;
     if (RE2::Consume(&native_body, R"(([a-zA-Z_][a-zA-Z0-9_]*)\]\])",
                      &inline_name)) {
-      snippet.set_name(std::move(inline_name));
-      snippet.set_body(std::string(
+      snippet->set_name(std::move(inline_name));
+      snippet->set_body(std::string(
           absl::StripSuffix(absl::StripPrefix(native_body, "\n"), "\n")));
     } else {
-      snippet.set_body(std::string(
+      snippet->set_body(std::string(
           absl::StripSuffix(absl::StripPrefix(body_str, "\n"), "\n")));
     }
-    return std::make_any<pb::NativeSnippet>(std::move(snippet));
   }
 
-  std::any visitFunctionDefinition(
-      NudlDslParser::FunctionDefinitionContext* context) override {
-    pb::FunctionDefinition fundef;
-    fundef.set_name(TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
+  void buildFunctionDefinition(
+      NudlDslParser::FunctionDefinitionContext* context,
+      pb::FunctionDefinition* fundef) {
+    fundef->set_name(TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
     if (context->functionAnnotation()) {
       if (context->functionAnnotation()->KW_METHOD()) {
-        fundef.set_fun_type(pb::FunctionType::FUN_METHOD);
+        fundef->set_fun_type(pb::FunctionType::FUN_METHOD);
       } else if (context->functionAnnotation()->KW_CONSTRUCTOR()) {
-        fundef.set_fun_type(pb::FunctionType::FUN_CONSTRUCTOR);
+        fundef->set_fun_type(pb::FunctionType::FUN_CONSTRUCTOR);
       } else if (context->functionAnnotation()->KW_MAIN_FUNCTION()) {
-        fundef.set_fun_type(pb::FunctionType::FUN_MAIN);
+        fundef->set_fun_type(pb::FunctionType::FUN_MAIN);
       }
     }
     if (context->expressionBlock()) {
-      *fundef.mutable_expression_block() =
-          expressionBlock(CHECK_NOTNULL(context->expressionBlock()));
+      buildExpressionBlock(context->expressionBlock(),
+                           fundef->mutable_expression_block());
     } else {
       for (auto body : context->inlineBody()) {
-        *fundef.add_snippet() = std::any_cast<pb::NativeSnippet>(visit(body));
+        buildInlineBody(body, fundef->add_snippet());
       }
     }
     if (context->typeAssignment()) {
-      *fundef.mutable_result_type() = typeSpec(context->typeAssignment());
+      buildTypeSpec(context->typeAssignment(), fundef->mutable_result_type());
     }
     if (context->paramsList()) {
       for (auto param : context->paramsList()->paramDefinition()) {
-        *fundef.add_param() = paramDefinition(param);
+        buildParamDefinition(param, fundef->add_param());
       }
     }
-    return std::make_any<pb::FunctionDefinition>(std::move(fundef));
   }
 
   void setArgumentList(NudlDslParser::ArgumentListContext* context,
@@ -461,40 +457,42 @@ class DslVisitor : public NudlDslParserBaseVisitor {
       if (arg->IDENTIFIER()) {
         farg->set_name(TreeUtil::Recompose(arg->IDENTIFIER()));
       }
-      *farg->mutable_value() =
-          computeExpression(CHECK_NOTNULL(arg->computeExpression()));
+      computeExpression(arg->computeExpression(), farg->mutable_value());
     }
   }
 
-  std::any visitFunctionCall(
-      NudlDslParser::FunctionCallContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    auto funcall = expression.mutable_function_call();
+  void buildFunctionCall(NudlDslParser::FunctionCallContext* context,
+                         pb::FunctionCall* funcall) {
     CHECK_NOTNULL(context->functionName());
     if (context->functionName()->composedIdentifier()) {
-      *funcall->mutable_identifier() =
-          identifier(context->functionName()->composedIdentifier());
+      buildIdentifier(context->functionName()->composedIdentifier(),
+                      funcall->mutable_identifier());
     } else if (context->functionName()->typeExpression()) {
-      *funcall->mutable_type_spec() =
-          typeSpec(context->functionName()->typeExpression());
+      buildTypeSpec(context->functionName()->typeExpression(),
+                    funcall->mutable_type_spec());
     }
     setArgumentList(context->argumentList(), funcall);
-    return std::make_any<pb::Expression>(std::move(expression));
+  }
+
+  std::any visitFunctionCall(
+      NudlDslParser::FunctionCallContext* context) override {
+    buildFunctionCall(context,
+                      startExpression(*context)->mutable_function_call());
+    return {};
   }
 
   std::any visitLambdaExpression(
       NudlDslParser::LambdaExpressionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    auto lambda = expression.mutable_lambda_def();
+    auto lambda = startExpression(*context)->mutable_lambda_def();
     for (auto param : context->paramDefinition()) {
-      *lambda->add_param() = paramDefinition(param);
+      buildParamDefinition(param, lambda->add_param());
     }
     if (context->typeAssignment()) {
-      *lambda->mutable_result_type() = typeSpec(context->typeAssignment());
+      buildTypeSpec(context->typeAssignment(), lambda->mutable_result_type());
     }
-    *lambda->mutable_expression_block() =
-        expressionBlock(CHECK_NOTNULL(context->expressionBlock()));
-    return std::make_any<pb::Expression>(std::move(expression));
+    buildExpressionBlock(CHECK_NOTNULL(context->expressionBlock()),
+                         lambda->mutable_expression_block());
+    return {};
   }
 
   std::any visitParenthesisedExpression(
@@ -505,45 +503,51 @@ class DslVisitor : public NudlDslParserBaseVisitor {
   std::any visitPrimaryExpression(
       NudlDslParser::PrimaryExpressionContext* context) override {
     if (context->composedIdentifier()) {
-      pb::Expression expression(emptyExpression(*context));
-      *expression.mutable_identifier() =
-          identifier(context->composedIdentifier());
-      return std::make_any<pb::Expression>(std::move(expression));
+      buildIdentifier(context->composedIdentifier(),
+                      startExpression(*context)->mutable_identifier());
+      return {};
     }
     return visitChildren(context);
   }
 
   std::any visitPostfixExpression(
       NudlDslParser::PostfixExpressionContext* context) override {
-    pb::Expression primary_expression = std::any_cast<pb::Expression>(
-        visit(CHECK_NOTNULL(context->primaryExpression())));
+    // The last postfix value applies to all the ones before it, so the
+    // chain is built from the outside in, ending with the primary expression.
+    std::vector<NudlDslParser::PostfixValueContext*> postfixes;
     for (auto postfix : context->postfixValue()) {
-      pb::Expression expression(emptyExpression(*context));
+      if (!postfix->LBRACKET() && !postfix->LPAREN() && !postfix->DOT()) {
+        break;
+      }
+      postfixes.push_back(postfix);
+    }
+    pb::Expression* const result_dest = expression_dest_;
+    for (auto it = postfixes.rbegin(); it != postfixes.rend(); ++it) {
+      auto postfix = *it;
+      pb::Expression* expression = startExpression(*context);
       if (postfix->LBRACKET()) {
-        auto index_expr = expression.mutable_index_expr();
-        *index_expr->mutable_object() = std::move(primary_expression);
-        *index_expr->mutable_index() =
-            computeExpression(CHECK_NOTNULL(postfix->computeExpression()));
+        auto index_expr = expression->mutable_index_expr();
+        computeExpression(postfix->computeExpression(),
+                          index_expr->mutable_index());
+        expression_dest_ = index_expr->mutable_object();
       } else if (postfix->LPAREN()) {
-        auto funcall = expression.mutable_function_call();
-        *funcall->mutable_expr_spec() = std::move(primary_expression);
+        auto funcall = expression->mutable_function_call();
         setArgumentList(postfix->argumentList(), funcall);
-      } else if (postfix->DOT()) {
-        auto dot_expr = expression.mutable_dot_expr();
-        *dot_expr->mutable_left() = std::move(primary_expression);
+        expression_dest_ = funcall->mutable_expr_spec();
+      } else {
+        auto dot_expr = expression->mutable_dot_expr();
         if (postfix->IDENTIFIER()) {
           dot_expr->set_name(TreeUtil::Recompose(postfix->IDENTIFIER()));
         } else {
-          *dot_expr->mutable_function_call() = std::move(
-              *std::any_cast<pb::Expression>(visit(postfix->functionCall()))
-                   .mutable_function_call());
+          buildFunctionCall(CHECK_NOTNULL(postfix->functionCall()),
+                            dot_expr->mutable_function_call());
         }
-      } else {
-        break;
+        expression_dest_ = dot_expr->mutable_left();
       }
-      primary_expression = std::move(expression);
     }
-    return std::make_any<pb::Expression>(std::move(primary_expression));
+    visit(CHECK_NOTNULL(context->primaryExpression()));
+    expression_dest_ = result_dest;
+    return {};
   }
 
   template <class T, class O>
@@ -581,16 +585,14 @@ class DslVisitor : public NudlDslParserBaseVisitor {
         CHECK_EQ(exprs_.size(), 1ul);
         return visitor_->visit(exprs_.front());
       }
-      pb::Expression expression(visitor_->emptyExpression(*pt_));
-      auto oper = expression.mutable_operator_expr();
+      auto oper = visitor_->startExpression(*pt_)->mutable_operator_expr();
       for (auto expr : exprs_) {
-        *oper->add_argument() =
-            std::any_cast<pb::Expression>(visitor_->visit(expr));
+        visitor_->computeExpression(expr, oper->add_argument());
       }
       for (auto oper_node : opers_) {
         oper->add_op(TreeUtil::Recompose(oper_node));
       }
-      return std::make_any<pb::Expression>(std::move(expression));
+      return {};
     }
   };
 
@@ -699,166 +701,124 @@ class DslVisitor : public NudlDslParserBaseVisitor {
         .visit();
   }
 
-  std::any visitComputeExpressions(
-      NudlDslParser::ComputeExpressionsContext* context) override {
-    pb::ExpressionBlock block;
-    for (auto expr : context->computeExpression()) {
-      *block.add_expression() = computeExpression(expr);
-    }
-    return std::make_any<pb::ExpressionBlock>(std::move(block));
-  }
-
-  std::any visitExpressionBlock(
-      NudlDslParser::ExpressionBlockContext* context) override {
+  void buildExpressionBlock(NudlDslParser::ExpressionBlockContext* context,
+                            pb::ExpressionBlock* block) {
     if (context->blockBody()) {
-      return visit(context->blockBody());
-    }
-    pb::ExpressionBlock block;
-    *block.add_expression() =
-        computeExpression(CHECK_NOTNULL(context->blockElement()));
-    return std::make_any<pb::ExpressionBlock>(std::move(block));
-  }
-
-  std::any visitBlockBody(NudlDslParser::BlockBodyContext* context) override {
-    pb::ExpressionBlock block;
-    for (auto expr : context->blockElement()) {
-      *block.add_expression() = computeExpression(expr);
-    }
-    return std::make_any<pb::ExpressionBlock>(std::move(block));
-  }
-
-  std::any visitSchemaDefinition(
-      NudlDslParser::SchemaDefinitionContext* context) override {
-    pb::SchemaDefinition schema;
-    schema.set_name(TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
-    if (context->fieldsDefinition()) {
-      for (auto field_def : context->fieldsDefinition()->fieldDefinition()) {
-        *schema.add_field() =
-            std::any_cast<pb::SchemaDefinition::Field>(visit(field_def));
+      for (auto expr : context->blockBody()->blockElement()) {
+        computeExpression(expr, block->add_expression());
       }
+      return;
     }
-    return std::make_any<pb::SchemaDefinition>(std::move(schema));
+    computeExpression(context->blockElement(), block->add_expression());
   }
 
-  std::any visitFieldDefinition(
-      NudlDslParser::FieldDefinitionContext* context) override {
-    pb::SchemaDefinition::Field field;
-    field.set_name(TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
-    *field.mutable_type_spec() =
-        typeSpec(CHECK_NOTNULL(context->typeAssignment()));
+  void buildField(NudlDslParser::FieldDefinitionContext* context,
+                  pb::SchemaDefinition::Field* field) {
+    field->set_name(TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
+    buildTypeSpec(CHECK_NOTNULL(context->typeAssignment()),
+                  field->mutable_type_spec());
     if (context->fieldOptions()) {
       for (auto option : context->fieldOptions()->fieldOption()) {
-        auto pb_option = field.add_field_option();
+        auto pb_option = field->add_field_option();
         pb_option->set_name(
             TreeUtil::Recompose(CHECK_NOTNULL(option->IDENTIFIER())));
-        *pb_option->mutable_value() =
-            computeExpression(CHECK_NOTNULL(option->literal()));
+        computeExpression(option->literal(), pb_option->mutable_value());
       }
     }
-    return std::make_any<pb::SchemaDefinition::Field>(std::move(field));
   }
 
-  std::any visitImportStatement(
-      NudlDslParser::ImportStatementContext* context) override {
-    pb::ImportStatement stmt;
-    for (auto spec : context->importSpecification()) {
-      *stmt.add_spec() =
-          std::any_cast<pb::ImportStatement::Specification>(visit(spec));
+  void buildSchemaDefinition(NudlDslParser::SchemaDefinitionContext* context,
+                             pb::SchemaDefinition* schema) {
+    schema->set_name(TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
+    if (context->fieldsDefinition()) {
+      for (auto field_def : context->fieldsDefinition()->fieldDefinition()) {
+        buildField(field_def, schema->add_field());
+      }
     }
-    return std::make_any<pb::ImportStatement>(std::move(stmt));
   }
 
-  std::any visitImportSpecification(
-      NudlDslParser::ImportSpecificationContext* context) override {
-    pb::ImportStatement::Specification spec;
-    if (context->IDENTIFIER()) {
-      spec.set_alias(TreeUtil::Recompose(context->IDENTIFIER()));
+  void buildImportStatement(NudlDslParser::ImportStatementContext* context,
+                            pb::ImportStatement* stmt) {
+    for (auto spec_context : context->importSpecification()) {
+      auto spec = stmt->add_spec();
+      if (spec_context->IDENTIFIER()) {
+        spec->set_alias(TreeUtil::Recompose(spec_context->IDENTIFIER()));
+      }
+      buildIdentifier(CHECK_NOTNULL(spec_context->composedIdentifier()),
+                      spec->mutable_module());
     }
-    *spec.mutable_module() =
-        identifier(CHECK_NOTNULL(context->composedIdentifier()));
-    return std::make_any<pb::ImportStatement::Specification>(std::move(spec));
   }
 
-  std::any visitModuleAssignment(
-      NudlDslParser::ModuleAssignmentContext* context) override {
-    auto assign = buildAssignment(CHECK_NOTNULL(context->assignExpression()));
+  void buildModuleAssignment(NudlDslParser::ModuleAssignmentContext* context,
+                             pb::Assignment* assign) {
+    buildAssignment(CHECK_NOTNULL(context->assignExpression()), assign);
     for (auto qualifier : context->assignQualifier()) {
       if (qualifier->KW_PARAM()) {
-        assign.add_qualifier(pb::QualifierType::QUAL_PARAM);
+        assign->add_qualifier(pb::QualifierType::QUAL_PARAM);
       }
     }
-    return std::make_any<pb::Assignment>(std::move(assign));
   }
 
-  pb::PragmaExpression buildPragma(
-      NudlDslParser::PragmaExpressionContext* context) {
-    pb::PragmaExpression pragma_node;
-    pragma_node.set_name(
+  void buildPragma(NudlDslParser::PragmaExpressionContext* context,
+                   pb::PragmaExpression* pragma_node) {
+    pragma_node->set_name(
         TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
     if (context->computeExpression()) {
-      *pragma_node.mutable_value() =
-          computeExpression(context->computeExpression());
+      computeExpression(context->computeExpression(),
+                        pragma_node->mutable_value());
     }
-    return pragma_node;
   }
 
   std::any visitPragmaExpression(
       NudlDslParser::PragmaExpressionContext* context) override {
-    pb::Expression expression(emptyExpression(*context));
-    *expression.mutable_pragma_expr() = buildPragma(context);
-    return std::make_any<pb::Expression>(std::move(expression));
+    buildPragma(context, startExpression(*context)->mutable_pragma_expr());
+    return {};
   }
 
-  std::any visitTypeDefinition(
-      NudlDslParser::TypeDefinitionContext* context) override {
-    pb::TypeDefinition type_def;
-    type_def.set_name(
+  void buildTypeDefinition(NudlDslParser::TypeDefinitionContext* context,
+                           pb::TypeDefinition* type_def) {
+    type_def->set_name(
         TreeUtil::Recompose(CHECK_NOTNULL(context->IDENTIFIER())));
-    *type_def.mutable_type_spec() =
-        typeSpec(CHECK_NOTNULL(context->typeExpression()));
-    return std::make_any<pb::TypeDefinition>(std::move(type_def));
+    buildTypeSpec(CHECK_NOTNULL(context->typeExpression()),
+                  type_def->mutable_type_spec());
   }
 
-  std::any visitModuleElement(
-      NudlDslParser::ModuleElementContext* context) override {
-    pb::ModuleElement element;
+  void buildModuleElement(NudlDslParser::ModuleElementContext* context,
+                          pb::ModuleElement* element) {
     if (!code_.empty() && !options_.no_intervals) {
-      element.set_code(FillInterval(*context, element.mutable_code_interval()));
+      FillInterval(*context, element);
     }
     if (context->importStatement()) {
-      *element.mutable_import_stmt() =
-          std::any_cast<pb::ImportStatement>(visit(context->importStatement()));
+      buildImportStatement(context->importStatement(),
+                           element->mutable_import_stmt());
     } else if (context->schemaDefinition()) {
-      *element.mutable_schema() = std::any_cast<pb::SchemaDefinition>(
-          visit(context->schemaDefinition()));
+      buildSchemaDefinition(context->schemaDefinition(),
+                            element->mutable_schema());
     } else if (context->functionDefinition()) {
-      *element.mutable_function_def() = std::any_cast<pb::FunctionDefinition>(
-          visit(context->functionDefinition()));
+      buildFunctionDefinition(context->functionDefinition(),
+                              element->mutable_function_def());
     } else if (context->moduleAssignment()) {
-      *element.mutable_assignment() =
-          std::any_cast<pb::Assignment>(visit(context->moduleAssignment()));
+      buildModuleAssignment(context->moduleAssignment(),
+                            element->mutable_assignment());
     } else if (context->pragmaExpression()) {
-      *element.mutable_pragma_expr() = buildPragma(context->pragmaExpression());
+      buildPragma(context->pragmaExpression(), element->mutable_pragma_expr());
     } else if (context->typeDefinition()) {
-      *element.mutable_type_def() =
-          std::any_cast<pb::TypeDefinition>(visit(context->typeDefinition()));
+      buildTypeDefinition(context->typeDefinition(),
+                          element->mutable_type_def());
     }
-    return std::make_any<pb::ModuleElement>(std::move(element));
   }
 
-  std::any visitModule(NudlDslParser::ModuleContext* context) override {
-    pb::Module module;
+  void buildModule(NudlDslParser::ModuleContext* context, pb::Module* module) {
     for (auto element : context->moduleElement()) {
-      *module.add_element() = std::any_cast<pb::ModuleElement>(visit(element));
+      buildModuleElement(element, module->add_element());
     }
-    return std::make_any<pb::Module>(std::move(module));
   }
 };
 }  // namespace
 
-std::unique_ptr<NudlDslParserVisitor> BuildVisitor(const antlr4::Parser* parser,
-                                                   absl::string_view code,
-                                                   VisitorOptions options) {
+std::unique_ptr<TreeBuilder> CreateTreeBuilder(const antlr4::Parser* parser,
+                                               absl::string_view code,
+                                               VisitorOptions options) {
   return std::make_unique<DslVisitor>(parser, code, options);
 }
 
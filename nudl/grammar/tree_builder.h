@@ -19,8 +19,9 @@
 
 #include <memory>
 
-#include "NudlDslParserVisitor.h"
 #include "absl/strings/string_view.h"
+#include "antlr4-runtime.h"  // NOLINT
+#include "nudl/proto/dsl.pb.h"
 
 namespace nudl {
 namespace grammar {
@@ -28,11 +29,27 @@ namespace grammar {
 struct VisitorOptions {
   bool no_intervals = false;
   bool no_interval_positions = false;
+  bool no_code_snippets = false;
 };
 
-std::unique_ptr<NudlDslParserVisitor> BuildVisitor(const antlr4::Parser* parser,
-                                                   absl::string_view code,
-                                                   VisitorOptions options = {});
+// Converts parse trees to their proto representation. The nodes are
+// constructed in place, directly in the fields of their parent messages.
+class TreeBuilder {
+ public:
+  virtual ~TreeBuilder() = default;
+
+  // Builds the module in the provided `tree` (a module parse tree) into
+  // `module`.
+  virtual void Build(antlr4::tree::ParseTree* tree, pb::Module* module) = 0;
+  // Builds the type specification in the provided `tree` (a type expression
+  // parse tree) into `type_spec`.
+  virtual void Build(antlr4::tree::ParseTree* tree,
+                     pb::TypeSpec* type_spec) = 0;
+};
+
+std::unique_ptr<TreeBuilder> CreateTreeBuilder(const antlr4::Parser* parser,
+                                               absl::string_view code,
+                                               VisitorOptions options = {});
 
 }  // namespace grammar
 }  // namespace nudl